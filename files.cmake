@@ -2,11 +2,19 @@ set(sources
 	src/About.cpp
 	src/About.h
 	src/About.ui
+	src/BatchTranscoder.cpp
+	src/BatchTranscoder.h
 	src/buildinfo.c
 	src/buildinfo.h
+	src/ChannelRouting.cpp
+	src/ChannelRouting.h
 	src/CmdQueue.cpp
 	src/CmdQueue.h
 	src/common.h
+	src/CompressedPcm.cpp
+	src/CompressedPcm.h
+	src/DecoderPool.cpp
+	src/DecoderPool.h
 	src/MainWindow.cpp
 	src/MainWindow.h
 	src/MainWindow.ui
@@ -15,16 +23,42 @@ set(sources
 	src/ExpandableSection.cpp
 	src/ExpandableSection.h
 	src/ExpandableSection.ui
+	src/HeadCache.cpp
+	src/HeadCache.h
 	src/HighResClock.cpp
 	src/HighResClock.h
+	src/inputfile.cpp
 	src/inputfile.h
+	src/InputFilePool.cpp
+	src/InputFilePool.h
 	src/inputfileffmpeg.cpp
+	src/inputfilehead.cpp
+	src/inputfilemacro.cpp
+	src/inputfilemacro.h
+	src/inputfileplaylist.cpp
+	src/inputfileplaylist.h
+	src/inputfilewav.cpp
+	src/LevelMeter.h
+	src/LevelMeterWidget.cpp
+	src/LevelMeterWidget.h
+	src/LockTelemetry.cpp
+	src/LockTelemetry.h
 	src/main.cpp
 	src/main.h
+	src/MappedFile.cpp
+	src/MappedFile.h
+	src/MediaInfoCache.cpp
+	src/MediaInfoCache.h
+	src/MixKernel.cpp
+	src/MixKernel.h
+	src/OfflineRenderer.cpp
+	src/OfflineRenderer.h
 	src/peakmeter.h
 	src/plugin.cpp
 	src/plugin.h
 	src/qtres.qrc
+	src/RtCheck.cpp
+	src/RtCheck.h
 	src/SampleBuffer.cpp
 	src/SampleBuffer.h
 	src/SampleProducer.h
@@ -35,6 +69,7 @@ set(sources
 	src/SampleSource.h
 	src/SampleVisualizerThread.cpp
 	src/SampleVisualizerThread.h
+	src/SeekStats.h
 	src/SoundButton.cpp
 	src/SoundButton.h
 	src/SoundInfo.cpp
@@ -46,12 +81,43 @@ set(sources
 	src/SoundView.h
 	src/SpeechBubble.cpp
 	src/SpeechBubble.h
+	src/SpscRing.h
+	src/StreamItem.cpp
+	src/StreamItem.h
 	src/TalkStateManager.cpp
 	src/TalkStateManager.h
 	src/Theme.cpp
 	src/Theme.h
 	src/ts3log.cpp
 	src/ts3log.h
+	src/UnderrunStats.h
 	src/UpdateChecker.cpp
 	src/UpdateChecker.h
 )
+
+# Playback engine without the plugin and Qt widgets, for the headless render tool
+set(render_tool_sources
+	src/ChannelRouting.cpp
+	src/CodecBenchmark.cpp
+	src/CompressedPcm.cpp
+	src/DecoderPool.cpp
+	src/HeadCache.cpp
+	src/HighResClock.cpp
+	src/inputfile.cpp
+	src/inputfileffmpeg.cpp
+	src/inputfilehead.cpp
+	src/inputfilemacro.cpp
+	src/inputfileplaylist.cpp
+	src/inputfilewav.cpp
+	src/LockTelemetry.cpp
+	src/MappedFile.cpp
+	src/MediaInfoCache.cpp
+	src/MixKernel.cpp
+	src/OfflineRenderer.cpp
+	src/RenderTool.cpp
+	src/RtCheck.cpp
+	src/SampleBuffer.cpp
+	src/SelfCheck.cpp
+	src/StreamItem.cpp
+	src/ts3log.cpp
+)
@@ -0,0 +1,216 @@
+// src/BatchTranscoder.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <QDir>
+#include <QFile>
+#include <QSet>
+
+#include "BatchTranscoder.h"
+#include "OfflineRenderer.h"
+#include "MappedFile.h"
+#include "SoundInfo.h"
+#include "HighResClock.h"
+#include "ts3log.h"
+
+// Bump when the prepared format changes, so all files get converted again
+#define PREPARED_FORMAT_VERSION 1
+#define PREPARED_SAMPLE_RATE 48000
+#define WAV_HEADER_SIZE 44
+
+
+namespace
+{
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	return hash;
+}
+
+
+// Whether output was written after input was last changed
+bool isUpToDate(const QString& output, const QString& input)
+{
+	int64_t outSize = 0, outMTime = 0, inSize = 0, inMTime = 0;
+	return MappedFile::GetFileInfo(output.toUtf8(), outSize, outMTime) && outSize > WAV_HEADER_SIZE &&
+		   MappedFile::GetFileInfo(input.toUtf8(), inSize, inMTime) && outMTime >= inMTime;
+}
+} // namespace
+
+
+BatchTranscoder::~BatchTranscoder()
+{
+	stop();
+}
+
+
+BatchTranscoder& BatchTranscoder::GetInstance()
+{
+	static BatchTranscoder instance;
+	return instance;
+}
+
+
+void BatchTranscoder::setDirectory(const QString& dir)
+{
+	Lock lock(m_mutex);
+	m_dir = dir;
+}
+
+
+// The name depends on the file and the crop settings, so cropping a sound differently makes a new file
+QString BatchTranscoder::outputPath(const SoundInfo& sound) const
+{
+	const QByteArray filename = sound.filename.toUtf8();
+	const double crop[2] = {sound.getStartTime(), sound.getPlayTime()};
+	const int version = PREPARED_FORMAT_VERSION;
+	uint64_t hash = fnv1a(filename.constData(), filename.size());
+	hash = fnv1a(crop, sizeof(crop), hash);
+	hash = fnv1a(&version, sizeof(version), hash);
+
+	Lock lock(m_mutex);
+	if (m_dir.isEmpty())
+		return QString();
+	return QDir(m_dir).filePath(QString("%1.wav").arg(hash, 16, 16, QChar('0')));
+}
+
+
+QString BatchTranscoder::preparedFile(const SoundInfo& sound) const
+{
+	if (sound.filename.isEmpty())
+		return QString();
+	QString path = outputPath(sound);
+	return !path.isEmpty() && isUpToDate(path, sound.filename) ? path : QString();
+}
+
+
+bool BatchTranscoder::start(const std::vector<SoundInfo>& sounds, Callback finished)
+{
+	if (m_running)
+		return false;
+	if (m_thread.joinable())
+		m_thread.join();
+
+	std::vector<item_t> items;
+	QSet<QString> outputs;
+	for (const SoundInfo& sound : sounds)
+	{
+		if (sound.filename.isEmpty())
+			continue;
+		QString output = outputPath(sound);
+		if (output.isEmpty() || outputs.contains(output))
+			continue;
+		outputs.insert(output);
+		items.push_back({sound.filename, sound.getStartTime(), sound.getPlayTime(), output});
+	}
+
+	{
+		Lock lock(m_mutex);
+		if (m_dir.isEmpty() || !QDir().mkpath(m_dir))
+		{
+			logError("Cannot create directory for prepared sounds: %s", m_dir.toUtf8().constData());
+			return false;
+		}
+	}
+
+	m_running = true;
+	m_thread = std::thread(&BatchTranscoder::run, this, std::move(items), finished);
+	return true;
+}
+
+
+void BatchTranscoder::stop()
+{
+	m_stop = true;
+	if (m_thread.joinable())
+		m_thread.join();
+	m_stop = false;
+}
+
+
+void BatchTranscoder::run(std::vector<item_t> items, Callback finished)
+{
+	const HighResClock::time_point start = HighResClock::now();
+
+	report_t report = {(int)items.size(), 0, 0, QStringList(), 0.0, 0.0};
+	std::atomic<size_t> next(0);
+
+	// Decoding is CPU bound, so one worker per core keeps all of them busy
+	const int numWorkers = (int)std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), items.size());
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numWorkers; i++)
+		workers.emplace_back(&BatchTranscoder::work, this, std::cref(items), std::ref(next), std::ref(report));
+	for (std::thread& worker : workers)
+		worker.join();
+
+	std::chrono::duration<double> elapsed = HighResClock::now() - start;
+	report.seconds = elapsed.count();
+	logInfo(
+		"Prepared %i of %i sounds (%i up to date, %i failed) with %i threads in %.2f s", report.converted,
+		report.total, report.skipped, report.failed.size(), numWorkers, report.seconds
+	);
+
+	m_running = false;
+	if (finished && !m_stop) // Nobody is interested in canceled batches
+		finished(report);
+}
+
+
+void BatchTranscoder::work(const std::vector<item_t>& items, std::atomic<size_t>& next, report_t& report)
+{
+	while (!m_stop)
+	{
+		const size_t i = next++;
+		if (i >= items.size())
+			return;
+		const item_t& item = items[i];
+
+		if (isUpToDate(item.output, item.input))
+		{
+			Lock lock(m_mutex);
+			report.skipped++;
+			continue;
+		}
+
+		// Write under a temporary name, so a canceled or crashed batch never leaves a truncated prepared file
+		const QString partial = item.output + ".part";
+		RenderJob job;
+		job.input = item.input.toUtf8().constData();
+		job.startTime = item.startTime;
+		job.playTime = item.playTime;
+		job.passthrough = true;
+		job.output = partial.toUtf8().constData();
+		job.format = RenderJob::eFORMAT_WAV;
+		job.sampleRate = PREPARED_SAMPLE_RATE;
+
+		RenderResult result;
+		bool ok = RenderOffline(job, result) == 0;
+		if (ok)
+		{
+			QFile::remove(item.output);
+			ok = QFile::rename(partial, item.output);
+		}
+		if (!ok)
+			QFile::remove(partial);
+
+		Lock lock(m_mutex);
+		if (ok)
+		{
+			report.converted++;
+			report.audioSeconds += result.audioSeconds(PREPARED_SAMPLE_RATE);
+		}
+		else
+			report.failed.append(item.input);
+	}
+}
@@ -0,0 +1,89 @@
+// src/BatchTranscoder.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+
+class SoundInfo;
+
+
+// Prepares sounds for playback at minimum CPU: every sound is decoded once, cropped and written as
+// 48 kHz 16 bit wave file with the channels of the source (mono or stereo), which the wave backend plays
+// straight from the mapped file.
+// Files are converted in parallel by a pool of one thread per core. Prepared files are only written
+// under their final name once complete, so an interrupted batch resumes where it stopped.
+class BatchTranscoder
+{
+  public:
+	struct report_t
+	{
+		int total; // Distinct sound files in the batch
+		int converted;
+		int skipped; // Already up to date
+		QStringList failed;
+		double audioSeconds; // Length of the converted files
+		double seconds; // Wall clock time of the whole batch
+	};
+
+	typedef std::function<void(const report_t&)> Callback;
+
+  public:
+	~BatchTranscoder();
+
+	static BatchTranscoder& GetInstance();
+
+	// Directory the prepared files are stored in
+	void setDirectory(const QString& dir);
+
+	// Convert all sounds in the background, finished is called from a worker thread unless the batch is
+	// stopped. Returns false if a batch is already running or the directory cannot be created.
+	bool start(const std::vector<SoundInfo>& sounds, Callback finished);
+
+	// Cancel the running batch and wait for the workers
+	void stop();
+
+	inline bool running() const
+	{
+		return m_running;
+	}
+
+	// Prepared file for sound, or an empty string if there is none or the sound changed since
+	QString preparedFile(const SoundInfo& sound) const;
+
+  private:
+	struct item_t
+	{
+		QString input;
+		double startTime;
+		double playTime;
+		QString output;
+	};
+
+	BatchTranscoder() = default;
+	QString outputPath(const SoundInfo& sound) const;
+	void run(std::vector<item_t> items, Callback finished);
+	void work(const std::vector<item_t>& items, std::atomic<size_t>& next, report_t& report);
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	mutable std::mutex m_mutex; // Guards the report while working and m_dir
+	QString m_dir;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+	std::atomic<bool> m_stop{false};
+};
@@ -0,0 +1,136 @@
+// src/ChannelRouting.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ChannelRouting.h"
+
+// Gains of the different speaker groups. Front speakers play the sound at full level,
+// center speakers get the mono mix, surround speakers are 3 dB quieter. The LFE channel stays silent.
+#define FRONT_GAIN 1.0f
+#define CENTER_GAIN 0.5f
+#define SURROUND_GAIN 0.70710678f
+
+#define LEFT_SPEAKERS (SPEAKER_FRONT_LEFT | SPEAKER_HEADPHONES_LEFT | SPEAKER_FRONT_LEFT_OF_CENTER)
+#define RIGHT_SPEAKERS (SPEAKER_FRONT_RIGHT | SPEAKER_HEADPHONES_RIGHT | SPEAKER_FRONT_RIGHT_OF_CENTER)
+#define CENTER_SPEAKERS (SPEAKER_FRONT_CENTER | SPEAKER_MONO)
+#define SURROUND_LEFT_SPEAKERS \
+	(SPEAKER_SIDE_LEFT | SPEAKER_BACK_LEFT | SPEAKER_TOP_FRONT_LEFT | SPEAKER_TOP_BACK_LEFT)
+#define SURROUND_RIGHT_SPEAKERS \
+	(SPEAKER_SIDE_RIGHT | SPEAKER_BACK_RIGHT | SPEAKER_TOP_FRONT_RIGHT | SPEAKER_TOP_BACK_RIGHT)
+#define SURROUND_CENTER_SPEAKERS \
+	(SPEAKER_BACK_CENTER | SPEAKER_TOP_CENTER | SPEAKER_TOP_FRONT_CENTER | SPEAKER_TOP_BACK_CENTER)
+
+
+ChannelRouting::ChannelRouting() :
+	m_channels(0),
+	m_hasSpeakers(false),
+	m_numRoutes(0),
+	m_speakerMask(0)
+{
+}
+
+
+void ChannelRouting::build(int channels, const unsigned int* speakers)
+{
+	m_channels = std::min(std::max(channels, 0), MAX_ROUTED_CHANNELS);
+	m_hasSpeakers = speakers != nullptr;
+	if (speakers)
+		std::copy(speakers, speakers + m_channels, m_speakers);
+	m_numRoutes = 0;
+	m_speakerMask = 0;
+
+	if (m_channels == 0)
+		return;
+
+	if (m_channels == 1)
+	{
+		addRoute(0, speakers ? speakers[0] : SPEAKER_MONO, CENTER_GAIN, CENTER_GAIN);
+		return;
+	}
+
+	if (!speakers)
+	{
+		addRoute(0, SPEAKER_FRONT_LEFT, FRONT_GAIN, 0.0f);
+		addRoute(1, SPEAKER_FRONT_RIGHT, 0.0f, FRONT_GAIN);
+		return;
+	}
+
+	for (int c = 0; c < m_channels; c++)
+	{
+		const unsigned int s = speakers[c];
+		if (s & LEFT_SPEAKERS)
+			addRoute(c, s, FRONT_GAIN, 0.0f);
+		else if (s & RIGHT_SPEAKERS)
+			addRoute(c, s, 0.0f, FRONT_GAIN);
+		else if (s & CENTER_SPEAKERS)
+			addRoute(c, s, CENTER_GAIN, CENTER_GAIN);
+		else if (s & SURROUND_LEFT_SPEAKERS)
+			addRoute(c, s, SURROUND_GAIN, 0.0f);
+		else if (s & SURROUND_RIGHT_SPEAKERS)
+			addRoute(c, s, 0.0f, SURROUND_GAIN);
+		else if (s & SURROUND_CENTER_SPEAKERS)
+			addRoute(c, s, CENTER_GAIN * SURROUND_GAIN, CENTER_GAIN * SURROUND_GAIN);
+	}
+
+	// Unknown layout: Play the mono mix on the first channel, like a device without speaker information
+	if (m_numRoutes == 0)
+		addRoute(0, SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT, CENTER_GAIN, CENTER_GAIN);
+}
+
+
+bool ChannelRouting::matches(int channels, const unsigned int* speakers) const
+{
+	if (channels != m_channels || (speakers != nullptr) != m_hasSpeakers)
+		return false;
+	return !speakers || memcmp(speakers, m_speakers, m_channels * sizeof(unsigned int)) == 0;
+}
+
+
+void ChannelRouting::addRoute(int channel, unsigned int speaker, float gainLeft, float gainRight)
+{
+	route_t& r = m_routes[m_numRoutes++];
+	r.channel = channel;
+	r.speaker = speaker;
+	r.gainLeft = gainLeft;
+	r.gainRight = gainRight;
+	m_speakerMask |= speaker;
+}
+
+
+ChannelRoutingCache::ChannelRoutingCache() :
+	m_last(0),
+	m_next(0)
+{
+	std::fill(m_valid, m_valid + numEntries, false);
+}
+
+
+const ChannelRouting& ChannelRoutingCache::get(int channels, const unsigned int* speakers)
+{
+	if (m_valid[m_last] && m_entries[m_last].matches(channels, speakers))
+		return m_entries[m_last];
+
+	for (int i = 0; i < numEntries; i++)
+	{
+		if (m_valid[i] && m_entries[i].matches(channels, speakers))
+		{
+			m_last = i;
+			return m_entries[i];
+		}
+	}
+
+	m_last = m_next;
+	m_next = (m_next + 1) % numEntries;
+	m_entries[m_last].build(channels, speakers);
+	m_valid[m_last] = true;
+	return m_entries[m_last];
+}
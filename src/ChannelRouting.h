@@ -0,0 +1,85 @@
+// src/ChannelRouting.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#define MAX_ROUTED_CHANNELS 32
+
+
+// Describes how the stereo samples of the sample buffers are mixed into the channels of a device
+class ChannelRouting
+{
+  public:
+	struct route_t
+	{
+		int channel; // Index of the interleaved output channel
+		unsigned int speaker; // TS3 speaker bits of the channel
+		float gainLeft;
+		float gainRight;
+	};
+
+  public:
+	ChannelRouting();
+
+	// Compute the routing for a device with the given TS3 speaker layout.
+	// Without speakers, one channel is mono and two channels are left and right.
+	void build(int channels, const unsigned int* speakers);
+
+	// Whether this routing was built for the given layout
+	bool matches(int channels, const unsigned int* speakers) const;
+
+	inline int numChannels() const
+	{
+		return m_channels;
+	}
+
+	inline int numRoutes() const
+	{
+		return m_numRoutes;
+	}
+
+	inline const route_t& route(int i) const
+	{
+		return m_routes[i];
+	}
+
+	// Speaker bits of all channels that receive samples
+	inline unsigned int speakerMask() const
+	{
+		return m_speakerMask;
+	}
+
+  private:
+	void addRoute(int channel, unsigned int speaker, float gainLeft, float gainRight);
+
+  private:
+	int m_channels;
+	bool m_hasSpeakers;
+	unsigned int m_speakers[MAX_ROUTED_CHANNELS];
+	int m_numRoutes;
+	route_t m_routes[MAX_ROUTED_CHANNELS];
+	unsigned int m_speakerMask;
+};
+
+
+// Keeps the routings of the last few speaker layouts, so a routing is only computed once per layout.
+// Uses fixed storage and never allocates, lookups are safe on audio threads.
+class ChannelRoutingCache
+{
+  public:
+	ChannelRoutingCache();
+
+	const ChannelRouting& get(int channels, const unsigned int* speakers);
+
+  private:
+	static const int numEntries = 4;
+	ChannelRouting m_entries[numEntries];
+	bool m_valid[numEntries];
+	int m_last; // Entry returned last time, checked first
+	int m_next; // Entry replaced next
+};
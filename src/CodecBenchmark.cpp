@@ -0,0 +1,184 @@
+// src/CodecBenchmark.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "CodecBenchmark.h"
+#include "CompressedPcm.h"
+#include "inputfile.h"
+#include "SampleProducer.h"
+#include "HighResClock.h"
+
+
+namespace
+{
+// Collects the whole decoded file
+class PcmCollector : public SampleProducer
+{
+  public:
+	PcmCollector(int channels) :
+		m_channels(channels),
+		m_reserved(0)
+	{
+	}
+
+	void produce(const short* samples, int count) override
+	{
+		m_samples.insert(m_samples.end(), samples, samples + count * m_channels);
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		m_reserved = m_samples.size();
+		m_samples.resize(m_reserved + (size_t)maxCount * m_channels);
+		*samples = m_samples.data() + m_reserved;
+		return maxCount;
+	}
+
+	void commit(int count) override
+	{
+		m_samples.resize(m_reserved + (size_t)count * m_channels);
+	}
+
+	inline int frames() const
+	{
+		return (int)(m_samples.size() / m_channels);
+	}
+
+	inline const short* data() const
+	{
+		return m_samples.data();
+	}
+
+  private:
+	const int m_channels;
+	std::vector<short> m_samples;
+	size_t m_reserved;
+};
+
+
+struct measure_t
+{
+	double audioSeconds;
+	size_t rawBytes;
+	size_t packedBytes;
+	double encodeSeconds;
+	double decodeSeconds; // Per run
+};
+
+
+inline double since(const HighResClock::time_point& start)
+{
+	return std::chrono::duration<double>(HighResClock::now() - start).count();
+}
+
+
+void print(const char* name, const measure_t& m, int chunks)
+{
+	printf(
+		"%-32.32s %8.2f s %9.1f KB %6.1f %% %9.0fx %9.0fx %7.1f us\n", name, m.audioSeconds, m.rawBytes / 1024.0,
+		m.rawBytes > 0 ? 100.0 * (double)m.packedBytes / (double)m.rawBytes : 0.0,
+		m.encodeSeconds > 0.0 ? m.audioSeconds / m.encodeSeconds : 0.0,
+		m.decodeSeconds > 0.0 ? m.audioSeconds / m.decodeSeconds : 0.0,
+		chunks > 0 ? m.decodeSeconds / chunks * 1000000.0 : 0.0
+	);
+}
+
+
+bool measure(const std::string& filename, int repeat, measure_t& m, int& chunks)
+{
+	InputFileOptions options;
+	std::unique_ptr<InputFile> file(CreateInputFile(filename.c_str(), options));
+	if (file->open(filename.c_str()) != 0)
+		return false;
+
+	PcmCollector pcm(file->channels());
+	int read;
+	while ((read = file->readSamples(&pcm)) > 0)
+		;
+	const int channels = file->channels();
+	file->close();
+	if (read < 0)
+		return false;
+
+	CompressedPcm packed;
+	HighResClock::time_point start = HighResClock::now();
+	packed.encode(pcm.data(), pcm.frames(), channels);
+	m.encodeSeconds = since(start);
+
+	std::vector<short> chunk((size_t)PCM_CHUNK_FRAMES * channels);
+	bool exact = true;
+	start = HighResClock::now();
+	for (int r = 0; r < repeat; r++)
+	{
+		for (int c = 0; c < packed.numChunks(); c++)
+		{
+			const int frames = packed.decodeChunk(c, chunk.data());
+			if (r == 0)
+			{
+				const short* original = pcm.data() + (size_t)c * PCM_CHUNK_FRAMES * channels;
+				exact = exact && memcmp(chunk.data(), original, (size_t)frames * channels * sizeof(short)) == 0;
+			}
+		}
+	}
+	m.decodeSeconds = since(start) / repeat;
+
+	if (!exact)
+	{
+		fprintf(stderr, "%s: decoded samples differ from the original\n", filename.c_str());
+		return false;
+	}
+
+	m.audioSeconds = (double)pcm.frames() / options.outputSampleRate;
+	m.rawBytes = (size_t)pcm.frames() * channels * sizeof(short);
+	m.packedBytes = packed.bytes();
+	chunks = packed.numChunks();
+	return true;
+}
+} // namespace
+
+
+int RunCodecBenchmark(const std::vector<std::string>& files, int repeat)
+{
+	printf(
+		"%-32s %10s %12s %8s %10s %10s %10s\n", "File", "Length", "PCM", "Packed", "Encode", "Decode", "Per chunk"
+	);
+
+	measure_t total = {};
+	int totalChunks = 0;
+	int failed = 0;
+	for (const std::string& filename : files)
+	{
+		measure_t m = {};
+		int chunks = 0;
+		const size_t slash = filename.find_last_of("/\\");
+		const std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+		if (!measure(filename, repeat, m, chunks))
+		{
+			printf("%-32.32s failed\n", name.c_str());
+			failed++;
+			continue;
+		}
+		print(name.c_str(), m, chunks);
+
+		total.audioSeconds += m.audioSeconds;
+		total.rawBytes += m.rawBytes;
+		total.packedBytes += m.packedBytes;
+		total.encodeSeconds += m.encodeSeconds;
+		total.decodeSeconds += m.decodeSeconds;
+		totalChunks += chunks;
+	}
+	print("Total", total, totalChunks);
+	return failed > 0 ? 1 : 0;
+}
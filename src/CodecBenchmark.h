@@ -0,0 +1,19 @@
+// src/CodecBenchmark.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Measures CompressedPcm on real sounds: decodes every file like playback does, compresses it and reports
+// the compression ratio against the encode and decode speed, per file and over all of them.
+// Decoding is timed chunk by chunk, the way heads are inflated while playing, and run repeat times.
+// Every file is checked to come back bit-exact. Returns 0 if all files could be measured.
+int RunCodecBenchmark(const std::vector<std::string>& files, int repeat);
@@ -0,0 +1,439 @@
+// src/CompressedPcm.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "CompressedPcm.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Residuals of a partition share one Rice parameter
+#define PARTITION_FRAMES 512
+#define MAX_ORDER 4
+#define MAX_RICE_PARAM 23
+// Quotients this large are stored as escape code plus the raw value instead of in unary
+#define RICE_ESCAPE 32
+#define RAW_RESIDUAL_BITS 24
+// Warm up samples of the side channel need 17 bits, stored zigzag coded
+#define WARMUP_BITS 18
+
+
+namespace
+{
+enum stereo_mode_e
+{
+	eSTEREO_LEFT_RIGHT = 0,
+	eSTEREO_LEFT_SIDE, // Right is left minus side
+	eSTEREO_SIDE_RIGHT, // Left is side plus right
+};
+
+
+inline uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+
+inline int32_t unzigzag(uint32_t u)
+{
+	return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+
+inline int countLeadingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	return _BitScanReverse64(&index, v) ? 63 - (int)index : 64;
+#else
+	return v ? __builtin_clzll(v) : 64;
+#endif
+}
+
+
+// Residual of the fixed polynomial predictor of the given order at x[i], i >= order
+inline int32_t residual(const int32_t* x, int i, int order)
+{
+	switch (order)
+	{
+	case 0:
+		return x[i];
+	case 1:
+		return x[i] - x[i - 1];
+	case 2:
+		return x[i] - 2 * x[i - 1] + x[i - 2];
+	case 3:
+		return x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+	default:
+		return x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+	}
+}
+
+
+// Predictor order with the smallest residuals and their absolute sum
+int bestOrder(const int32_t* x, int count, uint64_t& cost)
+{
+	int best = 0;
+	cost = UINT64_MAX;
+	for (int order = 0; order <= std::min(MAX_ORDER, count); order++)
+	{
+		uint64_t sum = 0;
+		for (int i = order; i < count; i++)
+			sum += (uint64_t)std::abs((int64_t)residual(x, i, order));
+		if (sum < cost)
+		{
+			cost = sum;
+			best = order;
+		}
+	}
+	return best;
+}
+
+
+int riceParam(uint64_t sum, int count)
+{
+	int k = 0;
+	while (k < MAX_RICE_PARAM && ((uint64_t)count << (k + 1)) <= sum)
+		k++;
+	return k;
+}
+
+
+// Appends MSB first
+class BitWriter
+{
+  public:
+	BitWriter(std::vector<uint8_t>& out) :
+		m_out(out),
+		m_acc(0),
+		m_bits(0)
+	{
+	}
+
+	// bits <= 32, higher bits of value are ignored
+	inline void put(uint32_t value, int bits)
+	{
+		m_acc = (m_acc << bits) | (value & (uint32_t)((1ull << bits) - 1));
+		m_bits += bits;
+		while (m_bits >= 8)
+		{
+			m_bits -= 8;
+			m_out.push_back((uint8_t)(m_acc >> m_bits));
+		}
+	}
+
+	inline void putRice(uint32_t u, int k)
+	{
+		const uint32_t q = u >> k;
+		if (q >= RICE_ESCAPE)
+		{
+			put(UINT32_MAX, RICE_ESCAPE);
+			put(u, RAW_RESIDUAL_BITS);
+			return;
+		}
+		// q ones and a terminating zero
+		if (q >= 31)
+		{
+			put(UINT32_MAX, 31);
+			put(((1u << (q - 31)) - 1) << 1, q - 31 + 1);
+		}
+		else
+			put(((1u << q) - 1) << 1, q + 1);
+		if (k > 0)
+			put(u & ((1u << k) - 1), k);
+	}
+
+	void flush()
+	{
+		if (m_bits > 0)
+			m_out.push_back((uint8_t)(m_acc << (8 - m_bits)));
+		m_bits = 0;
+	}
+
+  private:
+	std::vector<uint8_t>& m_out;
+	uint64_t m_acc;
+	int m_bits;
+};
+
+
+class BitReader
+{
+  public:
+	BitReader(const uint8_t* data, const uint8_t* end) :
+		m_data(data),
+		m_end(end),
+		m_acc(0),
+		m_bits(0)
+	{
+	}
+
+	// bits <= 32
+	inline uint32_t get(int bits)
+	{
+		if (bits == 0)
+			return 0;
+		if (m_bits < bits)
+			refill();
+		const uint32_t value = (uint32_t)(m_acc >> (64 - bits));
+		m_acc <<= bits;
+		m_bits -= bits;
+		return value;
+	}
+
+	inline uint32_t getRice(int k)
+	{
+		refill();
+		const int ones = std::min(countLeadingZeros(~m_acc), RICE_ESCAPE);
+		if (ones >= RICE_ESCAPE)
+		{
+			m_acc <<= RICE_ESCAPE;
+			m_bits -= RICE_ESCAPE;
+			return get(RAW_RESIDUAL_BITS);
+		}
+		m_acc <<= ones + 1;
+		m_bits -= ones + 1;
+		return ((uint32_t)ones << k) | get(k);
+	}
+
+  private:
+	// Reading behind the end gives zeros, corrupt data can't make it read out of bounds
+	inline void refill()
+	{
+		while (m_bits <= 56)
+		{
+			const uint64_t byte = m_data < m_end ? *m_data++ : 0;
+			m_acc |= byte << (56 - m_bits);
+			m_bits += 8;
+		}
+	}
+
+  private:
+	const uint8_t* m_data;
+	const uint8_t* const m_end;
+	uint64_t m_acc; // Valid bits are MSB aligned
+	int m_bits;
+};
+
+
+void writeChannel(BitWriter& writer, const int32_t* x, int count, int order)
+{
+	writer.put((uint32_t)order, 3);
+	for (int i = 0; i < order; i++)
+		writer.put(zigzag(x[i]), WARMUP_BITS);
+
+	for (int start = 0; start < count; start += PARTITION_FRAMES)
+	{
+		const int first = std::max(start, order);
+		const int end = std::min(count, start + PARTITION_FRAMES);
+		uint64_t sum = 0;
+		for (int i = first; i < end; i++)
+			sum += zigzag(residual(x, i, order));
+		const int k = riceParam(sum, std::max(end - first, 1));
+		writer.put((uint32_t)k, 5);
+		for (int i = first; i < end; i++)
+			writer.putRice(zigzag(residual(x, i, order)), k);
+	}
+}
+
+
+void readChannel(BitReader& reader, int32_t* x, int count)
+{
+	const int order = std::min((int)reader.get(3), std::min(MAX_ORDER, count));
+	for (int i = 0; i < order; i++)
+		x[i] = unzigzag(reader.get(WARMUP_BITS));
+
+	for (int start = 0; start < count; start += PARTITION_FRAMES)
+	{
+		const int k = (int)reader.get(5);
+		const int end = std::min(count, start + PARTITION_FRAMES);
+		for (int i = std::max(start, order); i < end; i++)
+			x[i] = unzigzag(reader.getRice(k));
+	}
+
+	// Residuals to samples, one tight loop per order
+	switch (order)
+	{
+	case 0:
+		break;
+	case 1:
+		for (int i = 1; i < count; i++)
+			x[i] += x[i - 1];
+		break;
+	case 2:
+		for (int i = 2; i < count; i++)
+			x[i] += 2 * x[i - 1] - x[i - 2];
+		break;
+	case 3:
+		for (int i = 3; i < count; i++)
+			x[i] += 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+		break;
+	default:
+		for (int i = 4; i < count; i++)
+			x[i] += 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+		break;
+	}
+}
+} // namespace
+
+
+CompressedPcm::CompressedPcm() :
+	m_frames(0),
+	m_channels(0)
+{
+}
+
+
+void CompressedPcm::clear()
+{
+	m_data.clear();
+	m_data.shrink_to_fit();
+	m_offsets.clear();
+	m_offsets.shrink_to_fit();
+	m_frames = 0;
+	m_channels = 0;
+}
+
+
+void CompressedPcm::encode(const short* samples, int count, int channels)
+{
+	assert((channels == 1 || channels == 2) && "Only mono and stereo");
+	clear();
+	m_frames = count;
+	m_channels = channels;
+	for (int offset = 0; offset < count; offset += PCM_CHUNK_FRAMES)
+	{
+		m_offsets.push_back((uint32_t)m_data.size());
+		encodeChunk(samples + (size_t)offset * channels, std::min(count - offset, PCM_CHUNK_FRAMES));
+	}
+	m_offsets.push_back((uint32_t)m_data.size());
+	m_data.shrink_to_fit();
+}
+
+
+void CompressedPcm::encodeChunk(const short* samples, int count)
+{
+	const size_t start = m_data.size();
+	BitWriter writer(m_data);
+	writer.put(0, 1); // Not stored as is
+
+	std::vector<int32_t> left(count), right, side;
+	for (int i = 0; i < count; i++)
+		left[i] = samples[i * m_channels];
+
+	if (m_channels == 1)
+	{
+		uint64_t cost;
+		writeChannel(writer, left.data(), count, bestOrder(left.data(), count, cost));
+	}
+	else
+	{
+		right.resize(count);
+		side.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			right[i] = samples[i * 2 + 1];
+			side[i] = left[i] - right[i];
+		}
+
+		uint64_t costLeft, costRight, costSide;
+		const int orderLeft = bestOrder(left.data(), count, costLeft);
+		const int orderRight = bestOrder(right.data(), count, costRight);
+		const int orderSide = bestOrder(side.data(), count, costSide);
+
+		stereo_mode_e mode = eSTEREO_LEFT_RIGHT;
+		uint64_t cost = costLeft + costRight;
+		if (costLeft + costSide < cost)
+		{
+			mode = eSTEREO_LEFT_SIDE;
+			cost = costLeft + costSide;
+		}
+		if (costSide + costRight < cost)
+			mode = eSTEREO_SIDE_RIGHT;
+
+		writer.put((uint32_t)mode, 2);
+		if (mode == eSTEREO_SIDE_RIGHT)
+			writeChannel(writer, side.data(), count, orderSide);
+		else
+			writeChannel(writer, left.data(), count, orderLeft);
+		if (mode == eSTEREO_LEFT_SIDE)
+			writeChannel(writer, side.data(), count, orderSide);
+		else
+			writeChannel(writer, right.data(), count, orderRight);
+	}
+	writer.flush();
+
+	// Noise doesn't compress, store it as it is rather than making it bigger
+	if (m_data.size() - start > (size_t)count * m_channels * sizeof(short))
+	{
+		m_data.resize(start);
+		BitWriter raw(m_data);
+		raw.put(1, 1);
+		for (int i = 0; i < count * m_channels; i++)
+			raw.put((uint16_t)samples[i], 16);
+		raw.flush();
+	}
+}
+
+
+int CompressedPcm::decodeChunk(int chunk, short* out) const
+{
+	if (chunk < 0 || chunk >= numChunks())
+		return 0;
+
+	const int count = std::min(m_frames - chunk * PCM_CHUNK_FRAMES, PCM_CHUNK_FRAMES);
+	BitReader reader(m_data.data() + m_offsets[chunk], m_data.data() + m_offsets[chunk + 1]);
+	if (reader.get(1))
+	{
+		for (int i = 0; i < count * m_channels; i++)
+			out[i] = (short)reader.get(16);
+		return count;
+	}
+
+	int32_t a[PCM_CHUNK_FRAMES], b[PCM_CHUNK_FRAMES];
+	if (m_channels == 1)
+	{
+		readChannel(reader, a, count);
+		for (int i = 0; i < count; i++)
+			out[i] = (short)a[i];
+		return count;
+	}
+
+	const int mode = (int)reader.get(2);
+	readChannel(reader, a, count);
+	readChannel(reader, b, count);
+	switch (mode)
+	{
+	case eSTEREO_LEFT_SIDE:
+		for (int i = 0; i < count; i++)
+		{
+			out[i * 2] = (short)a[i];
+			out[i * 2 + 1] = (short)(a[i] - b[i]);
+		}
+		break;
+	case eSTEREO_SIDE_RIGHT:
+		for (int i = 0; i < count; i++)
+		{
+			out[i * 2] = (short)(a[i] + b[i]);
+			out[i * 2 + 1] = (short)b[i];
+		}
+		break;
+	default:
+		for (int i = 0; i < count; i++)
+		{
+			out[i * 2] = (short)a[i];
+			out[i * 2 + 1] = (short)b[i];
+		}
+		break;
+	}
+	return count;
+}
@@ -0,0 +1,65 @@
+// src/CompressedPcm.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Frames per chunk, chunks are compressed independently so they can be inflated one at a time
+#define PCM_CHUNK_FRAMES 4096
+
+
+// Losslessly compressed 16 bit PCM with one or two channels, inflated chunk by chunk.
+// FLAC style: stereo decorrelation, a fixed polynomial predictor of order 0 to 4 per channel and Rice coded
+// residuals with one parameter per partition. Chunks that would not get smaller are stored as they are.
+class CompressedPcm
+{
+  public:
+	CompressedPcm();
+
+	// Compress count interleaved frames, replacing what was stored before
+	void encode(const short* samples, int count, int channels);
+
+	// Inflate chunk into out, which takes PCM_CHUNK_FRAMES frames. Returns the number of frames.
+	// Never allocates, safe to call from the producer thread.
+	int decodeChunk(int chunk, short* out) const;
+
+	void clear();
+
+	inline int frames() const
+	{
+		return m_frames;
+	}
+
+	inline int channels() const
+	{
+		return m_channels;
+	}
+
+	inline int numChunks() const
+	{
+		return (m_frames + PCM_CHUNK_FRAMES - 1) / PCM_CHUNK_FRAMES;
+	}
+
+	// Size of the compressed data
+	inline size_t bytes() const
+	{
+		return m_data.size() + m_offsets.size() * sizeof(uint32_t);
+	}
+
+  private:
+	void encodeChunk(const short* samples, int count);
+
+  private:
+	std::vector<uint8_t> m_data;
+	std::vector<uint32_t> m_offsets; // Start of every chunk in m_data, plus the end
+	int m_frames;
+	int m_channels;
+};
@@ -16,6 +16,7 @@
 #include "main.h"
 #include "buildinfo.h"
 #include "plugin.h"
+#include "samples.h"
 
 
 ConfigModel::ConfigModel()
@@ -26,6 +27,12 @@ ConfigModel::ConfigModel()
 	m_volumeRemote = 80;
 	m_playbackLocal = true;
 	m_muteMyselfDuringPb = false;
+	m_underrunPolicy = Sampler::eUNDERRUN_DEFAULT;
+	m_headCacheLength = 500;
+	m_headCacheCompression = false;
+	m_mediaExactLength = false;
+	m_bufferMinMs = 250;
+	m_bufferMaxMs = 2000;
 	m_windowWidth = 600;
 	m_windowHeight = 240;
 
@@ -69,6 +76,12 @@ void ConfigModel::readConfig(const QString& file)
 	m_volumeRemote = settings.value("volumeRemote", volume_old).toInt();
 	m_playbackLocal = settings.value("playback_local", true).toBool();
 	m_muteMyselfDuringPb = settings.value("mute_myself_during_pb", false).toBool();
+	m_underrunPolicy = settings.value("underrun_policy", (int)Sampler::eUNDERRUN_DEFAULT).toInt();
+	m_headCacheLength = settings.value("head_cache_ms", 500).toInt();
+	m_headCacheCompression = settings.value("head_cache_compress", false).toBool();
+	m_mediaExactLength = settings.value("media_exact_length", false).toBool();
+	m_bufferMinMs = settings.value("buffer_min_ms", 250).toInt();
+	m_bufferMaxMs = settings.value("buffer_max_ms", 2000).toInt();
 	m_windowWidth = settings.value("window_width", 600).toInt();
 	m_windowHeight = settings.value("window_height", 240).toInt();
 	m_bubbleButtonsBuild = settings.value("bubble_buttons_build", 0).toInt();
@@ -97,6 +110,12 @@ void ConfigModel::writeConfig(const QString& file)
 	settings.setValue("volumeRemote", m_volumeRemote);
 	settings.setValue("playback_local", m_playbackLocal);
 	settings.setValue("mute_myself_during_pb", m_muteMyselfDuringPb);
+	settings.setValue("underrun_policy", m_underrunPolicy);
+	settings.setValue("head_cache_ms", m_headCacheLength);
+	settings.setValue("head_cache_compress", m_headCacheCompression);
+	settings.setValue("media_exact_length", m_mediaExactLength);
+	settings.setValue("buffer_min_ms", m_bufferMinMs);
+	settings.setValue("buffer_max_ms", m_bufferMaxMs);
 	settings.setValue("window_width", m_windowWidth);
 	settings.setValue("window_height", m_windowHeight);
 	settings.setValue("bubble_buttons_build", m_bubbleButtonsBuild);
@@ -265,6 +284,47 @@ void ConfigModel::setMuteMyselfDuringPb(bool val)
 }
 
 
+void ConfigModel::setUnderrunPolicy(int policy)
+{
+	m_underrunPolicy = policy;
+	writeConfig();
+	notify(NOTIFY_SET_UNDERRUN_POLICY, policy);
+}
+
+
+void ConfigModel::setHeadCacheLength(int ms)
+{
+	m_headCacheLength = ms;
+	writeConfig();
+	notify(NOTIFY_SET_HEAD_CACHE_LENGTH, ms);
+}
+
+
+void ConfigModel::setHeadCacheCompression(bool enabled)
+{
+	m_headCacheCompression = enabled;
+	writeConfig();
+	notify(NOTIFY_SET_HEAD_CACHE_COMPRESSION, enabled ? 1 : 0);
+}
+
+
+void ConfigModel::setMediaExactLength(bool enabled)
+{
+	m_mediaExactLength = enabled;
+	writeConfig();
+	notify(NOTIFY_SET_MEDIA_EXACT_LENGTH, enabled ? 1 : 0);
+}
+
+
+void ConfigModel::setBufferBounds(int minMs, int maxMs)
+{
+	m_bufferMinMs = minMs;
+	m_bufferMaxMs = maxMs;
+	writeConfig();
+	notify(NOTIFY_SET_BUFFER_BOUNDS, 0);
+}
+
+
 void ConfigModel::getWindowSize(int* width, int* height) const
 {
 	if (width)
@@ -376,6 +436,11 @@ void ConfigModel::notifyAllEvents()
 	notify(NOTIFY_SET_VOLUME_REMOTE, m_volumeRemote);
 	notify(NOTIFY_SET_PLAYBACK_LOCAL, m_playbackLocal);
 	notify(NOTIFY_SET_MUTE_MYSELF_DURING_PB, m_muteMyselfDuringPb);
+	notify(NOTIFY_SET_UNDERRUN_POLICY, m_underrunPolicy);
+	notify(NOTIFY_SET_HEAD_CACHE_LENGTH, m_headCacheLength);
+	notify(NOTIFY_SET_HEAD_CACHE_COMPRESSION, m_headCacheCompression ? 1 : 0);
+	notify(NOTIFY_SET_MEDIA_EXACT_LENGTH, m_mediaExactLength ? 1 : 0);
+	notify(NOTIFY_SET_BUFFER_BOUNDS, 0);
 	notify(NOTIFY_SET_WINDOW_SIZE, 0);
 	notify(NOTIFY_SET_BUBBLE_BUTTONS_BUILD, m_bubbleButtonsBuild);
 	notify(NOTIFY_SET_BUBBLE_STOP_BUILD, m_bubbleStopBuild);
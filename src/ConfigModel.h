@@ -38,6 +38,11 @@ class ConfigModel
 		NOTIFY_SET_HOTKEYS_ENABLED,
 		NOTIFY_SET_NEXT_UPDATE_CHECK,
 		NOTIFY_SET_THEME_MODE,
+		NOTIFY_SET_UNDERRUN_POLICY,
+		NOTIFY_SET_HEAD_CACHE_LENGTH,
+		NOTIFY_SET_HEAD_CACHE_COMPRESSION,
+		NOTIFY_SET_MEDIA_EXACT_LENGTH,
+		NOTIFY_SET_BUFFER_BOUNDS,
 	};
 
 	class Observer
@@ -100,6 +105,45 @@ class ConfigModel
 	}
 	void setMuteMyselfDuringPb(bool val);
 
+	// Combination of Sampler::underrun_policy_e
+	inline int getUnderrunPolicy() const
+	{
+		return m_underrunPolicy;
+	}
+	void setUnderrunPolicy(int policy);
+
+	// Length of the decoded start of every sound kept in memory in ms, 0 disables it
+	inline int getHeadCacheLength() const
+	{
+		return m_headCacheLength;
+	}
+	void setHeadCacheLength(int ms);
+
+	// Keep those starts losslessly compressed
+	inline bool getHeadCacheCompression() const
+	{
+		return m_headCacheCompression;
+	}
+	void setHeadCacheCompression(bool enabled);
+
+	// Count the exact length of every sound by decoding it once instead of trusting its container
+	inline bool getMediaExactLength() const
+	{
+		return m_mediaExactLength;
+	}
+	void setMediaExactLength(bool enabled);
+
+	// Limits of the read ahead sized for each sound in ms
+	inline int getBufferMinMs() const
+	{
+		return m_bufferMinMs;
+	}
+	inline int getBufferMaxMs() const
+	{
+		return m_bufferMaxMs;
+	}
+	void setBufferBounds(int minMs, int maxMs);
+
 	void getWindowSize(int* width, int* height) const;
 	void setWindowSize(int width, int height);
 
@@ -147,6 +191,10 @@ class ConfigModel
 	{
 		return (int)sounds().size();
 	}
+	const std::vector<SoundInfo>& sounds(int config) const
+	{
+		return m_sounds[config];
+	}
 
 	uint getNextUpdateCheck() const
 	{
@@ -180,6 +228,12 @@ class ConfigModel
 	int m_volumeRemote;
 	bool m_playbackLocal;
 	bool m_muteMyselfDuringPb;
+	int m_underrunPolicy;
+	int m_headCacheLength;
+	bool m_headCacheCompression;
+	bool m_mediaExactLength;
+	int m_bufferMinMs;
+	int m_bufferMaxMs;
 	int m_windowWidth;
 	int m_windowHeight;
 
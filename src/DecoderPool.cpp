@@ -0,0 +1,133 @@
+// src/DecoderPool.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "DecoderPool.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libswresample/swresample.h>
+}
+
+// Maximum number of idle decoders kept around
+#define MAX_IDLE_DECODERS 8
+
+
+DecoderKey::DecoderKey(
+	const AVCodecParameters* params, int timeBaseNum, int timeBaseDen, int outChannels, int outRate
+) :
+	codecId(params->codec_id),
+	sampleFormat(params->format),
+	sampleRate(params->sample_rate),
+	channels(params->ch_layout.nb_channels),
+	channelMask(params->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? params->ch_layout.u.mask : 0),
+	blockAlign(params->block_align),
+	bitsPerCodedSample(params->bits_per_coded_sample),
+	timeBaseNum(timeBaseNum),
+	timeBaseDen(timeBaseDen),
+	outputChannels(outChannels),
+	outputSampleRate(outRate)
+{
+	if (params->extradata && params->extradata_size > 0)
+		extradata.assign(params->extradata, params->extradata + params->extradata_size);
+}
+
+
+bool DecoderKey::operator==(const DecoderKey& other) const
+{
+	return codecId == other.codecId && sampleFormat == other.sampleFormat && sampleRate == other.sampleRate &&
+		   channels == other.channels && channelMask == other.channelMask && blockAlign == other.blockAlign &&
+		   bitsPerCodedSample == other.bitsPerCodedSample && timeBaseNum == other.timeBaseNum &&
+		   timeBaseDen == other.timeBaseDen && outputChannels == other.outputChannels &&
+		   outputSampleRate == other.outputSampleRate && extradata == other.extradata;
+}
+
+
+DecoderSlot::DecoderSlot(const DecoderKey& key) :
+	key(key),
+	codecCtx(nullptr),
+	swrCtx(nullptr),
+	frame(nullptr),
+	packet(nullptr),
+	outBuf(nullptr)
+{
+}
+
+
+DecoderSlot::~DecoderSlot()
+{
+	if (frame)
+		av_frame_free(&frame);
+	if (packet)
+		av_packet_free(&packet);
+	if (swrCtx)
+		swr_free(&swrCtx);
+	if (codecCtx)
+		avcodec_free_context(&codecCtx);
+	if (outBuf)
+		av_freep(&outBuf);
+}
+
+
+DecoderPool::~DecoderPool()
+{
+	clear();
+}
+
+
+DecoderPool& DecoderPool::GetInstance()
+{
+	static DecoderPool pool;
+	return pool;
+}
+
+
+DecoderSlot* DecoderPool::acquire(const DecoderKey& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto it = m_idle.begin(); it != m_idle.end(); ++it)
+	{
+		if ((*it)->key == key)
+		{
+			DecoderSlot* slot = *it;
+			m_idle.erase(it);
+			m_hits++;
+			return slot;
+		}
+	}
+
+	m_misses++;
+	return nullptr;
+}
+
+
+void DecoderPool::release(DecoderSlot* slot)
+{
+	// Drop everything that is still buffered from the previous file
+	avcodec_flush_buffers(slot->codecCtx);
+	av_frame_unref(slot->frame);
+	av_packet_unref(slot->packet);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_idle.push_front(slot);
+	while (m_idle.size() > MAX_IDLE_DECODERS)
+	{
+		delete m_idle.back();
+		m_idle.pop_back();
+	}
+}
+
+
+void DecoderPool::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (DecoderSlot* slot : m_idle)
+		delete slot;
+	m_idle.clear();
+}
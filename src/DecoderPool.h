@@ -0,0 +1,94 @@
+// src/DecoderPool.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <vector>
+
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFrame;
+struct AVPacket;
+struct SwrContext;
+
+
+// Identifies decoders that can be reused for each other: same codec with the same
+// configuration and the same output format.
+struct DecoderKey
+{
+	int codecId;
+	int sampleFormat;
+	int sampleRate;
+	int channels;
+	uint64_t channelMask;
+	int blockAlign;
+	int bitsPerCodedSample;
+	int timeBaseNum;
+	int timeBaseDen;
+	int outputChannels;
+	int outputSampleRate;
+	std::vector<uint8_t> extradata;
+
+	DecoderKey(const AVCodecParameters* params, int timeBaseNum, int timeBaseDen, int outChannels, int outRate);
+	bool operator==(const DecoderKey& other) const;
+};
+
+
+// An opened decoder with everything needed to convert its output
+struct DecoderSlot
+{
+	DecoderKey key;
+	AVCodecContext* codecCtx;
+	SwrContext* swrCtx; // only set if the stream needed resampling
+	AVFrame* frame;
+	AVPacket* packet;
+	uint8_t* outBuf;
+
+	explicit DecoderSlot(const DecoderKey& key);
+	~DecoderSlot();
+};
+
+
+// Keeps decoders of finished sounds around, so playing another file of the same kind
+// doesn't need to allocate and initialize a new decoder, resampler and buffers.
+class DecoderPool
+{
+  public:
+	~DecoderPool();
+
+	static DecoderPool& GetInstance();
+
+	// Take a warm slot that matches key. Returns nullptr if there is none.
+	DecoderSlot* acquire(const DecoderKey& key);
+
+	// Flush the slot and keep it for reuse, the least recently used slots are freed if the pool is full
+	void release(DecoderSlot* slot);
+
+	// Free all idle slots
+	void clear();
+
+	inline uint64_t hits() const
+	{
+		return m_hits;
+	}
+
+	inline uint64_t misses() const
+	{
+		return m_misses;
+	}
+
+  private:
+	std::mutex m_mutex;
+	std::list<DecoderSlot*> m_idle; // most recently released first
+	std::atomic<uint64_t> m_hits{0};
+	std::atomic<uint64_t> m_misses{0};
+};
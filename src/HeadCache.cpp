@@ -0,0 +1,302 @@
+// src/HeadCache.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "HeadCache.h"
+#include "inputfile.h"
+#include "MappedFile.h"
+#include "SampleProducer.h"
+#include "ts3log.h"
+
+
+namespace
+{
+// Collects decoded samples up to a limit, the decoder writes straight into it
+class HeadCollector : public SampleProducer
+{
+  public:
+	HeadCollector(int channels, int limit) :
+		m_channels(channels),
+		m_limit(limit),
+		m_reserved(0)
+	{
+		m_samples.reserve((size_t)limit * channels);
+	}
+
+	void produce(const short* samples, int count) override
+	{
+		count = std::min(count, std::max(m_limit - frames(), 0));
+		m_samples.insert(m_samples.end(), samples, samples + count * m_channels);
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		m_reserved = m_samples.size();
+		m_samples.resize(m_reserved + (size_t)maxCount * m_channels);
+		*samples = m_samples.data() + m_reserved;
+		return maxCount;
+	}
+
+	void commit(int count) override
+	{
+		m_samples.resize(m_reserved + (size_t)count * m_channels);
+	}
+
+	inline int frames() const
+	{
+		return (int)(m_samples.size() / m_channels);
+	}
+
+	// Drop everything behind the limit, decoders hand out whole frames
+	std::vector<short>& truncated()
+	{
+		m_samples.resize((size_t)std::min(frames(), m_limit) * m_channels);
+		m_samples.shrink_to_fit();
+		return m_samples;
+	}
+
+  private:
+	const int m_channels;
+	const int m_limit;
+	std::vector<short> m_samples;
+	size_t m_reserved;
+};
+} // namespace
+
+
+HeadCache::~HeadCache()
+{
+	stop();
+}
+
+
+HeadCache& HeadCache::GetInstance()
+{
+	static HeadCache cache;
+	return cache;
+}
+
+
+std::string HeadCache::makeKey(const std::string& filename, double startTime, double playTime)
+{
+	char crop[64];
+	snprintf(crop, sizeof(crop), "|%.6f|%.6f", startTime, playTime);
+	return filename + crop;
+}
+
+
+void HeadCache::setLength(int ms)
+{
+	Lock lock(m_mutex);
+	if (ms == m_lengthMs)
+		return;
+	m_lengthMs = std::max(ms, 0);
+	m_heads.clear();
+	m_bytes = 0;
+}
+
+
+void HeadCache::setCompression(bool enabled)
+{
+	Lock lock(m_mutex);
+	if (enabled == m_compress)
+		return;
+	m_compress = enabled;
+	m_heads.clear();
+	m_bytes = 0;
+}
+
+
+void HeadCache::update(const std::vector<sound_t>& sounds)
+{
+	{
+		Lock lock(m_mutex);
+		m_wanted.clear();
+		m_queue.clear();
+		if (m_lengthMs > 0)
+		{
+			for (const sound_t& sound : sounds)
+			{
+				if (sound.filename.empty())
+					continue;
+				if (m_wanted.insert(makeKey(sound.filename, sound.startTime, sound.playTime)).second)
+					m_queue.push_back(sound);
+			}
+		}
+
+		for (auto it = m_heads.begin(); it != m_heads.end();)
+		{
+			if (m_wanted.count(it->first) == 0)
+			{
+				m_bytes -= it->second->bytes();
+				it = m_heads.erase(it);
+			}
+			else
+				++it;
+		}
+
+		m_stop = false;
+		if (!m_thread.joinable() && !m_queue.empty())
+			m_thread = std::thread([this] { run(); });
+	}
+	m_cond.notify_one();
+}
+
+
+void HeadCache::stop()
+{
+	{
+		Lock lock(m_mutex);
+		m_stop = true;
+		m_queue.clear();
+	}
+	m_cond.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	Lock lock(m_mutex);
+	m_heads.clear();
+	m_wanted.clear();
+	m_bytes = 0;
+}
+
+
+bool HeadCache::contains(const std::string& filename, double startTime, double playTime) const
+{
+	Lock lock(m_mutex);
+	return m_heads.count(makeKey(filename, startTime, playTime)) > 0;
+}
+
+
+std::shared_ptr<const HeadCache::head_t> HeadCache::find(
+	const std::string& filename, double startTime, double playTime
+) const
+{
+	std::shared_ptr<const head_t> head;
+	{
+		Lock lock(m_mutex);
+		auto it = m_heads.find(makeKey(filename, startTime, playTime));
+		if (it == m_heads.end())
+			return nullptr;
+		head = it->second;
+	}
+
+	// A head of a file that was replaced meanwhile would not match its decoder
+	int64_t size = 0, mtime = 0;
+	if (!MappedFile::GetFileInfo(filename.c_str(), size, mtime) || size != head->fileSize ||
+		mtime != head->fileMTime)
+		return nullptr;
+	return head;
+}
+
+
+void HeadCache::usage(int& heads, int64_t& bytes) const
+{
+	Lock lock(m_mutex);
+	heads = (int)m_heads.size();
+	bytes = m_bytes;
+}
+
+
+void HeadCache::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		if (m_queue.empty())
+		{
+			m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			continue;
+		}
+
+		const sound_t sound = m_queue.front();
+		m_queue.pop_front();
+		const std::string key = makeKey(sound.filename, sound.startTime, sound.playTime);
+		const int lengthMs = m_lengthMs;
+		const bool compress = m_compress;
+
+		int64_t size = 0, mtime = 0;
+		if (!MappedFile::GetFileInfo(sound.filename.c_str(), size, mtime))
+			continue;
+		auto it = m_heads.find(key);
+		if (it != m_heads.end())
+		{
+			if (it->second->fileSize == size && it->second->fileMTime == mtime)
+				continue; // Still up to date
+			m_bytes -= it->second->bytes();
+			m_heads.erase(it);
+		}
+
+		// Mono and compressed heads take less than this, but that is only known once decoded
+		InputFileOptions options;
+		const int frames = (int)((int64_t)options.outputSampleRate * lengthMs / 1000);
+		if (!compress && m_bytes + (int64_t)frames * options.getNumChannels() * sizeof(short) > HEAD_CACHE_BUDGET)
+			continue; // Plays the usual way
+
+		// Decoding takes a while, don't block lookups meanwhile
+		lock.unlock();
+		std::shared_ptr<head_t> head = decode(sound, frames);
+		if (head && compress)
+		{
+			head->packed.encode(head->samples.data(), head->frames, head->channels);
+			head->samples = std::vector<short>();
+		}
+		lock.lock();
+
+		// The sound may have been removed or the settings changed while decoding
+		if (head && m_lengthMs == lengthMs && m_compress == compress && m_wanted.count(key) > 0 &&
+			m_bytes + head->bytes() <= HEAD_CACHE_BUDGET)
+		{
+			head->fileSize = size;
+			head->fileMTime = mtime;
+			m_bytes += head->bytes();
+			m_heads[key] = head;
+		}
+	}
+}
+
+
+// Decode exactly like a decoder opened for playback would, so its samples behind the head join seamlessly
+std::shared_ptr<HeadCache::head_t> HeadCache::decode(const sound_t& sound, int frames) const
+{
+	const char* filename = sound.filename.c_str();
+	InputFileOptions options;
+	options.pooledDecoder = false; // Leave the warm decoders to the sounds being played
+	if (frames <= 0 || ChooseInputFileBackend(filename, options) != InputFile::eBACKEND_FFMPEG)
+		return nullptr;
+
+	std::unique_ptr<InputFile> file(CreateInputFile(InputFile::eBACKEND_FFMPEG, options));
+	if (file->open(filename, sound.startTime, sound.playTime) != 0)
+		return nullptr;
+
+	HeadCollector collector(file->channels(), frames);
+	while (!file->done() && collector.frames() < frames && !m_stop)
+	{
+		if (file->readSamples(&collector) < 0)
+		{
+			logWarning("Cannot decode the head of %s", filename);
+			return nullptr;
+		}
+	}
+	if (m_stop)
+		return nullptr;
+
+	std::shared_ptr<head_t> head = std::make_shared<head_t>();
+	head->complete = file->done() && collector.frames() <= frames;
+	head->estimation = file->outputSamplesEstimation();
+	head->samples.swap(collector.truncated());
+	head->channels = file->channels();
+	head->frames = (int)(head->samples.size() / head->channels);
+	file->close();
+	return head;
+}
@@ -0,0 +1,109 @@
+// src/HeadCache.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CompressedPcm.h"
+
+// Heads of all sounds together never take more than this
+#define HEAD_CACHE_BUDGET (128 * 1024 * 1024)
+
+
+// Keeps the first few hundred ms of every sound decoded in memory, after the crop is applied.
+// A sound with a head starts playing from memory at once while its decoder is opened in the
+// background, see InputFileHead. Only sounds that need FFmpeg get a head, wave files open instantly.
+class HeadCache
+{
+  public:
+	struct head_t
+	{
+		std::vector<short> samples; // Interleaved in the output format, empty if packed
+		CompressedPcm packed; // The samples losslessly compressed instead, see setCompression()
+		int channels; // Native channels of the sound, 1 or 2
+		int frames;
+		bool complete; // The whole cropped sound fits into the head, there is nothing to decode after it
+		int64_t estimation; // outputSamplesEstimation() of the decoder
+		int64_t fileSize;
+		int64_t fileMTime;
+
+		inline bool isPacked() const
+		{
+			return packed.frames() > 0;
+		}
+
+		inline int64_t bytes() const
+		{
+			return (int64_t)(samples.size() * sizeof(short) + packed.bytes());
+		}
+	};
+
+	struct sound_t
+	{
+		std::string filename; // UTF-8
+		double startTime;
+		double playTime;
+	};
+
+  public:
+	~HeadCache();
+
+	static HeadCache& GetInstance();
+
+	// Length of the heads in ms, 0 disables the cache. Heads of another length are dropped.
+	void setLength(int ms);
+
+	// Keep heads losslessly compressed with CompressedPcm, so more of them fit into the budget. They are
+	// inflated chunk by chunk while playing. Heads stored the other way are dropped.
+	void setCompression(bool enabled);
+
+	// Decode the heads of these sounds in the background and drop all other heads
+	void update(const std::vector<sound_t>& sounds);
+
+	// Stop the background worker and free all heads
+	void stop();
+
+	// Whether there is a head for the sound, without any IO
+	bool contains(const std::string& filename, double startTime, double playTime) const;
+
+	// Head of the sound, if there is one and the file didn't change since it was decoded
+	std::shared_ptr<const head_t> find(const std::string& filename, double startTime, double playTime) const;
+
+	// Number of heads and their size in bytes
+	void usage(int& heads, int64_t& bytes) const;
+
+  private:
+	HeadCache() = default;
+	void run();
+	std::shared_ptr<head_t> decode(const sound_t& sound, int frames) const;
+	static std::string makeKey(const std::string& filename, double startTime, double playTime);
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::unordered_map<std::string, std::shared_ptr<const head_t>> m_heads;
+	std::unordered_set<std::string> m_wanted; // Keys of the sounds of the last update()
+	std::deque<sound_t> m_queue;
+	std::thread m_thread;
+	int m_lengthMs = 0;
+	bool m_compress = false;
+	int64_t m_bytes = 0;
+	volatile bool m_stop = false;
+};
@@ -0,0 +1,148 @@
+// src/InputFilePool.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include <algorithm>
+
+#include "InputFilePool.h"
+#include "SampleProducerThread.h"
+
+// Maximum number of closed files kept per backend
+#define MAX_IDLE_FILES 4
+
+// Files that can be queued for closing without reallocating the queue
+#define PENDING_CAPACITY 16
+
+
+InputFilePool::InputFilePool(SampleProducerThread& producer, InputFileOptions options /*= InputFileOptions()*/) :
+	m_producer(producer),
+	m_options(options),
+	m_stop(false)
+{
+	m_pending.reserve(PENDING_CAPACITY);
+}
+
+
+InputFilePool::~InputFilePool()
+{
+	stop();
+}
+
+
+void InputFilePool::start()
+{
+	if (m_thread.joinable())
+		return;
+
+	m_stop = false;
+	m_thread = std::thread(&InputFilePool::run, this);
+}
+
+
+void InputFilePool::stop()
+{
+	{
+		Lock lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	// The thread closed everything pending before exiting, unless it never ran
+	Lock lock(m_mutex);
+	for (InputFile* file : m_pending)
+		delete file;
+	m_pending.clear();
+	for (std::vector<InputFile*>& idle : m_idle)
+	{
+		for (InputFile* file : idle)
+			delete file;
+		idle.clear();
+	}
+}
+
+
+InputFile* InputFilePool::acquire(const char* filename)
+{
+	return acquire(ChooseInputFileBackend(filename, m_options));
+}
+
+
+InputFile* InputFilePool::acquire(InputFile::backend_e backend)
+{
+	{
+		Lock lock(m_mutex);
+		std::vector<InputFile*>& idle = m_idle[backend];
+		if (!idle.empty())
+		{
+			InputFile* file = idle.back();
+			idle.pop_back();
+			return file;
+		}
+	}
+
+	return CreateInputFile(backend, m_options);
+}
+
+
+void InputFilePool::reclaim(InputFile* file)
+{
+	if (!file)
+		return;
+
+	{
+		Lock lock(m_mutex);
+		m_pending.push_back(file);
+	}
+	m_cond.notify_one();
+}
+
+
+void InputFilePool::run()
+{
+	std::vector<InputFile*> files;
+	files.reserve(PENDING_CAPACITY);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_cond.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+		if (m_pending.empty())
+			break; // Stopped and nothing left to close
+
+		files.swap(m_pending);
+		lock.unlock();
+
+		// The producer may still be reading from a file that was only swapped out, close the others first
+		auto busy = std::stable_partition(
+			files.begin(), files.end(), [this](InputFile* file) { return !m_producer.isReading(file); }
+		);
+		for (auto it = files.begin(); it != files.end(); ++it)
+		{
+			if (it >= busy)
+				m_producer.waitForReleasedSource(*it);
+			(*it)->close();
+			recycle(*it);
+		}
+		files.clear();
+
+		lock.lock();
+	}
+}
+
+
+void InputFilePool::recycle(InputFile* file)
+{
+	Lock lock(m_mutex);
+	std::vector<InputFile*>& idle = m_idle[file->backend()];
+	if (m_stop || idle.size() >= MAX_IDLE_FILES)
+		delete file;
+	else
+		idle.push_back(file);
+}
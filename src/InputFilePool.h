@@ -0,0 +1,58 @@
+// src/InputFilePool.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inputfile.h"
+
+class SampleProducerThread;
+
+
+// Recycles input files of a producer thread.
+// Stopped files are closed on a separate thread, so stopping a sound never waits for
+// FFmpeg to tear down its contexts. Closed files are kept for the next sound.
+class InputFilePool
+{
+  public:
+	InputFilePool(SampleProducerThread& producer, InputFileOptions options = InputFileOptions());
+	~InputFilePool();
+
+	void start();
+
+	// Close all pending files and free everything
+	void stop();
+
+	// Get a closed input file able to play filename, reusing an idle one if possible
+	InputFile* acquire(const char* filename);
+	InputFile* acquire(InputFile::backend_e backend);
+
+	// Hand over a file that was detached from the producer. Does not block, the file is
+	// closed on the reclaimer thread once the producer doesn't use it anymore.
+	void reclaim(InputFile* file);
+
+  private:
+	void run();
+	void recycle(InputFile* file);
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	SampleProducerThread& m_producer;
+	const InputFileOptions m_options;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::vector<InputFile*> m_pending;
+	std::vector<InputFile*> m_idle[InputFile::eBACKEND_COUNT];
+	std::thread m_thread;
+	bool m_stop;
+};
@@ -0,0 +1,56 @@
+// src/LevelMeter.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <math.h>
+#include <atomic>
+
+
+// Peak and RMS level of the last block an audio thread delivered, relative to full scale.
+// The audio thread publishes with a few relaxed stores per block, readers never block it. Peak and RMS
+// may come from different blocks when read concurrently, which doesn't matter for a display.
+class LevelMeter
+{
+  public:
+	struct levels_t
+	{
+		float peak;
+		float rms;
+	};
+
+	LevelMeter() :
+		m_peak(0.0f),
+		m_rms(0.0f)
+	{
+	}
+
+	// Audio thread: peak is the largest absolute sample, sumSquares the sum over count squared samples
+	inline void publish(float peak, float sumSquares, int count)
+	{
+		const float scale = 1.0f / 32768.0f;
+		m_peak.store(peak * scale, std::memory_order_relaxed);
+		m_rms.store(count > 0 ? sqrtf(sumSquares / (float)count) * scale : 0.0f, std::memory_order_relaxed);
+	}
+
+	inline void publishSilence()
+	{
+		m_peak.store(0.0f, std::memory_order_relaxed);
+		m_rms.store(0.0f, std::memory_order_relaxed);
+	}
+
+	inline levels_t read() const
+	{
+		levels_t levels = {m_peak.load(std::memory_order_relaxed), m_rms.load(std::memory_order_relaxed)};
+		return levels;
+	}
+
+  private:
+	std::atomic<float> m_peak;
+	std::atomic<float> m_rms;
+};
@@ -0,0 +1,116 @@
+// src/LevelMeterWidget.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <QPainter>
+#include <algorithm>
+#include <math.h>
+
+#include "LevelMeterWidget.h"
+
+// Lower end of the scale in dB
+#define METER_FLOOR_DB -60.0f
+// Bars fall by this much per update, so short blocks don't make the meter flicker
+#define METER_FALL_DB 1.5f
+// Number of updates the peak hold marker stays before it starts falling
+#define METER_HOLD_FRAMES 30
+// Level the limiter starts working at (LIMITER_THRESHOLD in MixKernel.h)
+#define METER_LIMIT_DB -6.0f
+#define METER_WARN_DB -18.0f
+
+
+static float toDb(float level)
+{
+	return level > 0.0f ? std::max(20.0f * log10f(level), METER_FLOOR_DB) : METER_FLOOR_DB;
+}
+
+
+LevelMeterWidget::LevelMeterWidget(QWidget* parent /*= 0*/) :
+	BaseClass(parent),
+	m_peak(METER_FLOOR_DB),
+	m_rms(METER_FLOOR_DB),
+	m_hold(METER_FLOOR_DB),
+	m_holdFrames(0)
+{
+	setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+}
+
+
+void LevelMeterWidget::setLevels(const LevelMeter::levels_t& levels)
+{
+	const float peak = std::max(toDb(levels.peak), m_peak - METER_FALL_DB);
+	const float rms = std::max(toDb(levels.rms), m_rms - METER_FALL_DB);
+
+	float hold = m_hold;
+	if (peak >= hold)
+	{
+		hold = peak;
+		m_holdFrames = METER_HOLD_FRAMES;
+	}
+	else if (m_holdFrames > 0)
+		m_holdFrames--;
+	else
+		hold = std::max(hold - METER_FALL_DB, METER_FLOOR_DB);
+
+	// Skip repaints while nothing moves, the meter is updated even when silent
+	if (peak == m_peak && rms == m_rms && hold == m_hold)
+		return;
+
+	m_peak = peak;
+	m_rms = rms;
+	m_hold = hold;
+	update();
+}
+
+
+QSize LevelMeterWidget::sizeHint() const
+{
+	return QSize(80, 8);
+}
+
+
+void LevelMeterWidget::paintEvent(QPaintEvent*)
+{
+	QPainter p(this);
+	const QRect r = rect();
+	auto xOf = [&r](float db) { return r.left() + (int)(r.width() * (db - METER_FLOOR_DB) / -METER_FLOOR_DB); };
+
+	p.fillRect(r, palette().color(QPalette::Base));
+
+	// Split the bars into the zones, red where the limiter is working
+	auto drawBar = [&](float db, int alpha)
+	{
+		struct zone_t
+		{
+			float from, to;
+			QColor color;
+		} zones[] = {
+			{METER_FLOOR_DB, METER_WARN_DB, QColor(60, 180, 75)},
+			{METER_WARN_DB, METER_LIMIT_DB, QColor(230, 190, 40)},
+			{METER_LIMIT_DB, 0.0f, QColor(220, 50, 40)},
+		};
+		for (zone_t& zone : zones)
+		{
+			if (db <= zone.from)
+				break;
+			zone.color.setAlpha(alpha);
+			const int x0 = xOf(zone.from);
+			const int x1 = xOf(std::min(db, zone.to));
+			p.fillRect(QRect(x0, r.top(), x1 - x0, r.height()), zone.color);
+		}
+	};
+	drawBar(m_peak, 110);
+	drawBar(m_rms, 255);
+
+	if (m_hold > METER_FLOOR_DB)
+	{
+		const int x = std::min(xOf(m_hold), r.right());
+		p.fillRect(QRect(x, r.top(), 2, r.height()), palette().color(QPalette::Text));
+	}
+}
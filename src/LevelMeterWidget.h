@@ -0,0 +1,36 @@
+// src/LevelMeterWidget.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <QWidget>
+
+#include "LevelMeter.h"
+
+
+// Horizontal level meter: RMS as solid bar, peak as lighter bar and a falling peak hold marker.
+// Levels are pushed with setLevels() at a fixed rate, the widget only adds display ballistics.
+class LevelMeterWidget : public QWidget
+{
+	Q_OBJECT
+	typedef QWidget BaseClass;
+
+  public:
+	explicit LevelMeterWidget(QWidget* parent = 0);
+	void setLevels(const LevelMeter::levels_t& levels);
+	QSize sizeHint() const override;
+
+  protected:
+	void paintEvent(QPaintEvent* evt) override;
+
+  private:
+	float m_peak; // All in dB
+	float m_rms;
+	float m_hold;
+	int m_holdFrames;
+};
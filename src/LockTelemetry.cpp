@@ -0,0 +1,223 @@
+// src/LockTelemetry.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "LockTelemetry.h"
+#include "HighResClock.h"
+#include "ts3log.h"
+
+#define MAX_SITES 128
+// Wait time histogram buckets: below 1 us, then powers of two up to 1 ms and above
+#define WAIT_BUCKETS 12
+
+
+namespace
+{
+enum site_state_e
+{
+	eSITE_FREE = 0,
+	eSITE_CLAIMING,
+	eSITE_READY,
+};
+
+struct site_t
+{
+	std::atomic<int> state;
+	const char* mutexName;
+	const char* file;
+	int line;
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> contended;
+	std::atomic<uint64_t> totalWaitNs;
+	std::atomic<uint64_t> maxWaitNs;
+	std::atomic<int> maxWaitHolder; // Site that held the mutex during the longest wait
+	std::atomic<uint64_t> maxHoldNs;
+	std::atomic<uint64_t> buckets[WAIT_BUCKETS];
+};
+
+std::atomic<bool> g_enabled(false);
+std::atomic<uint64_t> g_overflows(0);
+site_t g_sites[MAX_SITES];
+
+
+// Raise value to at least v, returns true if v is the new maximum
+bool storeMax(std::atomic<uint64_t>& value, uint64_t v)
+{
+	uint64_t old = value.load(std::memory_order_relaxed);
+	while (v > old)
+	{
+		if (value.compare_exchange_weak(old, v, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+
+int bucketOf(int64_t waitNs)
+{
+	int64_t us = waitNs / 1000;
+	int bucket = 0;
+	while (us > 0 && bucket < WAIT_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+
+const char* baseName(const char* file)
+{
+	const char* slash = strrchr(file, '/');
+	const char* backslash = strrchr(file, '\\');
+	const char* last = std::max(slash, backslash); // nullptr compares less than any pointer into file
+	return last ? last + 1 : file;
+}
+} // namespace
+
+
+void LockTelemetry::setEnabled(bool enabled)
+{
+	g_enabled = enabled;
+}
+
+
+bool LockTelemetry::enabled()
+{
+	return g_enabled.load(std::memory_order_relaxed);
+}
+
+
+void LockTelemetry::reset()
+{
+	// Sites stay claimed, other threads might be about to record into them
+	for (site_t& s : g_sites)
+	{
+		s.count = 0;
+		s.contended = 0;
+		s.totalWaitNs = 0;
+		s.maxWaitNs = 0;
+		s.maxWaitHolder = -1;
+		s.maxHoldNs = 0;
+		for (std::atomic<uint64_t>& b : s.buckets)
+			b = 0;
+	}
+	g_overflows = 0;
+}
+
+
+int LockTelemetry::siteIndex(const char* mutexName, const char* file, int line)
+{
+	// __builtin_FILE() gives the same pointer for every lock in a translation unit
+	const uint64_t hash = (((uint64_t)(uintptr_t)file * 31 + (uint64_t)line) * 31) ^ (uint64_t)(uintptr_t)mutexName;
+	for (int probe = 0; probe < MAX_SITES; probe++)
+	{
+		const int i = (int)((hash + probe) % MAX_SITES);
+		site_t& s = g_sites[i];
+		int state = s.state.load(std::memory_order_acquire);
+		if (state == eSITE_READY && s.file == file && s.line == line && s.mutexName == mutexName)
+			return i;
+		if (state == eSITE_FREE && s.state.compare_exchange_strong(state, eSITE_CLAIMING))
+		{
+			s.mutexName = mutexName;
+			s.file = file;
+			s.line = line;
+			s.maxWaitHolder = -1;
+			s.state.store(eSITE_READY, std::memory_order_release);
+			return i;
+		}
+		// Sites being claimed by another thread are skipped, at worst a site shows up twice
+	}
+	g_overflows++;
+	return -1;
+}
+
+
+void LockTelemetry::recordLock(int site, int64_t waitNs, int holderSite)
+{
+	if (site < 0)
+		return;
+	site_t& s = g_sites[site];
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.buckets[bucketOf(waitNs)].fetch_add(1, std::memory_order_relaxed);
+	if (waitNs > 0)
+	{
+		s.contended.fetch_add(1, std::memory_order_relaxed);
+		s.totalWaitNs.fetch_add((uint64_t)waitNs, std::memory_order_relaxed);
+		if (storeMax(s.maxWaitNs, (uint64_t)waitNs))
+			s.maxWaitHolder.store(holderSite, std::memory_order_relaxed);
+	}
+}
+
+
+void LockTelemetry::recordUnlock(int site, int64_t holdNs)
+{
+	if (site >= 0 && holdNs > 0)
+		storeMax(g_sites[site].maxHoldNs, (uint64_t)holdNs);
+}
+
+
+int64_t LockTelemetry::nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(HighResClock::now().time_since_epoch()).count();
+}
+
+
+void LockTelemetry::dump()
+{
+	int order[MAX_SITES];
+	int numSites = 0;
+	for (int i = 0; i < MAX_SITES; i++)
+	{
+		if (g_sites[i].state == eSITE_READY && g_sites[i].count > 0)
+			order[numSites++] = i;
+	}
+	std::sort(
+		order, order + numSites, [](int a, int b) { return g_sites[a].totalWaitNs > g_sites[b].totalWaitNs; }
+	);
+
+	logInfo("Lock telemetry: %i call sites, %llu not recorded", numSites, (unsigned long long)g_overflows.load());
+	for (int n = 0; n < numSites; n++)
+	{
+		const site_t& s = g_sites[order[n]];
+
+		char holder[128] = "-";
+		const int h = s.maxWaitHolder;
+		if (h >= 0 && g_sites[h].state == eSITE_READY)
+			snprintf(holder, sizeof(holder), "%s:%i", baseName(g_sites[h].file), g_sites[h].line);
+
+		// Only the non-empty buckets, as "<upper bound in us>:count"
+		char histogram[256] = "";
+		int len = 0;
+		for (int b = 0; b < WAIT_BUCKETS && len < (int)sizeof(histogram); b++)
+		{
+			if (s.buckets[b] == 0)
+				continue;
+			if (b == WAIT_BUCKETS - 1)
+				len += snprintf(histogram + len, sizeof(histogram) - len, " >=%ius:%llu", 1 << (b - 1),
+					(unsigned long long)s.buckets[b].load());
+			else
+				len += snprintf(histogram + len, sizeof(histogram) - len, " <%ius:%llu", 1 << b,
+					(unsigned long long)s.buckets[b].load());
+		}
+
+		logInfo(
+			"%s at %s:%i: %llu locks, %llu contended, waited %.3f ms total, %.1f us max (held by %s), "
+			"held %.1f us max, waits:%s",
+			s.mutexName, baseName(s.file), s.line, (unsigned long long)s.count.load(),
+			(unsigned long long)s.contended.load(), s.totalWaitNs / 1000000.0, s.maxWaitNs / 1000.0, holder,
+			s.maxHoldNs / 1000.0, histogram
+		);
+	}
+}
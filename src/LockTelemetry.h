@@ -0,0 +1,146 @@
+// src/LockTelemetry.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+// Contention telemetry for the mutexes shared between the audio callbacks, the producer thread and the GUI.
+// While enabled, every lock of an InstrumentedMutex is attributed to its call site. Per site the number
+// of acquisitions, a histogram of the wait times, the longest hold time and the site that held the
+// mutex during the longest wait are recorded. All storage is fixed, recording never allocates or blocks.
+// Disabled, a lock costs a relaxed load and store more than a plain std::mutex.
+
+namespace LockTelemetry
+{
+void setEnabled(bool enabled);
+bool enabled();
+
+// Forget everything recorded so far
+void reset();
+
+// Log all sites that were seen, sorted by total wait time
+void dump();
+
+// Used by InstrumentedMutex
+int siteIndex(const char* mutexName, const char* file, int line);
+void recordLock(int site, int64_t waitNs, int holderSite);
+void recordUnlock(int site, int64_t holdNs);
+int64_t nowNs();
+} // namespace LockTelemetry
+
+
+// std::mutex that reports to LockTelemetry. Meets the Lockable requirements, but locks via std::lock_guard
+// or std::unique_lock are attributed to the standard library header, use TrackedLock instead.
+class InstrumentedMutex
+{
+  public:
+	explicit InstrumentedMutex(const char* name) :
+		m_name(name),
+		m_holder(-1),
+		m_lockedAt(0)
+	{
+	}
+
+	// Returns whether the mutex was contended
+	bool lock(const char* file = __builtin_FILE(), int line = __builtin_LINE())
+	{
+		if (!LockTelemetry::enabled())
+		{
+			const bool contended = !m_mutex.try_lock();
+			if (contended)
+				m_mutex.lock();
+			m_holder = -1;
+			return contended;
+		}
+
+		const int site = LockTelemetry::siteIndex(m_name, file, line);
+		int64_t waitNs = 0;
+		int holder = -1;
+		const bool contended = !m_mutex.try_lock();
+		if (contended)
+		{
+			holder = m_holder.load(std::memory_order_relaxed);
+			const int64_t start = LockTelemetry::nowNs();
+			m_mutex.lock();
+			waitNs = LockTelemetry::nowNs() - start;
+		}
+		m_holder.store(site, std::memory_order_relaxed);
+		m_lockedAt = LockTelemetry::nowNs();
+		LockTelemetry::recordLock(site, waitNs, holder);
+		return contended;
+	}
+
+	bool try_lock()
+	{
+		if (!m_mutex.try_lock())
+			return false;
+		m_holder = -1;
+		return true;
+	}
+
+	void unlock()
+	{
+		const int site = m_holder.load(std::memory_order_relaxed);
+		if (site >= 0)
+		{
+			LockTelemetry::recordUnlock(site, LockTelemetry::nowNs() - m_lockedAt);
+			m_holder.store(-1, std::memory_order_relaxed);
+		}
+		m_mutex.unlock();
+	}
+
+	InstrumentedMutex(const InstrumentedMutex&) = delete;
+	InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+  private:
+	std::mutex m_mutex;
+	const char* const m_name;
+	std::atomic<int> m_holder; // Site holding the mutex, -1 if unknown
+	int64_t m_lockedAt; // Only accessed by the holder
+};
+
+
+// Lock mutex on behalf of file:line, returns whether it was contended
+inline bool LockAt(std::mutex& mutex, const char*, int)
+{
+	if (mutex.try_lock())
+		return false;
+	mutex.lock();
+	return true;
+}
+
+inline bool LockAt(InstrumentedMutex& mutex, const char* file, int line)
+{
+	return mutex.lock(file, line);
+}
+
+
+// lock_guard that passes its own location on to InstrumentedMutex
+template <class Mutex> class TrackedLock
+{
+  public:
+	explicit TrackedLock(Mutex& mutex, const char* file = __builtin_FILE(), int line = __builtin_LINE()) :
+		m_mutex(mutex)
+	{
+		LockAt(m_mutex, file, line);
+	}
+
+	~TrackedLock()
+	{
+		m_mutex.unlock();
+	}
+
+	TrackedLock(const TrackedLock&) = delete;
+	TrackedLock& operator=(const TrackedLock&) = delete;
+
+  private:
+	Mutex& m_mutex;
+};
@@ -32,11 +32,15 @@
 #include "ExpandableSection.h"
 #include "samples.h"
 #include "SoundButton.h"
+#include "LevelMeterWidget.h"
 
 #ifdef _WIN32
 #include "Windows.h"
 #endif
 
+// Refresh interval of the level meters in ms
+#define METER_FRAME_INTERVAL 33
+
 enum button_choices_e
 {
 	BC_CHOOSE = 0,
@@ -155,8 +159,29 @@ MainWindow::MainWindow(ConfigModel* model, QWidget* parent /*= 0*/) :
 	m_themeButton->setIconSize(QSize(20, 20));
 	m_themeButton->setToolTip("Toggle dark/light mode");
 	connect(m_themeButton, &QPushButton::clicked, this, &MainWindow::onThemeButtonClicked);
+
+	QVBoxLayout* meterLayout = new QVBoxLayout();
+	meterLayout->setSpacing(2);
+	m_meterRemote = new LevelMeterWidget(this);
+	m_meterRemote->setToolTip("Level sent to the channel");
+	meterLayout->addWidget(m_meterRemote);
+	m_meterLocal = new LevelMeterWidget(this);
+	m_meterLocal->setToolTip("Level played back locally");
+	meterLayout->addWidget(m_meterLocal);
+	ui->mainControlLineLayout->addLayout(meterLayout);
+
 	ui->mainControlLineLayout->addWidget(m_themeButton);
 
+	// Follows the sound playing, dragging it seeks at most once per meter frame
+	m_scrubTarget = -1;
+	m_scrubBar = new QSlider(Qt::Horizontal, this);
+	m_scrubBar->setToolTip("Position of the sound playing, drag to seek");
+	m_scrubBar->setEnabled(false);
+	ui->mainControlLineLayout->insertWidget(ui->mainControlLineLayout->indexOf(ui->playingLabel) + 1, m_scrubBar);
+	connect(m_scrubBar, &QSlider::sliderMoved, this, &MainWindow::onScrubBarMoved);
+	connect(m_scrubBar, &QSlider::sliderReleased, this, &MainWindow::onScrubBarReleased);
+	connect(m_scrubBar, &QSlider::actionTriggered, this, &MainWindow::onScrubBarAction);
+
 	settingsSection = new ExpandableSection("Settings", 200, this);
 	settingsSection->setContentLayout(*ui->settingsWidget->layout());
 	layout()->addWidget(settingsSection);
@@ -238,6 +263,11 @@ MainWindow::MainWindow(ConfigModel* model, QWidget* parent /*= 0*/) :
 	playingIconTimer->setInterval(150);
 	connect(playingIconTimer, SIGNAL(timeout()), this, SLOT(onPlayingIconTimer()));
 
+	m_meterTimer = new QTimer(this);
+	m_meterTimer->setInterval(METER_FRAME_INTERVAL);
+	connect(m_meterTimer, SIGNAL(timeout()), this, SLOT(onMeterTimer()));
+	m_meterTimer->start();
+
 	Sampler* sampler = sb_getSampler();
 	connect(
 		sampler, SIGNAL(onStartPlaying(bool, QString)), this, SLOT(onStartPlayingSound(bool, QString)),
@@ -452,10 +482,14 @@ void MainWindow::updateButtonText(int i)
 
 	QString text;
 	const SoundInfo* info = m_model->getSoundInfo(i);
-	if (info && !info->filename.isEmpty())
+	if (info && (!info->filename.isEmpty() || info->isPlaylist() || info->isMacro()))
 	{
 		if (!info->customText.isEmpty())
 			text = unescapeCustomText(info->customText);
+		else if (info->isMacro())
+			text = "(macro)";
+		else if (info->isPlaylist())
+			text = "(playlist)";
 		else
 			text = QFileInfo(info->filename).baseName();
 	}
@@ -686,6 +720,53 @@ void MainWindow::onPlayingIconTimer()
 }
 
 
+void MainWindow::onMeterTimer()
+{
+	if (!isVisible())
+		return;
+
+	Sampler* sampler = sb_getSampler();
+	m_meterRemote->setLevels(sampler->getLevels(Sampler::eMETER_CAPTURE));
+	m_meterLocal->setLevels(sampler->getLevels(Sampler::eMETER_PLAYBACK));
+
+	if (m_scrubTarget >= 0)
+	{
+		sampler->seekPlayback((double)m_scrubTarget / 1000.0);
+		m_scrubTarget = -1;
+	}
+
+	double position, length;
+	const bool seekable = sampler->getPlaybackPosition(position, length);
+	m_scrubBar->setEnabled(seekable);
+	if (!m_scrubBar->isSliderDown())
+	{
+		m_scrubBar->setMaximum(seekable ? (int)(length * 1000.0) : 0);
+		m_scrubBar->setValue(seekable ? (int)(position * 1000.0) : 0);
+	}
+}
+
+
+void MainWindow::onScrubBarMoved(int value)
+{
+	m_scrubTarget = value;
+}
+
+
+void MainWindow::onScrubBarReleased()
+{
+	m_scrubTarget = -1;
+	sb_getSampler()->seekPlayback((double)m_scrubBar->value() / 1000.0);
+}
+
+
+// Clicks beside the handle and keys, dragging is handled by onScrubBarMoved()
+void MainWindow::onScrubBarAction(int action)
+{
+	if (action != QAbstractSlider::SliderMove)
+		sb_getSampler()->seekPlayback((double)m_scrubBar->sliderPosition() / 1000.0);
+}
+
+
 void MainWindow::openHotkeySetDialog(size_t buttonId)
 {
 	openHotkeySetDialog(buttonId, this);
@@ -914,7 +995,7 @@ void MainWindow::onFilterEditTextChanged(const QString& text)
 	{
 		int buttonId = button->property("buttonId").toInt();
 		const SoundInfo* info = m_model->getSoundInfo(buttonId);
-		bool hasFile = info && !info->filename.isEmpty();
+		bool hasFile = info && (!info->filename.isEmpty() || info->isPlaylist() || info->isMacro());
 		QString buttonText = button->text();
 		bool pass = filter.length() == 0 || (hasFile && buttonText.contains(filter, Qt::CaseInsensitive));
 		button->setVisible(pass);
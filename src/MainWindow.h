@@ -19,6 +19,7 @@
 #include <QList>
 #include <QUrl>
 #include <QRadioButton>
+#include <QSlider>
 
 
 #include "ui_MainWindow.h"
@@ -28,6 +29,7 @@
 class SpeechBubble;
 class ExpandableSection;
 class SoundButton;
+class LevelMeterWidget;
 
 namespace Ui
 {
@@ -78,6 +80,10 @@ class MainWindow : public QWidget
 	void onPausePlayingSound();
 	void onUnpausePlayingSound();
 	void onPlayingIconTimer();
+	void onMeterTimer();
+	void onScrubBarMoved(int value);
+	void onScrubBarReleased();
+	void onScrubBarAction(int action);
 	void onUpdateShowHotkeysOnButtons(bool val);
 	void onUpdateHotkeysDisabled(bool val);
 	void onButtonFileDropped(const QList<QUrl>& urls);
@@ -140,11 +146,16 @@ class MainWindow : public QWidget
 	ExpandableSection* configsSection;
 	QTimer* playingIconTimer;
 	int playingIconIndex;
+	QTimer* m_meterTimer;
+	LevelMeterWidget* m_meterRemote;
+	LevelMeterWidget* m_meterLocal;
 	QIcon m_pauseIcon;
 	QIcon m_playIcon;
 	std::array<QRadioButton*, NUM_CONFIGS> m_configRadioButtons;
 	std::array<QPushButton*, NUM_CONFIGS> m_configHotkeyButtons;
 	QPushButton* m_themeButton;
+	QSlider* m_scrubBar;
+	int m_scrubTarget; // Position in ms the scrub bar was dragged to since the last seek, -1 if none
 	std::array<QPixmap, 4> m_speakerPixmapsLight;
 	std::array<QPixmap, 4> m_speakerPixmapsDark;
 };
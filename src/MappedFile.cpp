@@ -0,0 +1,349 @@
+// src/MappedFile.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <string.h>
+#ifdef __APPLE__
+#include <sys/mount.h>
+#else
+#include <sys/vfs.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+#include "MappedFile.h"
+
+// Number of mappings kept alive after their last user released them,
+// so replaying a sound does not need to map it again.
+#define WARM_MAPPINGS 8
+
+// Size of the read-ahead window requested when mapping or seeking
+#define WILLNEED_WINDOW (1024 * 1024)
+
+
+namespace
+{
+std::mutex g_cacheMutex;
+std::map<std::string, std::weak_ptr<MappedFile>> g_mappings;
+std::list<std::shared_ptr<MappedFile>> g_warm; // most recently used first
+
+#ifdef _WIN32
+std::wstring toWide(const char* utf8)
+{
+	int len = MultiByteToWideChar(CP_UTF8, 0, utf8, -1, nullptr, 0);
+	if (len <= 0)
+		return std::wstring();
+	std::wstring result(len, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, utf8, -1, &result[0], len);
+	result.resize(len - 1);
+	return result;
+}
+#endif
+
+// Get size and modification time of a file, returns false if it doesn't exist
+bool statFile(const char* filename, int64_t& size, int64_t& mtime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExW(toWide(filename).c_str(), GetFileExInfoStandard, &attr))
+		return false;
+	size = ((int64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+	mtime = ((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32) | attr.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+	size = (int64_t)st.st_size;
+	mtime = (int64_t)st.st_mtime;
+#endif
+	return true;
+}
+
+
+// Whether filename is on a local fixed disk. Mapped files on network shares or removable drives can vanish
+// at any time, and every access to the mapping would fault then.
+bool isLocalFixed(const char* filename)
+{
+#ifdef _WIN32
+	wchar_t volume[MAX_PATH];
+	if (!GetVolumePathNameW(toWide(filename).c_str(), volume, MAX_PATH))
+		return false;
+	return GetDriveTypeW(volume) == DRIVE_FIXED;
+#elif defined(__APPLE__)
+	struct statfs fs;
+	return statfs(filename, &fs) == 0 && (fs.f_flags & MNT_LOCAL) != 0;
+#else
+	struct statfs fs;
+	if (statfs(filename, &fs) != 0)
+		return false;
+	switch ((uint32_t)fs.f_type)
+	{
+	case 0x6969: // NFS
+	case 0x517B: // SMB
+	case 0xFF534D42: // CIFS
+	case 0xFE534D42: // SMB2
+	case 0x564C: // NCP
+	case 0x5346414F: // AFS
+	case 0x73757245: // Coda
+	case 0x00C36400: // Ceph
+	case 0x01021997: // 9P
+	case 0x65735546: // FUSE, e.g. sshfs
+		return false;
+	default:
+		return true;
+	}
+#endif
+}
+
+
+#ifndef _WIN32
+// Set while the calling thread copies from a mapping, a SIGBUS then jumps back into MappedFile::read()
+thread_local sigjmp_buf* volatile t_faultJump = nullptr;
+struct sigaction g_previousBusAction;
+
+
+void onBusError(int sig, siginfo_t* info, void* context)
+{
+	if (t_faultJump)
+		siglongjmp(*t_faultJump, 1);
+
+	// Not caused by reading a mapping, leave it to whoever handled it before
+	if (g_previousBusAction.sa_flags & SA_SIGINFO)
+		g_previousBusAction.sa_sigaction(sig, info, context);
+	else if (g_previousBusAction.sa_handler != SIG_DFL && g_previousBusAction.sa_handler != SIG_IGN)
+		g_previousBusAction.sa_handler(sig);
+	else
+	{
+		signal(SIGBUS, SIG_DFL);
+		raise(SIGBUS);
+	}
+}
+
+
+void installBusHandler()
+{
+	static std::once_flag once;
+	std::call_once(once, [] {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = &onBusError;
+		// Nothing is blocked while handling it, so jumping out doesn't need to restore the signal mask
+		action.sa_flags = SA_SIGINFO | SA_NODEFER;
+		sigemptyset(&action.sa_mask);
+		sigaction(SIGBUS, &action, &g_previousBusAction);
+	});
+}
+#endif
+} // namespace
+
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0),
+	m_mtime(0)
+#ifdef _WIN32
+	,
+	m_fileHandle(INVALID_HANDLE_VALUE),
+	m_mappingHandle(nullptr)
+#endif
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+
+std::shared_ptr<MappedFile> MappedFile::Open(const char* filename)
+{
+	int64_t size = 0, mtime = 0;
+	if (!statFile(filename, size, mtime) || size <= 0 || !isLocalFixed(filename))
+		return nullptr;
+
+#ifndef _WIN32
+	installBusHandler();
+#endif
+
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+
+	std::shared_ptr<MappedFile> file;
+	auto it = g_mappings.find(filename);
+	if (it != g_mappings.end())
+		file = it->second.lock();
+
+	// Reuse the existing mapping only if the file didn't change in the meantime
+	if (!file || file->m_size != size || file->m_mtime != mtime)
+	{
+		file.reset(new MappedFile());
+		if (!file->map(filename, size))
+			return nullptr;
+		file->m_mtime = mtime;
+		g_mappings[filename] = file;
+	}
+
+	// Move to the front of the warm list, evict the least recently used ones
+	g_warm.remove_if([filename](const std::shared_ptr<MappedFile>& f) { return f->m_filename == filename; });
+	g_warm.push_front(file);
+	while (g_warm.size() > WARM_MAPPINGS)
+		g_warm.pop_back();
+
+	// Forget expired mappings
+	for (auto i = g_mappings.begin(); i != g_mappings.end();)
+		i = i->second.expired() ? g_mappings.erase(i) : std::next(i);
+
+	file->willNeed(0, WILLNEED_WINDOW);
+	return file;
+}
+
+
+void MappedFile::ClearCache()
+{
+	std::lock_guard<std::mutex> lock(g_cacheMutex);
+	g_warm.clear();
+}
+
+
+bool MappedFile::GetFileInfo(const char* filename, int64_t& size, int64_t& mtime)
+{
+	return statFile(filename, size, mtime);
+}
+
+
+bool MappedFile::map(const char* filename, int64_t size)
+{
+	m_filename = filename;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(
+		toWide(filename).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_fileHandle = file;
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return false;
+	m_mappingHandle = mapping;
+
+	m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+		return false;
+#else
+	if ((uint64_t)size > (uint64_t)SIZE_MAX)
+		return false;
+
+	int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	void* data = mmap(nullptr, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // The mapping stays valid without the descriptor
+	if (data == MAP_FAILED)
+		return false;
+	m_data = (const uint8_t*)data;
+
+	madvise(data, (size_t)size, MADV_SEQUENTIAL);
+#endif
+
+	m_size = size;
+	return true;
+}
+
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (m_data)
+		munmap((void*)m_data, (size_t)m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+
+bool MappedFile::read(int64_t offset, void* dest, size_t length) const
+{
+	if (!m_data || offset < 0 || offset > m_size || (int64_t)length > m_size - offset)
+		return false;
+
+#ifdef _WIN32
+	__try
+	{
+		memcpy(dest, m_data + offset, length);
+	}
+	__except (
+		GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH
+	)
+	{
+		return false;
+	}
+#else
+	// Without saving the signal mask, which would cost a syscall on every read
+	sigjmp_buf jump;
+	if (sigsetjmp(jump, 0) != 0)
+	{
+		t_faultJump = nullptr;
+		return false;
+	}
+	// The fences keep the compiler from moving the copy out of the guarded section or dropping the first store
+	t_faultJump = &jump;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	memcpy(dest, m_data + offset, length);
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	t_faultJump = nullptr;
+#endif
+	return true;
+}
+
+
+void MappedFile::willNeed(int64_t offset, int64_t length) const
+{
+#ifndef _WIN32
+	if (!m_data || offset >= m_size)
+		return;
+
+	// madvise wants page aligned addresses
+	const int64_t pageSize = (int64_t)sysconf(_SC_PAGESIZE);
+	int64_t begin = offset - (offset % pageSize);
+	int64_t end = std::min(offset + length, m_size);
+	madvise((void*)(m_data + begin), (size_t)(end - begin), MADV_WILLNEED);
+#else
+	// The sequential scan flag on the file handle already makes Windows read ahead
+	(void)offset;
+	(void)length;
+#endif
+}
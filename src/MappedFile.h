@@ -0,0 +1,69 @@
+// src/MappedFile.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+
+// Read-only memory mapped view of a whole file.
+// Mappings are shared: opening the same file again while it is still mapped (or was
+// mapped recently) returns the existing mapping instead of mapping it again.
+// Only files on local fixed disks are mapped. Touching a mapping whose file was truncated still faults,
+// so its contents are only read through read(), which turns the fault into an error.
+class MappedFile
+{
+  public:
+	~MappedFile();
+
+	// Map filename (UTF-8). Returns nullptr if the file cannot be mapped or is not on a local fixed disk.
+	static std::shared_ptr<MappedFile> Open(const char* filename);
+
+	// Drop all recently used mappings that are not in use anymore
+	static void ClearCache();
+
+	// Get size and modification time of filename (UTF-8), returns false if it is not a regular file
+	static bool GetFileInfo(const char* filename, int64_t& size, int64_t& mtime);
+
+	// Copy length bytes at offset to dest. Returns false if they are out of range or could not be read from the
+	// disk, e.g. because the file was truncated while mapped.
+	bool read(int64_t offset, void* dest, size_t length) const;
+
+	inline int64_t size() const
+	{
+		return m_size;
+	}
+
+	inline const std::string& filename() const
+	{
+		return m_filename;
+	}
+
+	// Hint the OS that [offset, offset + length) will be read soon
+	void willNeed(int64_t offset, int64_t length) const;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+  private:
+	MappedFile();
+	bool map(const char* filename, int64_t size);
+	void unmap();
+
+  private:
+	std::string m_filename;
+	const uint8_t* m_data;
+	int64_t m_size;
+	int64_t m_mtime;
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#endif
+};
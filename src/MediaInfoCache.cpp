@@ -0,0 +1,430 @@
+// src/MediaInfoCache.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <vector>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include "MediaInfoCache.h"
+#include "MappedFile.h"
+#include "SampleProducer.h"
+#include "inputfile.h"
+#include "ts3log.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#define STORE_MAGIC 0x52504d49 // "RPMI"
+#define STORE_VERSION 2
+
+// Samples decoded per readSamples call are limited by the input file, this is just the scratch size
+#define COUNT_BUFFER_SAMPLES 32768
+
+
+namespace
+{
+// Consumes decoded samples by only counting them
+class SampleCounter : public SampleProducer
+{
+  public:
+	SampleCounter() :
+		m_scratch(COUNT_BUFFER_SAMPLES),
+		m_count(0)
+	{
+	}
+
+	void produce(const short* /*samples*/, int count) override
+	{
+		m_count += count;
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		if ((size_t)maxCount > m_scratch.size())
+			m_scratch.resize(maxCount);
+		*samples = m_scratch.data();
+		return maxCount;
+	}
+
+	void commit(int count) override
+	{
+		m_count += count;
+	}
+
+	inline int64_t count() const
+	{
+		return m_count;
+	}
+
+  private:
+	std::vector<short> m_scratch;
+	int64_t m_count;
+};
+
+
+// Returns 0 if the file could not be read to its end
+// Read sequentially rather than mapped, mapping every file of the library would push the warm mappings of the
+// sounds being played out
+uint64_t hashContents(const std::string& filename)
+{
+	QFile file(QString::fromUtf8(filename.c_str()));
+	if (!file.open(QIODevice::ReadOnly))
+		return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	uint8_t chunk[65536];
+	qint64 length;
+	while ((length = file.read((char*)chunk, sizeof(chunk))) > 0)
+	{
+		for (qint64 i = 0; i < length; i++)
+		{
+			hash ^= chunk[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+	return length < 0 ? 0 : hash;
+}
+} // namespace
+
+
+static QDataStream& operator<<(QDataStream& s, const MediaInfo& info)
+{
+	return s << info.codec << (qint32)info.sampleRate << (qint32)info.channels << (qint64)info.bitRate
+			 << (qint64)info.numSamples << (qint64)info.fileSize << (qint64)info.fileMTime
+			 << (quint64)info.contentHash << info.exact;
+}
+
+
+static QDataStream& operator>>(QDataStream& s, MediaInfo& info)
+{
+	qint32 sampleRate, channels;
+	qint64 bitRate, numSamples, fileSize, fileMTime;
+	quint64 contentHash;
+	s >> info.codec >> sampleRate >> channels >> bitRate >> numSamples >> fileSize >> fileMTime >> contentHash >>
+		info.exact;
+	info.sampleRate = sampleRate;
+	info.channels = channels;
+	info.bitRate = bitRate;
+	info.numSamples = numSamples;
+	info.fileSize = fileSize;
+	info.fileMTime = fileMTime;
+	info.contentHash = contentHash;
+	return s;
+}
+
+
+MediaInfoCache::~MediaInfoCache()
+{
+	shutdown();
+}
+
+
+MediaInfoCache& MediaInfoCache::GetInstance()
+{
+	static MediaInfoCache cache;
+	return cache;
+}
+
+
+void MediaInfoCache::load(const QString& path)
+{
+	shutdown();
+
+	{
+		Lock lock(m_mutex);
+		m_path = path;
+		m_stop = false;
+		if (!readStore())
+			m_infos.clear();
+		m_dirty = false;
+	}
+
+	m_thread = std::thread([this] { run(); });
+}
+
+
+void MediaInfoCache::shutdown()
+{
+	{
+		Lock lock(m_mutex);
+		m_stop = true;
+	}
+	m_cond.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	Lock lock(m_mutex);
+	m_queue.clear();
+	if (m_dirty && writeStore(m_infos))
+		m_dirty = false;
+}
+
+
+bool MediaInfoCache::get(const QString& filename, MediaInfo& info) const
+{
+	Lock lock(m_mutex);
+	auto it = m_infos.constFind(filename);
+	if (it == m_infos.constEnd())
+		return false;
+	info = it.value();
+	return true;
+}
+
+
+double MediaInfoCache::duration(const QString& filename) const
+{
+	Lock lock(m_mutex);
+	auto it = m_infos.constFind(filename);
+	return it != m_infos.constEnd() ? it.value().duration() : -1.0;
+}
+
+
+void MediaInfoCache::request(const QString& filename)
+{
+	if (filename.isEmpty())
+		return;
+
+	{
+		Lock lock(m_mutex);
+		m_queue.push_back(filename);
+	}
+	m_cond.notify_one();
+}
+
+
+void MediaInfoCache::setExactLength(bool enabled)
+{
+	{
+		Lock lock(m_mutex);
+		if (m_exactLength == enabled)
+			return;
+		m_exactLength = enabled;
+		if (!enabled)
+			return;
+		for (auto it = m_infos.constBegin(); it != m_infos.constEnd(); ++it)
+		{
+			if (!it.value().exact)
+				m_queue.push_back(it.key());
+		}
+	}
+	m_cond.notify_one();
+}
+
+
+int MediaInfoCache::bufferHint(const QString& filename) const
+{
+	Lock lock(m_mutex);
+	auto it = m_infos.constFind(filename);
+	return it != m_infos.constEnd() ? it.value().bufferSamples : 0;
+}
+
+
+void MediaInfoCache::setBufferHint(const QString& filename, int samples)
+{
+	Lock lock(m_mutex);
+	auto it = m_infos.find(filename);
+	if (it == m_infos.end() || it.value().bufferSamples == samples)
+		return;
+	it.value().bufferSamples = samples;
+	m_dirty = true;
+}
+
+
+void MediaInfoCache::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		if (m_queue.empty())
+		{
+			// Persist new results as soon as there is nothing left to do. Copying the hash is cheap
+			// because it is shared until modified, so lookups are not blocked while writing.
+			if (m_dirty)
+			{
+				const QHash<QString, MediaInfo> infos = m_infos;
+				m_dirty = false;
+				lock.unlock();
+				bool written = writeStore(infos);
+				lock.lock();
+				m_dirty = m_dirty || !written;
+			}
+			m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			continue;
+		}
+
+		const QString filename = m_queue.front();
+		m_queue.pop_front();
+
+		const std::string filenameUtf8 = filename.toUtf8().toStdString();
+		int64_t size = 0, mtime = 0;
+		if (!MappedFile::GetFileInfo(filenameUtf8.c_str(), size, mtime))
+		{
+			if (m_infos.remove(filename) > 0)
+				m_dirty = true;
+			continue;
+		}
+
+		auto it = m_infos.constFind(filename);
+		if (it != m_infos.constEnd() && it.value().fileSize == size && it.value().fileMTime == mtime &&
+			(it.value().exact || !m_exactLength))
+			continue; // Still up to date
+
+		// Examining may mean decoding the whole file, don't block lookups meanwhile
+		MediaInfo info;
+		info.fileSize = size;
+		info.fileMTime = mtime;
+		info.exact = m_exactLength;
+		lock.unlock();
+		const bool valid = examine(filenameUtf8, info);
+		lock.lock();
+
+		if (valid)
+		{
+			// The buffer hint was measured on the same file, unless it changed
+			auto old = m_infos.constFind(filename);
+			if (old != m_infos.constEnd() && old.value().fileSize == size && old.value().fileMTime == mtime)
+				info.bufferSamples = old.value().bufferSamples;
+			m_infos.insert(filename, info);
+		}
+		else
+			m_infos.remove(filename);
+		m_dirty = true;
+	}
+}
+
+
+bool MediaInfoCache::examine(const std::string& filename, MediaInfo& info)
+{
+	AVFormatContext* fmtCtx = nullptr;
+	if (avformat_open_input(&fmtCtx, filename.c_str(), nullptr, nullptr) != 0)
+		return false;
+
+	bool valid = false;
+	if (avformat_find_stream_info(fmtCtx, nullptr) >= 0)
+	{
+		int streamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+		if (streamIndex >= 0)
+		{
+			const AVCodecParameters* params = fmtCtx->streams[streamIndex]->codecpar;
+			info.codec = QString::fromUtf8(avcodec_get_name(params->codec_id));
+			info.sampleRate = params->sample_rate;
+			info.channels = params->ch_layout.nb_channels;
+			info.bitRate = params->bit_rate > 0 ? params->bit_rate : fmtCtx->bit_rate;
+			valid = info.sampleRate > 0;
+
+			const AVStream* stream = fmtCtx->streams[streamIndex];
+			const AVRational rate = {1, info.sampleRate};
+			const AVRational containerTimeBase = {1, AV_TIME_BASE}; // AV_TIME_BASE_Q is no valid C++
+			if (stream->duration > 0)
+				info.numSamples = av_rescale_q(stream->duration, stream->time_base, rate);
+			else if (fmtCtx->duration > 0)
+				info.numSamples = av_rescale_q(fmtCtx->duration, containerTimeBase, rate);
+		}
+	}
+	avformat_close_input(&fmtCtx);
+	if (!valid)
+		return false;
+
+	// Container durations are estimations for many formats, if asked to count the samples the decoder produces
+	if (info.exact)
+	{
+		InputFileOptions options;
+		options.outputChannelLayout = InputFileOptions::MONO;
+		options.outputSampleRate = info.sampleRate;
+		options.quiet = true;
+		options.pooledDecoder = false;
+		InputFile* file = CreateInputFile(filename.c_str(), options);
+		SampleCounter counter;
+		valid = file->open(filename.c_str()) == 0;
+		while (valid && !file->done() && !m_stop)
+		{
+			if (file->readSamples(&counter) < 0)
+				valid = false;
+		}
+		delete file;
+		if (!valid || m_stop)
+			return false;
+		info.numSamples = counter.count();
+	}
+
+	info.contentHash = hashContents(filename);
+
+	return true;
+}
+
+
+bool MediaInfoCache::readStore()
+{
+	QFile file(m_path);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	quint32 magic, version;
+	stream >> magic >> version;
+	if (magic != STORE_MAGIC || version != STORE_VERSION)
+		return false;
+
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream >> m_infos;
+	if (stream.status() != QDataStream::Ok)
+	{
+		logError("Media info cache %s is damaged", m_path.toUtf8().constData());
+		return false;
+	}
+
+	// Buffer hints follow the infos, stores written before they existed simply end here
+	QHash<QString, qint32> hints;
+	if (!stream.atEnd())
+		stream >> hints;
+	if (stream.status() == QDataStream::Ok)
+	{
+		for (auto it = hints.constBegin(); it != hints.constEnd(); ++it)
+		{
+			auto info = m_infos.find(it.key());
+			if (info != m_infos.end())
+				info.value().bufferSamples = it.value();
+		}
+	}
+	return true;
+}
+
+
+bool MediaInfoCache::writeStore(const QHash<QString, MediaInfo>& infos) const
+{
+	if (m_path.isEmpty())
+		return false;
+
+	// Write to a temporary file first, so a crash never leaves a damaged store behind
+	QSaveFile file(m_path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream << (quint32)STORE_MAGIC << (quint32)STORE_VERSION;
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << infos;
+
+	// Kept apart from the infos, so older versions can still read the store
+	QHash<QString, qint32> hints;
+	for (auto it = infos.constBegin(); it != infos.constEnd(); ++it)
+	{
+		if (it.value().bufferSamples > 0)
+			hints.insert(it.key(), it.value().bufferSamples);
+	}
+	stream << hints;
+	return file.commit();
+}
@@ -0,0 +1,99 @@
+// src/MediaInfoCache.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <QHash>
+#include <QString>
+
+
+// Facts about a sound file that would otherwise require opening it with FFmpeg
+struct MediaInfo
+{
+	QString codec;
+	int sampleRate = 0;
+	int channels = 0;
+	int64_t bitRate = 0;
+	int64_t numSamples = 0; // Length in samples at sampleRate, 0 if unknown
+	bool exact = false; // numSamples was counted by decoding the whole file, else it is the container duration
+	int64_t fileSize = 0;
+	int64_t fileMTime = 0;
+	uint64_t contentHash = 0; // 64 bit FNV-1a of the file contents
+	int bufferSamples = 0; // Low watermark the producer needed on the last play, 0 if never measured
+
+	inline double duration() const
+	{
+		return sampleRate > 0 ? (double)numSamples / (double)sampleRate : 0.0;
+	}
+};
+
+
+// Persistent store of MediaInfo for all sound files of the library.
+// Lookups only touch an in-memory hash table and never do any IO. Files are (re)examined
+// on a background thread when requested, entries whose size and modification time still
+// match the file on disk are kept without probing the file again.
+class MediaInfoCache
+{
+  public:
+	~MediaInfoCache();
+
+	static MediaInfoCache& GetInstance();
+
+	// Read the store from disk and start the background worker, does not probe any file
+	void load(const QString& path);
+
+	// Stop the background worker and write the store to disk
+	void shutdown();
+
+	// Get the info about filename. Returns false if the file hasn't been examined (yet).
+	bool get(const QString& filename, MediaInfo& info) const;
+
+	// Length of filename in seconds or a negative value if unknown
+	double duration(const QString& filename) const;
+
+	// Queue filename to be examined in the background, if it is unknown or changed on disk
+	void request(const QString& filename);
+
+	// Count the exact length of files by decoding them instead of trusting the container duration.
+	// Enabling it examines the files known so far again.
+	void setExactLength(bool enabled);
+
+	// Low watermark to start playing filename with, 0 if unknown
+	int bufferHint(const QString& filename) const;
+
+	// Remember the low watermark playing filename needed. Ignored for files that weren't examined,
+	// the hint is dropped together with the rest of the info when the file changes.
+	void setBufferHint(const QString& filename, int samples);
+
+  private:
+	MediaInfoCache() = default;
+	void run();
+	bool examine(const std::string& filename, MediaInfo& info);
+	bool readStore();
+	bool writeStore(const QHash<QString, MediaInfo>& infos) const;
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	QHash<QString, MediaInfo> m_infos;
+	std::deque<QString> m_queue;
+	QString m_path;
+	std::thread m_thread;
+	bool m_dirty = false;
+	bool m_exactLength = false;
+	volatile bool m_stop = false;
+};
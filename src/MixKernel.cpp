@@ -0,0 +1,206 @@
+// src/MixKernel.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "MixKernel.h"
+#include "SampleBuffer.h"
+#include "RtCheck.h"
+
+#include <algorithm>
+#include <math.h>
+
+// Frames mixed per step
+#define KERNEL_CHUNK 128
+
+#define HALF_PI 1.57079632679f
+
+
+float VolumeDbToFactor(double decibel)
+{
+	return (float)pow(10.0, decibel / 10.0);
+}
+
+
+// Linear ramp over count frames, from gain from to gain to (exclusive)
+static void rampFrames(short* frames, int channels, int count, float from, float to)
+{
+	const float step = (to - from) / (float)count;
+	for (int i = 0; i < count; i++)
+	{
+		const float gain = from + step * (float)i;
+		for (int c = 0; c < channels; c++)
+			frames[i * channels + c] = (short)((float)frames[i * channels + c] * gain);
+	}
+}
+
+
+int MixFromBuffer(
+	SampleBuffer& sb, short* samples, int count, const ChannelRouting& routing, unsigned int filledSpeakers,
+	float volume, PeakMeter& limiter, MixStats& stats, unsigned int fade /*= eFADE_NONE*/
+)
+{
+	RtLockGuard<SampleBuffer::Mutex> sbl(sb.getMutex());
+
+	if (sb.avail() == 0)
+		return 0;
+
+	// Channels nobody has written to yet contain garbage, clear them before mixing into them
+	const int channels = routing.numChannels();
+	for (int r = 0; r < routing.numRoutes(); r++)
+	{
+		const ChannelRouting::route_t& route = routing.route(r);
+		if ((route.speaker & filledSpeakers) == 0)
+			for (int i = 0; i < count; i++)
+				samples[i * channels + route.channel] = 0;
+	}
+
+	// Fading works on the buffered frames, they are consumed right after anyway
+	const int write = std::min(count, sb.avail());
+	const int inChannels = sb.channels();
+	short* const frames = sb.getBufferData();
+	const int fadeFrames = std::min(write, UNDERRUN_FADE_FRAMES);
+	if (fade & eFADE_IN)
+		rampFrames(frames, inChannels, fadeFrames, 0.0f, 1.0f);
+	if ((fade & eFADE_OUT_SHORT) && write < count)
+		rampFrames(frames + (write - fadeFrames) * inChannels, inChannels, fadeFrames, 1.0f, 0.0f);
+	MixFrames(frames, inChannels, write, samples, routing, volume, limiter, stats);
+	sb.consume(nullptr, write, true);
+	return write;
+}
+
+
+void MixFrames(
+	const short* in, int inChannels, int count, short* out, const ChannelRouting& routing, float volume,
+	PeakMeter& limiter, MixStats& stats
+)
+{
+	const int channels = routing.numChannels();
+	const int numRoutes = routing.numRoutes();
+
+	stats.soundPeak = stats.soundSumSquares = stats.mixPeak = stats.mixSumSquares = 0.0f;
+
+	// Work in chunks, so every step except the limiter envelope is a simple loop over frames
+	// the compiler can vectorize, no matter how many channels are routed.
+	float left[KERNEL_CHUNK], right[KERNEL_CHUNK], peak[KERNEL_CHUNK], gain[KERNEL_CHUNK];
+	float mixed[MAX_ROUTED_CHANNELS][KERNEL_CHUNK];
+	for (int offset = 0; offset < count; offset += KERNEL_CHUNK)
+	{
+		const int n = std::min(count - offset, KERNEL_CHUNK);
+		const short* const src = in + offset * inChannels;
+		short* const dst = out + offset * channels;
+
+		if (inChannels == 1)
+		{
+			const float spread = volume * MONO_SPREAD_GAIN;
+			for (int i = 0; i < n; i++)
+				left[i] = right[i] = spread * float(src[i]);
+		}
+		else
+		{
+			for (int i = 0; i < n; i++)
+			{
+				left[i] = volume * float(src[i * 2]);
+				right[i] = volume * float(src[i * 2 + 1]);
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			peak[i] = 0.0f;
+			stats.soundPeak = std::max(stats.soundPeak, std::max(fabsf(left[i]), fabsf(right[i])));
+			stats.soundSumSquares += left[i] * left[i] + right[i] * right[i];
+		}
+
+		for (int r = 0; r < numRoutes; r++)
+		{
+			const ChannelRouting::route_t& route = routing.route(r);
+			float* const m = mixed[r];
+			for (int i = 0; i < n; i++)
+			{
+				m[i] = float(dst[i * channels + route.channel]) + route.gainLeft * left[i] + route.gainRight * right[i];
+				peak[i] = std::max(peak[i], fabsf(m[i]));
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			limiter.process(peak[i]);
+			gain[i] = limiter.gain(LIMITER_THRESHOLD);
+			stats.mixPeak = std::max(stats.mixPeak, peak[i] * gain[i]);
+		}
+
+		for (int r = 0; r < numRoutes; r++)
+		{
+			const int c = routing.route(r).channel;
+			const float* const m = mixed[r];
+			for (int i = 0; i < n; i++)
+			{
+				const float sample = m[i] * gain[i];
+				stats.mixSumSquares += sample * sample;
+				dst[i * channels + c] = (short)(sample + 0.5f);
+			}
+		}
+	}
+}
+
+
+static inline short clampSample(float sample)
+{
+	return (short)std::min(std::max(sample, (float)SHRT_MIN), (float)SHRT_MAX);
+}
+
+
+void ConvertFrames(const short* in, int inChannels, short* out, int outChannels, int count, float gain)
+{
+	if (inChannels == outChannels)
+	{
+		for (int i = 0; i < count * outChannels; i++)
+			out[i] = clampSample(gain * float(in[i]));
+	}
+	else if (inChannels == 1)
+	{
+		const float spread = gain * MONO_SPREAD_GAIN;
+		for (int i = 0; i < count; i++)
+			out[i * 2] = out[i * 2 + 1] = clampSample(spread * float(in[i]));
+	}
+	else
+	{
+		const float sum = gain * MONO_SPREAD_GAIN;
+		for (int i = 0; i < count; i++)
+			out[i] = clampSample(sum * (float(in[i * 2]) + float(in[i * 2 + 1])));
+	}
+}
+
+
+void CrossfadeFrames(const short* in, short* out, int channels, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const float t = ((float)i + 0.5f) / (float)count * HALF_PI;
+		const float gainIn = sinf(t);
+		const float gainOut = cosf(t);
+		for (int c = 0; c < channels; c++)
+		{
+			const int s = i * channels + c;
+			out[s] = clampSample(gainOut * float(out[s]) + gainIn * float(in[s]));
+		}
+	}
+}
+
+
+void AccumulateFrames(const short* in, int* out, int samples)
+{
+	for (int i = 0; i < samples; i++)
+		out[i] += in[i];
+}
+
+
+void StoreFrames(const int* in, short* out, int samples)
+{
+	for (int i = 0; i < samples; i++)
+		out[i] = (short)std::min(std::max(in[i], (int)SHRT_MIN), (int)SHRT_MAX);
+}
@@ -0,0 +1,92 @@
+// src/MixKernel.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <limits.h>
+
+#include "peakmeter.h"
+#include "ChannelRouting.h"
+
+class SampleBuffer;
+
+// Level the limiter keeps the output under
+#define LIMITER_THRESHOLD (SHRT_MAX / 2)
+// Attack and release factors and hold time in frames of the limiter envelope
+#define LIMITER_ALPHA 0.01f
+#define LIMITER_BETA 0.00005f
+#define LIMITER_HOLD 24000
+
+// Gain of a mono sound on each side of a stereo pair, -3 dB like FFmpeg's upmix it replaces
+#define MONO_SPREAD_GAIN 0.70710678f
+
+// Length of the fades around an underrun in frames, 5 ms
+#define UNDERRUN_FADE_FRAMES 240
+
+// Fades MixFromBuffer applies to the sound before mixing it, can be combined
+enum mix_fade_e
+{
+	eFADE_NONE = 0,
+	eFADE_IN = 1, // Fade in the first frames taken, after the buffer ran dry
+	eFADE_OUT_SHORT = 2, // Fade out the last frames taken if the buffer can't fill the whole block
+};
+
+
+// Sums a block produced by MixFrames for the level meters
+struct MixStats
+{
+	float soundPeak; // Sound after the volume, before mixing
+	float soundSumSquares;
+	float mixPeak; // Output after the limiter
+	float mixSumSquares;
+};
+
+
+// Envelope follower used as limiter for one output
+inline PeakMeter CreateLimiter()
+{
+	return PeakMeter(LIMITER_ALPHA, LIMITER_BETA, LIMITER_HOLD);
+}
+
+// Linear factor for a volume setting in dB, as the sampler applies it
+float VolumeDbToFactor(double decibel);
+
+// Take up to count mono or stereo frames out of sb and mix them into samples with MixFrames, as an audio
+// callback does. Routed channels whose speaker is not in filledSpeakers contain garbage and are cleared first.
+// Locks sb. Returns the number of frames taken, samples is left untouched if sb is empty.
+// fade: Combination of mix_fade_e, turns the hard edges of an underrun into short fades
+int MixFromBuffer(
+	SampleBuffer& sb, short* samples, int count, const ChannelRouting& routing, unsigned int filledSpeakers,
+	float volume, PeakMeter& limiter, MixStats& stats, unsigned int fade = eFADE_NONE
+);
+
+// The gain -> routing -> limiter chain shared by live playback and offline rendering.
+// Scales count interleaved frames with inChannels (1 or 2) channels from in by volume, adds them to the
+// routed channels of out and limits the sum. Mono frames are spread to both sides with MONO_SPREAD_GAIN.
+// Routed channels of out must be initialized, out has routing.numChannels() channels.
+// Never allocates or locks, safe to call on audio threads.
+void MixFrames(
+	const short* in, int inChannels, int count, short* out, const ChannelRouting& routing, float volume,
+	PeakMeter& limiter, MixStats& stats
+);
+
+// Scale count frames from in by gain and convert them from inChannels to outChannels (1 or 2 each), for sources
+// that join several sounds into one stream. Mono is spread with MONO_SPREAD_GAIN like MixFrames does, so a
+// converted sound plays just as loud. Stereo is summed with the same gain, which undoes the spread.
+void ConvertFrames(const short* in, int inChannels, short* out, int outChannels, int count, float gain);
+
+// Equal power crossfade over count frames: out fades out while in fades in, the sum is written to out.
+// Never allocates or locks.
+void CrossfadeFrames(const short* in, short* out, int channels, int count);
+
+// Add samples interleaved samples from in to the sums in out, for sources that layer several sounds in one stream.
+// Never allocates or locks.
+void AccumulateFrames(const short* in, int* out, int samples);
+
+// Store samples sums made with AccumulateFrames in out, clamped to the range of a short
+void StoreFrames(const int* in, short* out, int samples);
@@ -0,0 +1,225 @@
+// src/OfflineRenderer.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include "common.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "OfflineRenderer.h"
+#include "inputfile.h"
+#include "MixKernel.h"
+#include "HighResClock.h"
+#include "ts3log.h"
+
+#define WAV_HEADER_SIZE 44
+
+
+namespace
+{
+// Collects everything the input file produces in one readSamples call
+class BlockCollector : public SampleProducer
+{
+  public:
+	BlockCollector(int channels) :
+		m_channels(channels),
+		m_reserved(0)
+	{
+	}
+
+	void produce(const short* samples, int count) override
+	{
+		m_samples.insert(m_samples.end(), samples, samples + count * m_channels);
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		m_reserved = m_samples.size();
+		m_samples.resize(m_reserved + maxCount * m_channels);
+		*samples = m_samples.data() + m_reserved;
+		return maxCount;
+	}
+
+	void commit(int count) override
+	{
+		m_samples.resize(m_reserved + count * m_channels);
+	}
+
+	inline int frames() const
+	{
+		return (int)(m_samples.size() / m_channels);
+	}
+
+	inline const short* data() const
+	{
+		return m_samples.data();
+	}
+
+	inline void clear()
+	{
+		m_samples.clear();
+	}
+
+  private:
+	const int m_channels;
+	std::vector<short> m_samples;
+	size_t m_reserved;
+};
+
+
+FILE* openOutput(const char* filename)
+{
+#ifdef _WIN32
+	int len = MultiByteToWideChar(CP_UTF8, 0, filename, -1, nullptr, 0);
+	if (len <= 0)
+		return nullptr;
+	std::wstring wide(len, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, filename, -1, &wide[0], len);
+	return _wfopen(wide.c_str(), L"wb");
+#else
+	return fopen(filename, "wb");
+#endif
+}
+
+
+inline void putLE32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+
+inline void putLE16(uint8_t* p, uint16_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+
+// Header of a 16 bit PCM wave file with dataSize bytes of samples
+void makeWavHeader(uint8_t* header, int channels, int sampleRate, int64_t dataSize)
+{
+	const uint32_t size = (uint32_t)std::min(dataSize, (int64_t)UINT32_MAX - WAV_HEADER_SIZE);
+	memcpy(header, "RIFF", 4);
+	putLE32(header + 4, size + WAV_HEADER_SIZE - 8);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	putLE32(header + 16, 16);
+	putLE16(header + 20, 1); // PCM
+	putLE16(header + 22, (uint16_t)channels);
+	putLE32(header + 24, (uint32_t)sampleRate);
+	putLE32(header + 28, (uint32_t)(sampleRate * channels * 2));
+	putLE16(header + 32, (uint16_t)(channels * 2));
+	putLE16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	putLE32(header + 40, size);
+}
+} // namespace
+
+
+int RenderOffline(const RenderJob& job, RenderResult& result)
+{
+	result.frames = 0;
+	result.renderSeconds = 0.0;
+
+	if (job.channels < 1 || job.channels > 2 || job.sampleRate <= 0)
+	{
+		logError("Cannot render %s: unsupported output format", job.input.c_str());
+		return -1;
+	}
+
+	const HighResClock::time_point start = HighResClock::now();
+
+	InputFileOptions options;
+	options.outputSampleRate = job.sampleRate;
+	options.pooledDecoder = false; // Renders run on many threads at once and would cycle the whole pool
+	std::unique_ptr<InputFile> file(CreateInputFile(job.input.c_str(), options));
+	if (file->open(job.input.c_str(), job.startTime, job.playTime) != 0)
+		return -1;
+
+	// Passed through samples keep the channels of the source
+	const int channels = job.passthrough ? file->channels() : job.channels;
+
+	FILE* out = openOutput(job.output.c_str());
+	if (!out)
+	{
+		logError("Cannot open %s for writing", job.output.c_str());
+		return -1;
+	}
+
+	// Reserve room for the header, it is written once the size is known
+	uint8_t header[WAV_HEADER_SIZE];
+	bool ok = true;
+	if (job.format == RenderJob::eFORMAT_WAV)
+	{
+		makeWavHeader(header, channels, job.sampleRate, 0);
+		ok = fwrite(header, 1, WAV_HEADER_SIZE, out) == WAV_HEADER_SIZE;
+	}
+
+	ChannelRouting routing;
+	routing.build(channels, nullptr);
+	PeakMeter limiter = CreateLimiter();
+	const float volume = VolumeDbToFactor(job.volumeDb);
+
+	BlockCollector block(file->channels());
+	std::vector<short> mixed;
+	MixStats stats;
+	int read = 0;
+	while (ok && (read = file->readSamples(&block)) > 0)
+	{
+		const int frames = block.frames();
+		const short* samples = block.data();
+		if (!job.passthrough)
+		{
+			mixed.assign((size_t)frames * channels, 0);
+			MixFrames(block.data(), file->channels(), frames, mixed.data(), routing, volume, limiter, stats);
+			samples = mixed.data();
+		}
+		ok = fwrite(samples, sizeof(short) * channels, frames, out) == (size_t)frames;
+		result.frames += frames;
+		block.clear();
+	}
+
+	if (ok && job.format == RenderJob::eFORMAT_WAV)
+	{
+		makeWavHeader(header, channels, job.sampleRate, result.frames * channels * 2);
+		ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(header, 1, WAV_HEADER_SIZE, out) == WAV_HEADER_SIZE;
+	}
+	ok = fclose(out) == 0 && ok;
+	file->close();
+
+	std::chrono::duration<double> elapsed = HighResClock::now() - start;
+	result.renderSeconds = elapsed.count();
+
+	if (read < 0)
+	{
+		logError("Error decoding %s", job.input.c_str());
+		return -1;
+	}
+	if (!ok)
+	{
+		logError("Error writing %s", job.output.c_str());
+		return -1;
+	}
+
+	logInfo(
+		"Rendered %s to %s: %.2f s in %.3f s (%.1fx real-time)", job.input.c_str(), job.output.c_str(),
+		result.audioSeconds(job.sampleRate), result.renderSeconds, result.realtimeFactor(job.sampleRate)
+	);
+	return 0;
+}
@@ -0,0 +1,69 @@
+// src/OfflineRenderer.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+
+// Everything needed to render one sound to a file. Kept free of Qt types, so the engine links
+// into the headless render tool as well.
+struct RenderJob
+{
+	enum format_e
+	{
+		eFORMAT_WAV = 0, // 16 bit PCM wave file
+		eFORMAT_RAW, // Interleaved signed 16 bit little endian samples, no header
+	};
+
+	std::string input; // UTF-8
+	double startTime; // Seconds, like SoundInfo::getStartTime()
+	double playTime; // Seconds or -1 for the whole file, like SoundInfo::getPlayTime()
+	double volumeDb; // Sound volume plus global volume
+	bool passthrough; // Write the decoded samples as they are, without volume and limiter, mono stays mono
+
+	std::string output; // UTF-8
+	format_e format;
+	int sampleRate;
+	int channels; // 1 or 2, ignored with passthrough
+
+	RenderJob() :
+		startTime(0.0),
+		playTime(-1.0),
+		volumeDb(0.0),
+		passthrough(false),
+		format(eFORMAT_WAV),
+		sampleRate(48000),
+		channels(2)
+	{
+	}
+};
+
+
+struct RenderResult
+{
+	int64_t frames; // Number of frames written
+	double renderSeconds; // Wall clock time the render took
+
+	inline double audioSeconds(int sampleRate) const
+	{
+		return (double)frames / (double)sampleRate;
+	}
+
+	// How many times faster than real time the render ran
+	inline double realtimeFactor(int sampleRate) const
+	{
+		return renderSeconds > 0.0 ? audioSeconds(sampleRate) / renderSeconds : 0.0;
+	}
+};
+
+
+// Decode, scale and limit a sound with the same chain the sampler uses for live playback, as fast as
+// the CPU allows. Runs on the calling thread. Returns 0 on success.
+int RenderOffline(const RenderJob& job, RenderResult& result);
@@ -0,0 +1,146 @@
+// src/RenderTool.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+// Headless command line front end of the offline renderer. Links the playback engine without the
+// plugin and Qt widgets, e.g. to pre-render boards or to benchmark the whole chain.
+
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <filesystem>
+#include <vector>
+
+#include "OfflineRenderer.h"
+#include "SelfCheck.h"
+#include "CodecBenchmark.h"
+
+/*static*/ struct TS3Functions ts3Functions;
+
+static bool g_verbose = false;
+
+
+static unsigned int printLog(const char* message, enum LogLevel severity, const char* channel, uint64 logID)
+{
+	(void)channel;
+	(void)logID;
+	if (g_verbose || severity <= LogLevel_WARNING)
+		fprintf(stderr, "%s\n", message);
+	return ERROR_ok;
+}
+
+
+static void printUsage()
+{
+	fprintf(
+		stderr,
+		"Usage: rpsb_render [options] <input> <output>\n"
+		"       rpsb_render --selfcheck <golden file> [--record] [--workdir <dir>] [--repeat <n>]\n"
+		"       rpsb_render --codec-bench [--repeat <n>] <input>...\n"
+		"  --raw          Write raw 16 bit samples instead of a wave file\n"
+		"  --mono         Write one channel instead of two\n"
+		"  --rate <hz>    Output sample rate, default 48000\n"
+		"  --start <s>    Start position in seconds\n"
+		"  --length <s>   Render at most this many seconds\n"
+		"  --volume <db>  Volume as set on the button plus the global volume\n"
+		"  --repeat <n>   Render n times and report the average speed\n"
+		"  --verbose      Print all log messages\n"
+		"  --selfcheck    Compare the engine output for generated fixtures against the golden hashes\n"
+		"  --record       Write the golden hashes instead of comparing against them\n"
+		"  --workdir      Directory for the fixture files, default is the temp directory\n"
+		"  --codec-bench  Compare compression ratio and decode speed of the head cache codec on the inputs\n"
+	);
+}
+
+
+int main(int argc, char** argv)
+{
+	ts3Functions.logMessage = printLog;
+
+	RenderJob job;
+	int repeat = 1;
+	int pos = 0;
+	std::string golden, workDir;
+	bool record = false;
+	bool codecBench = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--raw") == 0)
+			job.format = RenderJob::eFORMAT_RAW;
+		else if (strcmp(arg, "--mono") == 0)
+			job.channels = 1;
+		else if (strcmp(arg, "--rate") == 0 && hasValue)
+			job.sampleRate = atoi(argv[++i]);
+		else if (strcmp(arg, "--start") == 0 && hasValue)
+			job.startTime = atof(argv[++i]);
+		else if (strcmp(arg, "--length") == 0 && hasValue)
+			job.playTime = atof(argv[++i]);
+		else if (strcmp(arg, "--volume") == 0 && hasValue)
+			job.volumeDb = atof(argv[++i]);
+		else if (strcmp(arg, "--repeat") == 0 && hasValue)
+			repeat = atoi(argv[++i]);
+		else if (strcmp(arg, "--verbose") == 0)
+			g_verbose = true;
+		else if (strcmp(arg, "--selfcheck") == 0 && hasValue)
+			golden = argv[++i];
+		else if (strcmp(arg, "--record") == 0)
+			record = true;
+		else if (strcmp(arg, "--workdir") == 0 && hasValue)
+			workDir = argv[++i];
+		else if (strcmp(arg, "--codec-bench") == 0)
+			codecBench = true;
+		else if (arg[0] != '-' && codecBench)
+			inputs.push_back(arg);
+		else if (arg[0] != '-' && pos < 2)
+			(pos++ == 0 ? job.input : job.output) = arg;
+		else
+		{
+			printUsage();
+			return 2;
+		}
+	}
+
+	if (codecBench && pos == 0 && !inputs.empty() && repeat >= 1)
+		return RunCodecBenchmark(inputs, repeat);
+
+	if (!golden.empty() && pos == 0 && repeat >= 1)
+	{
+		std::error_code error;
+		if (workDir.empty())
+			workDir = std::filesystem::temp_directory_path(error).string();
+		return RunSelfCheck(workDir.empty() ? "." : workDir, golden, record, repeat);
+	}
+
+	if (pos != 2 || repeat < 1)
+	{
+		printUsage();
+		return 2;
+	}
+
+	double renderSeconds = 0.0;
+	RenderResult result;
+	for (int i = 0; i < repeat; i++)
+	{
+		if (RenderOffline(job, result) != 0)
+			return 1;
+		renderSeconds += result.renderSeconds;
+	}
+
+	// Rendering is single threaded, so this is the speed per core
+	const double audioSeconds = result.audioSeconds(job.sampleRate);
+	const double average = renderSeconds / repeat;
+	printf(
+		"%s: %.2f s of audio in %.3f s, %.1fx real-time per core\n", job.output.c_str(), audioSeconds, average,
+		average > 0.0 ? audioSeconds / average : 0.0
+	);
+	return 0;
+}
@@ -0,0 +1,264 @@
+// src/RtCheck.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "RtCheck.h"
+
+#ifdef RPSB_RT_CHECK
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <execinfo.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <new>
+
+#include "ts3log.h"
+
+// Abort via assert on the first violation instead of only counting it
+// #define RT_CHECK_TRAP
+
+// Lock waits on audio threads shorter than this are counted, but not reported as violation
+#define LOCK_WAIT_THRESHOLD 0.0001 // seconds
+
+#define MAX_OFFENDERS 128
+#define MAX_FRAMES 24
+#define SKIP_FRAMES 2 // Frames of the checker itself
+
+
+namespace
+{
+struct offender_t
+{
+	uint64_t hash;
+	RtCheck::violation_e type;
+	const char* what;
+	uint64_t count;
+	void* frames[MAX_FRAMES];
+	int numFrames;
+};
+
+thread_local int t_audioDepth = 0;
+thread_local bool t_recording = false; // Prevents recursion when recording itself allocates
+
+std::atomic<uint64_t> g_counts[RtCheck::eVIOLATION_COUNT];
+std::atomic<uint64_t> g_lockWaits(0);
+std::atomic<uint64_t> g_overflows(0);
+
+// Fixed storage, so recording doesn't allocate
+std::mutex g_offendersMutex;
+offender_t g_offenders[MAX_OFFENDERS];
+int g_numOffenders = 0;
+
+const char* const g_violationNames[RtCheck::eVIOLATION_COUNT] = {"allocation", "free", "unsafe call", "lock wait"};
+
+
+int captureStack(void** frames, int maxFrames)
+{
+#ifdef _WIN32
+	return (int)CaptureStackBackTrace(SKIP_FRAMES, maxFrames, frames, nullptr);
+#else
+	void* all[MAX_FRAMES + SKIP_FRAMES];
+	int num = backtrace(all, MAX_FRAMES + SKIP_FRAMES);
+	num = std::max(num - SKIP_FRAMES, 0);
+	num = std::min(num, maxFrames);
+	std::copy(all + SKIP_FRAMES, all + SKIP_FRAMES + num, frames);
+	return num;
+#endif
+}
+
+
+void record(RtCheck::violation_e type, const char* what)
+{
+	g_counts[type]++;
+
+	void* frames[MAX_FRAMES];
+	int numFrames = captureStack(frames, MAX_FRAMES);
+
+	uint64_t hash = 14695981039346656037ULL ^ (uint64_t)type;
+	for (int i = 0; i < numFrames; i++)
+		hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ULL;
+
+	std::lock_guard<std::mutex> lock(g_offendersMutex);
+	for (int i = 0; i < g_numOffenders; i++)
+	{
+		if (g_offenders[i].hash == hash)
+		{
+			g_offenders[i].count++;
+			return;
+		}
+	}
+
+	if (g_numOffenders == MAX_OFFENDERS)
+	{
+		g_overflows++;
+		return;
+	}
+
+	offender_t& o = g_offenders[g_numOffenders++];
+	o.hash = hash;
+	o.type = type;
+	o.what = what;
+	o.count = 1;
+	o.numFrames = numFrames;
+	std::copy(frames, frames + numFrames, o.frames);
+}
+} // namespace
+
+
+RtCheck::AudioScope::AudioScope()
+{
+	t_audioDepth++;
+}
+
+
+RtCheck::AudioScope::~AudioScope()
+{
+	t_audioDepth--;
+}
+
+
+bool RtCheck::isAudioThread()
+{
+	return t_audioDepth > 0;
+}
+
+
+void RtCheck::violation(violation_e type, const char* what)
+{
+	if (t_audioDepth == 0 || t_recording)
+		return;
+
+	t_recording = true;
+	record(type, what);
+	t_recording = false;
+
+#ifdef RT_CHECK_TRAP
+	assert(!"Real-time violation on audio thread");
+#endif
+}
+
+
+void RtCheck::lockWaited(double waitSeconds)
+{
+	g_lockWaits++;
+	if (waitSeconds >= LOCK_WAIT_THRESHOLD)
+		violation(eLOCK_WAIT, "contended mutex");
+}
+
+
+void RtCheck::printSummary()
+{
+	std::lock_guard<std::mutex> lock(g_offendersMutex);
+
+	logInfo(
+		"Real-time check: %llu allocations, %llu frees, %llu unsafe calls, %llu long lock waits (%llu contended) "
+		"on audio threads",
+		(unsigned long long)g_counts[eALLOC], (unsigned long long)g_counts[eFREE],
+		(unsigned long long)g_counts[eUNSAFE_CALL], (unsigned long long)g_counts[eLOCK_WAIT],
+		(unsigned long long)g_lockWaits
+	);
+	if (g_overflows > 0)
+		logInfo("Real-time check: %llu violations without stack, table full", (unsigned long long)g_overflows);
+
+	std::sort(
+		g_offenders, g_offenders + g_numOffenders,
+		[](const offender_t& a, const offender_t& b) { return a.count > b.count; }
+	);
+
+	for (int i = 0; i < g_numOffenders; i++)
+	{
+		const offender_t& o = g_offenders[i];
+		logInfo(
+			"Real-time offender #%i: %s (%s), %llu times", i + 1, g_violationNames[o.type], o.what,
+			(unsigned long long)o.count
+		);
+#ifdef _WIN32
+		for (int f = 0; f < o.numFrames; f++)
+			logInfo("    %p", o.frames[f]);
+#else
+		char** symbols = backtrace_symbols(o.frames, o.numFrames);
+		for (int f = 0; f < o.numFrames; f++)
+			logInfo("    %s", symbols ? symbols[f] : "?");
+		free(symbols);
+#endif
+	}
+}
+
+
+// Replace the global allocation functions of the plugin to see allocations on audio threads.
+// Allocations inside other libraries (Qt, the C runtime) use their own allocators and have to
+// be marked with RT_UNSAFE_CALL at the call site.
+
+void* operator new(size_t size)
+{
+	RtCheck::violation(RtCheck::eALLOC, "operator new");
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+
+void* operator new[](size_t size)
+{
+	RtCheck::violation(RtCheck::eALLOC, "operator new[]");
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	RtCheck::violation(RtCheck::eALLOC, "operator new");
+	return malloc(size ? size : 1);
+}
+
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	RtCheck::violation(RtCheck::eALLOC, "operator new[]");
+	return malloc(size ? size : 1);
+}
+
+
+void operator delete(void* p) noexcept
+{
+	if (p)
+		RtCheck::violation(RtCheck::eFREE, "operator delete");
+	free(p);
+}
+
+
+void operator delete[](void* p) noexcept
+{
+	if (p)
+		RtCheck::violation(RtCheck::eFREE, "operator delete[]");
+	free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete[](p);
+}
+
+#endif
@@ -0,0 +1,100 @@
+// src/RtCheck.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <mutex>
+
+#include "LockTelemetry.h"
+
+// Real-time safety checks for the TS3 audio callbacks, enabled with the RPSB_RT_CHECK build option.
+// Threads are marked as audio threads while they run a callback. On those, heap allocations,
+// calls marked as unsafe (logging, Qt signals, file IO) and contended locks are counted together
+// with a sampled stack of the offending call. A summary is logged on shutdown.
+
+#ifdef RPSB_RT_CHECK
+
+#include "HighResClock.h"
+
+namespace RtCheck
+{
+enum violation_e
+{
+	eALLOC = 0,
+	eFREE,
+	eUNSAFE_CALL,
+	eLOCK_WAIT,
+	eVIOLATION_COUNT,
+};
+
+// Marks the current thread as audio thread while in scope
+class AudioScope
+{
+  public:
+	AudioScope();
+	~AudioScope();
+};
+
+bool isAudioThread();
+
+// Record a violation if called on an audio thread
+void violation(violation_e type, const char* what);
+
+// Record a lock acquisition that had to wait for waitSeconds
+void lockWaited(double waitSeconds);
+
+// Log all violations seen so far, sorted by number of occurrences
+void printSummary();
+} // namespace RtCheck
+
+
+// lock_guard that reports how long audio threads wait for the mutex
+template <class Mutex> class RtLockGuard
+{
+  public:
+	explicit RtLockGuard(Mutex& mutex, const char* file = __builtin_FILE(), int line = __builtin_LINE()) :
+		m_mutex(mutex)
+	{
+		if (!RtCheck::isAudioThread())
+		{
+			LockAt(m_mutex, file, line);
+			return;
+		}
+
+		auto start = HighResClock::now();
+		if (!LockAt(m_mutex, file, line))
+			return;
+		std::chrono::duration<double> waited = HighResClock::now() - start;
+		RtCheck::lockWaited(waited.count());
+	}
+
+	~RtLockGuard()
+	{
+		m_mutex.unlock();
+	}
+
+	RtLockGuard(const RtLockGuard&) = delete;
+	RtLockGuard& operator=(const RtLockGuard&) = delete;
+
+  private:
+	Mutex& m_mutex;
+};
+
+#define RT_AUDIO_SCOPE() RtCheck::AudioScope rtAudioScope_
+#define RT_UNSAFE_CALL(what) RtCheck::violation(RtCheck::eUNSAFE_CALL, what)
+#define RT_CHECK_SUMMARY() RtCheck::printSummary()
+
+#else
+
+template <class Mutex> using RtLockGuard = TrackedLock<Mutex>;
+
+#define RT_AUDIO_SCOPE()
+#define RT_UNSAFE_CALL(what)
+#define RT_CHECK_SUMMARY()
+
+#endif
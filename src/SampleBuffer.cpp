@@ -11,24 +11,90 @@
 #include "SampleBuffer.h"
 
 
-SampleBuffer::SampleBuffer(int channels, size_t maxSize /*= 0*/) :
+SampleBuffer::SampleBuffer(int channels, size_t maxSize /*= 0*/, const char* name /*= "SampleBuffer"*/) :
+	m_maxChannels(channels),
 	m_channels(channels),
 	m_maxSize(maxSize),
+	m_readPos(0),
+	m_writePos(0),
+	m_readTotal(0),
+	m_mutex(name),
 	m_cbProd(nullptr),
 	m_cbCons(nullptr)
 {
+	// Bounded buffers never need more than this, so they never reallocate
+	if (m_maxSize > 0)
+		m_buf.resize(m_maxSize * m_channels);
 }
 
 
 void SampleBuffer::produce(const short* samples, int count)
 {
 	assert(!m_mutex.try_lock() && "Mutex not locked");
-	if (m_maxSize == 0 || avail() < (int)m_maxSize)
+	short* dest = nullptr;
+	int fit = SampleBuffer::reserve(&dest, count);
+	if (fit > 0)
+		memcpy(dest, samples, fit * m_channels * sizeof(short));
+	SampleBuffer::commit(fit);
+}
+
+
+void SampleBuffer::setChannels(int channels)
+{
+	assert(!m_mutex.try_lock() && "Mutex not locked");
+	assert(channels > 0 && channels <= m_maxChannels && "Too many channels");
+	m_readTotal += avail();
+	m_channels = channels;
+	m_readPos = 0;
+	m_writePos = 0;
+}
+
+
+int SampleBuffer::reserve(short** samples, int maxCount)
+{
+	assert(!m_mutex.try_lock() && "Mutex not locked");
+	const size_t count = (size_t)std::max(std::min(maxCount, freeSpace()), 0);
+	const size_t shorts = count * m_channels;
+
+	if (m_readPos == m_writePos)
 	{
-		m_buf.insert(m_buf.end(), samples, samples + (count * m_channels));
-		if (m_cbProd)
-			m_cbProd->onProduceSamples(samples, count, this);
+		// Empty, start over at the front
+		m_readPos = 0;
+		m_writePos = 0;
 	}
+	else if (m_writePos + shorts > m_buf.size() && m_readPos > 0)
+	{
+		// Not enough room at the end, move the available samples to the front
+		memmove(m_buf.data(), m_buf.data() + m_readPos, (m_writePos - m_readPos) * sizeof(short));
+		m_writePos -= m_readPos;
+		m_readPos = 0;
+	}
+
+	if (m_writePos + shorts > m_buf.size()) // only happens for unbounded buffers
+		m_buf.resize(std::max(m_writePos + shorts, m_buf.size() * 2));
+
+	*samples = m_buf.data() + m_writePos;
+	return (int)count;
+}
+
+
+void SampleBuffer::commit(int count)
+{
+	assert(!m_mutex.try_lock() && "Mutex not locked");
+	const short* samples = m_buf.data() + m_writePos;
+	m_writePos += count * m_channels;
+	assert(m_writePos <= m_buf.size() && "Committed more than reserved");
+	if (m_cbProd && count > 0)
+		m_cbProd->onProduceSamples(samples, count, this);
+}
+
+
+int SampleBuffer::discardNewest(int count)
+{
+	assert(!m_mutex.try_lock() && "Mutex not locked");
+	count = std::max(std::min(count, avail()), 0);
+	m_writePos -= (size_t)count * m_channels;
+	return count;
 }
 
 
@@ -38,9 +104,13 @@ int SampleBuffer::consume(short* samples, int maxCount, bool eraseConsumed)
 	int count = std::min(avail(), maxCount);
 	size_t shorts = count * m_channels;
 	if (samples)
-		memcpy(samples, m_buf.data(), shorts * 2);
+		memcpy(samples, m_buf.data() + m_readPos, shorts * 2);
+	// Never move the write position here, the producer might be writing to a reserved region
 	if (eraseConsumed)
-		m_buf.erase(m_buf.begin(), m_buf.begin() + count * m_channels);
+	{
+		m_readPos += shorts;
+		m_readTotal += count;
+	}
 	if (m_cbCons)
 		m_cbCons->onConsumeSamples(samples, count, this);
 	return count;
@@ -12,15 +12,22 @@
 #include <vector>
 #include <mutex>
 #include <cassert>
+#include <climits>
+#include <stdint.h>
 
 
 #include "SampleProducer.h"
+#include "LockTelemetry.h"
+
+// Size of the sample buffers of the sampler in frames.
+// Must exceed the producer's highest watermark by more than one decoder read.
+#define MAX_SAMPLEBUFFER_SIZE (48000 * 3)
 
 class SampleBuffer : public SampleProducer
 {
   public:
-	typedef std::mutex Mutex;
-	typedef std::lock_guard<Mutex> Lock;
+	typedef InstrumentedMutex Mutex;
+	typedef TrackedLock<Mutex> Lock;
 
 	class ProduceCallback
 	{
@@ -35,7 +42,9 @@ class SampleBuffer : public SampleProducer
 	};
 
   public:
-	SampleBuffer(int channels, size_t maxSize = 0);
+	// channels: Maximum number of channels, see setChannels()
+	// name: Shown in the lock telemetry
+	SampleBuffer(int channels, size_t maxSize = 0, const char* name = "SampleBuffer");
 
 	// Set the callback that is called when samples are placed into the buffer (produced)
 	inline void setOnProduce(ProduceCallback* cb)
@@ -70,16 +79,35 @@ class SampleBuffer : public SampleProducer
 	inline int avail() const
 	{
 		assert(!m_mutex.try_lock() && "Mutex not locked");
-		return m_buf.size() / m_channels;
+		return (int)((m_writePos - m_readPos) / m_channels);
 	}
 
-	// Return the number of channels this buffer was initialized with
+	// Get the number of samples that can be produced until the buffer is full
+	inline int freeSpace() const
+	{
+		assert(!m_mutex.try_lock() && "Mutex not locked");
+		return m_maxSize == 0 ? INT_MAX : (int)m_maxSize - avail();
+	}
+
+	// Return the number of channels of the samples in the buffer
 	inline int channels() const
 	{
 		assert(!m_mutex.try_lock() && "Mutex not locked");
 		return m_channels;
 	}
 
+	// Number of samples consumed since the buffer was created, including dropped ones. Together with avail() it
+	// places the buffer on a timeline of everything produced into it, which the sampler uses as its clock.
+	inline int64_t readPosition() const
+	{
+		assert(!m_mutex.try_lock() && "Mutex not locked");
+		return m_readTotal;
+	}
+
+	// Take samples with another number of channels, at most as many as the buffer was created with.
+	// Drops all available samples. Never reallocates, a region reserved before stays valid.
+	void setChannels(int channels);
+
 	// Return max size as set
 	inline size_t maxSize() const
 	{
@@ -89,10 +117,24 @@ class SampleBuffer : public SampleProducer
 
 	// Place some samples into the buffer
 	// samples: The sample buffer
-	// count: Number of samples in buffer
+	// count: Number of samples in buffer, samples that don't fit into the buffer are dropped.
+	// Producers that feed several buffers check freeSpace() first, so they all stay in step.
 	// One sample is (2 * channels) bytes in size
 	virtual void produce(const short* samples, int count) override;
 
+	// Get writable memory at the end of the buffer for up to maxCount samples.
+	// Only the mutex holder may call this, but the returned region may be written to after
+	// unlocking it again: consumers never touch memory behind the available samples and
+	// only reserve() itself moves data around.
+	virtual int reserve(short** samples, int maxCount) override;
+
+	// Append count samples written to the last reserved region
+	virtual void commit(int count) override;
+
+	// Drop up to count of the samples produced last, returns the number dropped.
+	// Must not be called while a region is reserved.
+	int discardNewest(int count);
+
 	// Consume some samples from the buffer
 	// samples: The sample buffer
 	// count: Size of buffer measured in Samples
@@ -112,24 +154,28 @@ class SampleBuffer : public SampleProducer
 	inline short* getBufferData()
 	{
 		assert(!m_mutex.try_lock() && "Mutex not locked");
-		return m_buf.data();
+		return m_buf.data() + m_readPos;
 	}
 
-	inline const std::mutex& getMutex() const
+	inline const Mutex& getMutex() const
 	{
 		return m_mutex;
 	}
 
-	inline std::mutex& getMutex()
+	inline Mutex& getMutex()
 	{
 		return m_mutex;
 	}
 
   private:
-	const int m_channels;
+	const int m_maxChannels;
+	int m_channels;
 	const size_t m_maxSize;
-	std::vector<short> m_buf;
-	mutable std::mutex m_mutex;
+	std::vector<short> m_buf; // Storage, available samples are in [m_readPos, m_writePos)
+	size_t m_readPos;
+	size_t m_writePos;
+	int64_t m_readTotal;
+	mutable Mutex m_mutex;
 	ProduceCallback* m_cbProd;
 	ConsumeCallback* m_cbCons;
 };
@@ -11,5 +11,15 @@
 class SampleProducer
 {
   public:
+	// Push samples, they are copied into the consumer
 	virtual void produce(const short* samples, int count) = 0;
+
+	// Pull-style alternative to produce(): Borrow writable memory of the consumer for up to maxCount
+	// samples, write into it directly and hand the samples over with commit().
+	// Returns the number of samples that fit into *samples, which is 0 if the consumer is full.
+	// Every reserve() has to be followed by exactly one commit() before producing anything else.
+	virtual int reserve(short** samples, int maxCount) = 0;
+
+	// Make the first count samples of the last reserved region available to the consumer
+	virtual void commit(int count) = 0;
 };
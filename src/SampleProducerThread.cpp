@@ -10,17 +10,99 @@
 #include <thread>
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <math.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "SampleBuffer.h"
 #include "SampleSource.h"
 #include "SampleProducerThread.h"
+#include "HighResClock.h"
+#include "ts3log.h"
+
+// Sizes are in samples, sources always deliver at the output rate
+#define PRODUCER_SAMPLE_RATE 48000
+
+// Time the thread sleeps between two fills, unless a new source is set
+#define PRODUCER_INTERVAL_MS 100
+
+// Default bounds of the low watermark
+#define MIN_WATERMARK (PRODUCER_SAMPLE_RATE / 4)
+#define MAX_WATERMARK (PRODUCER_SAMPLE_RATE * 2)
+
+// Low watermark of sources without a hint, the fixed size used before sizing was measured
+#define INITIAL_WATERMARK (PRODUCER_SAMPLE_RATE / 2)
+
+// Each refill decodes at least this much, so not every wakeup has to touch the buffers
+#define REFILL_SAMPLES (PRODUCER_SAMPLE_RATE * 2 * PRODUCER_INTERVAL_MS / 1000)
+
+// The low watermark covers this many times the wakeup interval plus the longest stall
+#define SIZING_SAFETY 2.0
+
+// A long read is forgotten by half after this much decoded audio
+#define STALL_HALF_LIFE_SAMPLES (PRODUCER_SAMPLE_RATE * 10)
+
+// Sources that ended before decoding this much don't report their sizing, the numbers are too noisy
+#define SIZING_MIN_SAMPLES PRODUCER_SAMPLE_RATE
+
+// Silence padded in front of a scheduled source is produced in pieces of this many samples
+#define SILENCE_CHUNK 1024
+
+
+// Run the calling thread above normal priority or back at normal
+static void setThreadBoosted(bool boosted)
+{
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), boosted ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_NORMAL);
+#elif defined(__linux__)
+	// Fails without CAP_SYS_NICE or a matching RLIMIT_NICE, the larger read ahead has to do then
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), boosted ? -5 : 0);
+#else
+	(void)boosted; // Only privileged processes may raise priorities on macOS
+#endif
+}
 
 
 SampleProducerThread::SampleProducerThread() :
 	m_source(nullptr),
+	m_fillSource(nullptr),
+	m_reservedBuffer(nullptr),
+	m_reservedSamples(nullptr),
+	m_overflowChannels(1),
 	m_running(false),
-	m_stop(false)
+	m_stop(false),
+	m_mutex("SampleProducerThread"),
+	m_sourceLowWatermark(0),
+	m_sourceGeneration(0),
+	m_doneGeneration(0),
+	m_seekPending(false),
+	m_seekApplied(0),
+	m_wake(false),
+	m_boost(false),
+	m_minWatermark(MIN_WATERMARK),
+	m_maxWatermark(MAX_WATERMARK),
+	m_cbSizing(nullptr)
 {
+	m_sizing.source = nullptr;
+	m_sizing.generation = 0;
+	m_sizing.boosted = false;
+	m_sizing.reported = true;
+	m_schedule.source = nullptr;
+	m_schedule.clock = nullptr;
+	m_schedule.due = 0;
+	m_schedule.lowWatermark = 0;
+	m_seek.source = nullptr;
+	m_seek.seconds = 0.0;
+	m_seek.id = 0;
 }
 
 
@@ -38,7 +120,12 @@ void SampleProducerThread::start()
 
 void SampleProducerThread::stop(bool wait)
 {
-	m_stop = true;
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		m_stop = true;
+	}
+	m_wakeCond.notify_one();
+	m_releasedCond.notify_all();
 	if (wait && m_thread.joinable())
 		m_thread.join();
 }
@@ -50,27 +137,329 @@ bool SampleProducerThread::isRunning()
 }
 
 
-void SampleProducerThread::setSource(SampleSource* source)
+void SampleProducerThread::setSource(
+	SampleSource* source, const std::string& key /*= std::string()*/, int lowWatermark /*= 0*/
+)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		m_source = source;
+		m_sourceKey = key;
+		m_sourceLowWatermark = lowWatermark;
+		m_sourceGeneration++;
+		m_schedule.source = nullptr;
+		m_wake = true;
+	}
+	// Starting a sound shouldn't wait for the end of the interval
+	m_wakeCond.notify_one();
+	m_releasedCond.notify_all();
+}
+
+
+void SampleProducerThread::scheduleSource(
+	SampleSource* source, SampleBuffer* clock, int64_t due, const std::string& key /*= std::string()*/,
+	int lowWatermark /*= 0*/
+)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		m_schedule.source = source;
+		m_schedule.clock = clock;
+		m_schedule.due = due;
+		m_schedule.key = key;
+		m_schedule.lowWatermark = lowWatermark;
+		m_wake = true;
+	}
+	// The buffers may already hold samples beyond due, which have to be dropped before they are consumed
+	m_wakeCond.notify_one();
+}
+
+
+unsigned SampleProducerThread::seekSource(SampleSource* source, double seconds)
+{
+	unsigned id;
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		m_seek.source = source;
+		m_seek.seconds = seconds;
+		id = ++m_seek.id;
+		m_seekPending = true;
+		m_wake = true;
+	}
+	m_wakeCond.notify_one();
+	return id;
+}
+
+
+void SampleProducerThread::setWatermarkBounds(int minSamples, int maxSamples)
+{
+	Lock lock(m_mutex);
+	m_minWatermark = std::max(minSamples, 1);
+	m_maxWatermark = std::max(maxSamples, m_minWatermark);
+}
+
+
+bool SampleProducerThread::isReading(const SampleSource* source)
+{
+	std::lock_guard<std::mutex> lock(m_sourceMutex);
+	return reads(source);
+}
+
+
+void SampleProducerThread::waitForReleasedSource(const SampleSource* source)
+{
+	std::unique_lock<std::mutex> lock(m_sourceMutex);
+	m_releasedCond.wait(lock, [this, source] { return !reads(source); });
+}
+
+
+// Called with m_sourceMutex held. A source replaced by scheduleSource() is read until the switch, a fill or seek
+// that picked up a source goes on with it until it returns.
+bool SampleProducerThread::reads(const SampleSource* source) const
 {
-	m_mutex.lock();
-	m_source = source;
-	m_mutex.unlock();
+	return source && (m_fillSource == source || (m_source == source && !m_stop));
 }
 
-#define MIN_BUFFER_SAMPLES (48000 / 2)
 void SampleProducerThread::run()
 {
 	while (!m_stop)
 	{
 		m_mutex.lock();
-		if (m_source)
+		applySchedule();
+		applySeek();
+		beginSizing();
+		applyBoost();
+		if (m_fillSource)
 			singleBufferFill();
+		releaseFillSource();
 		m_mutex.unlock();
 
-		// We now have half a second of samples available and have done
+		// The buffers are above their low watermark now and we have done
 		// so much work that we deserve a little rest
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::unique_lock<std::mutex> lock(m_sourceMutex);
+		m_wakeCond.wait_for(lock, std::chrono::milliseconds(PRODUCER_INTERVAL_MS), [this] { return m_wake || m_stop; });
+		m_wake = false;
+	}
+	finishSizing();
+	if (m_sizing.boosted)
+		setThreadBoosted(false);
+}
+
+
+// Pick up the current source and, if it was set anew, start sizing it
+void SampleProducerThread::beginSizing()
+{
+	std::lock_guard<std::mutex> lock(m_sourceMutex);
+	m_fillSource = m_source;
+	if (m_sizing.generation == m_sourceGeneration)
+		return;
+
+	finishSizing();
+	if (m_sizing.boosted)
+		setThreadBoosted(false);
+	m_boost = false; // Meant for the previous source
+	m_overflow.clear();
+	m_sizing.source = m_fillSource;
+	m_sizing.key = m_sourceKey;
+	m_sizing.generation = m_sourceGeneration;
+	const int hint = m_sourceLowWatermark > 0 ? m_sourceLowWatermark : INITIAL_WATERMARK;
+	m_sizing.low = std::min(std::max(hint, m_minWatermark), m_maxWatermark);
+	m_sizing.high = std::min(m_sizing.low + REFILL_SAMPLES, std::max(m_sizing.low, m_maxWatermark));
+	m_sizing.lowFloor = 0;
+	m_sizing.boosted = false;
+	m_sizing.samples = 0;
+	m_sizing.readSeconds = 0.0;
+	m_sizing.stallSeconds = 0.0;
+	m_sizing.reported = !m_fillSource;
+}
+
+
+// Let waitForReleasedSource() return for the source picked up by beginSizing() or applySeek()
+void SampleProducerThread::releaseFillSource()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		if (!m_fillSource)
+			return;
+		m_fillSource = nullptr;
+	}
+	m_releasedCond.notify_all();
+}
+
+
+// Report the sizing of the current source, once
+void SampleProducerThread::finishSizing()
+{
+	if (m_sizing.reported)
+		return;
+	m_sizing.reported = true;
+	if (m_cbSizing && !m_sizing.key.empty() && m_sizing.samples >= SIZING_MIN_SAMPLES)
+		m_cbSizing->onSourceSized(m_sizing.key, m_sizing.low);
+}
+
+
+void SampleProducerThread::measureRead(int samples, double seconds)
+{
+	sizing_t& s = m_sizing;
+	s.samples += samples;
+	s.readSeconds += seconds;
+	s.stallSeconds = std::max(seconds, s.stallSeconds * pow(0.5, (double)samples / STALL_HALF_LIFE_SAMPLES));
+
+	// Between two fills the buffer has to last for the interval plus the longest stall. Refilling
+	// it happens at speed times real-time while it keeps being drained at real-time.
+	const double speed = s.readSeconds > 0.0 ? (double)s.samples / PRODUCER_SAMPLE_RATE / s.readSeconds : 1000.0;
+	double low = (double)m_maxWatermark;
+	if (speed > 1.0)
+	{
+		const double cover = (PRODUCER_INTERVAL_MS / 1000.0 + s.stallSeconds) * SIZING_SAFETY;
+		low = cover * PRODUCER_SAMPLE_RATE * speed / (speed - 1.0);
+	}
+	low = std::max(low, (double)s.lowFloor);
+	s.low = (int)std::min(std::max(low, (double)m_minWatermark), (double)m_maxWatermark);
+	s.high = std::min(s.low + REFILL_SAMPLES, std::max(s.low, m_maxWatermark));
+}
+
+
+// Switch to the scheduled source once the buffers hold everything of the current one up to the due sample.
+// What the last read produced beyond it is dropped again, a current source that ended early is padded with silence.
+void SampleProducerThread::applySchedule()
+{
+	std::lock_guard<std::mutex> lock(m_sourceMutex);
+	if (!m_schedule.source)
+		return;
+
+	int64_t ahead;
+	{
+		SampleBuffer::Lock sbl(m_schedule.clock->getMutex());
+		ahead = m_schedule.clock->readPosition() + m_schedule.clock->avail() - m_schedule.due;
+	}
+	if (ahead < 0)
+	{
+		if (m_source && m_doneGeneration != m_sourceGeneration)
+			return; // The current source goes on until it reaches the due sample
+		ahead += padSilence((int)std::min(-ahead, (int64_t)INT_MAX));
+		if (ahead < 0)
+			return; // The buffers are full, the rest is padded on a later wakeup
+	}
+
+	// Every enabled buffer got the same samples since the schedule, so they all end at the same overshoot.
+	// Samples that didn't fit yet lie beyond it.
+	m_overflow.clear();
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled)
+		{
+			SampleBuffer::Lock sbl(buffer.buffer->getMutex());
+			buffer.buffer->discardNewest((int)std::min(ahead, (int64_t)INT_MAX));
+		}
+	}
+
+	m_source = m_schedule.source;
+	m_sourceKey = m_schedule.key;
+	m_sourceLowWatermark = m_schedule.lowWatermark;
+	m_sourceGeneration++;
+	m_schedule.source = nullptr;
+	m_releasedCond.notify_all();
+}
+
+
+// Seek the current source and drop everything the buffers hold of it. Runs between two fills, so nothing read
+// before the seek can be produced after it. The read position of the buffers is kept, only unplayed samples go.
+void SampleProducerThread::applySeek()
+{
+	seek_t seek;
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		if (!m_seek.source)
+			return;
+		seek = m_seek;
+		m_seek.source = nullptr;
+		m_seekPending = false;
+		if (seek.source == m_source)
+			m_fillSource = seek.source; // Not closed before released, even if replaced meanwhile
 	}
+
+	if (m_fillSource && m_fillSource->seek(seek.seconds) != 0)
+		logWarning("Cannot seek to %.3f s", seek.seconds);
+	releaseFillSource();
+
+	{
+		std::lock_guard<std::mutex> lock(m_sourceMutex);
+		if (seek.source == m_source)
+		{
+			for (const buffer_t& buffer : m_buffers)
+			{
+				SampleBuffer::Lock sbl(buffer.buffer->getMutex());
+				buffer.buffer->discardNewest(buffer.buffer->avail());
+			}
+			m_overflow.clear();
+			m_doneGeneration = m_sourceGeneration - 1; // Has samples again, unless the seek went to its end
+		}
+	}
+	m_seekApplied.store(seek.id, std::memory_order_release);
+}
+
+
+// Whether the running fill has to stop reading the current source, because it reached the due sample of the
+// scheduled one
+bool SampleProducerThread::scheduleDue()
+{
+	std::lock_guard<std::mutex> lock(m_sourceMutex);
+	if (!m_schedule.source)
+		return false;
+
+	SampleBuffer::Lock sbl(m_schedule.clock->getMutex());
+	if (m_schedule.clock->readPosition() + m_schedule.clock->avail() < m_schedule.due)
+		return false;
+	m_wake = true; // Switch right after this fill
+	return true;
+}
+
+
+// Produce up to count samples of silence into all enabled buffers, as many as all of them have room for.
+// Called with m_sourceMutex held, returns the number produced.
+int SampleProducerThread::padSilence(int count)
+{
+	static const short silence[SILENCE_CHUNK * 2] = {};
+
+	count = roomForAll(count);
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled)
+		{
+			SampleBuffer::Lock sbl(buffer.buffer->getMutex());
+			for (int padded = 0; padded < count; padded += SILENCE_CHUNK)
+				buffer.buffer->produce(silence, std::min(count - padded, SILENCE_CHUNK));
+		}
+	}
+	return count;
+}
+
+
+// The fill source returned its last samples
+void SampleProducerThread::markSourceDone()
+{
+	std::lock_guard<std::mutex> lock(m_sourceMutex);
+	m_doneGeneration = m_sizing.generation;
+	if (m_schedule.source)
+		m_wake = true; // Pad up to the scheduled source right away
+}
+
+
+// The audio threads ran out of samples of the current source, give it more room
+void SampleProducerThread::applyBoost()
+{
+	if (!m_boost.exchange(false, std::memory_order_relaxed) || !m_sizing.source)
+		return;
+
+	if (!m_sizing.boosted)
+	{
+		setThreadBoosted(true);
+		m_sizing.boosted = true;
+	}
+	m_sizing.lowFloor = std::min(m_sizing.low * 2, m_maxWatermark);
+	m_sizing.low = std::max(m_sizing.low, m_sizing.lowFloor);
+	m_sizing.high = std::min(m_sizing.low + REFILL_SAMPLES, std::max(m_sizing.low, m_maxWatermark));
 }
 
 
@@ -113,16 +502,131 @@ void SampleProducerThread::setBufferEnabled(SampleBuffer* buffer, bool enabled)
 }
 
 
+// Every enabled buffer gets the same samples, so capture and playback never drift apart. What doesn't fit into
+// all of them is kept and produced first on the next call.
 void SampleProducerThread::produce(const short* samples, int count)
 {
+	if (m_overflow.empty())
+	{
+		const int produced = produceToAll(samples, count);
+		if (produced >= count)
+			return;
+		m_overflowChannels = bufferChannels();
+		samples += (size_t)produced * m_overflowChannels;
+		count -= produced;
+	}
+	m_overflow.insert(m_overflow.end(), samples, samples + (size_t)count * m_overflowChannels);
+	flushOverflow();
+}
+
+
+// Produce the kept samples as far as all enabled buffers have room, returns whether none are left
+bool SampleProducerThread::flushOverflow()
+{
+	if (m_overflow.empty())
+		return true;
+	const int produced = produceToAll(m_overflow.data(), (int)(m_overflow.size() / m_overflowChannels));
+	m_overflow.erase(m_overflow.begin(), m_overflow.begin() + (size_t)produced * m_overflowChannels);
+	return m_overflow.empty();
+}
+
+
+// Samples are only accepted while the source of the running fill is still the current one.
+// Checking that under the buffer lock ensures nothing of a stopped source ends up behind a cleared buffer.
+// Returns the number produced into every enabled buffer, all of them if they belong to a replaced source.
+int SampleProducerThread::produceToAll(const short* samples, int count)
+{
+	const int fit = roomForAll(count);
 	for (const buffer_t& buffer : m_buffers)
 	{
 		if (buffer.enabled)
 		{
 			SampleBuffer::Lock lock(buffer.buffer->getMutex());
-			buffer.buffer->produce(samples, count);
+			if (m_source != m_fillSource)
+				return count;
+			buffer.buffer->produce(samples, fit);
 		}
 	}
+	return fit;
+}
+
+
+// The number of samples up to count that every enabled buffer has room for
+int SampleProducerThread::roomForAll(int count)
+{
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled)
+		{
+			SampleBuffer::Lock lock(buffer.buffer->getMutex());
+			count = std::min(count, buffer.buffer->freeSpace());
+		}
+	}
+	return std::max(count, 0);
+}
+
+
+// Channels of the enabled buffers, they are all set up for the same source
+int SampleProducerThread::bufferChannels()
+{
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled)
+		{
+			SampleBuffer::Lock lock(buffer.buffer->getMutex());
+			return buffer.buffer->channels();
+		}
+	}
+	return 1;
+}
+
+
+// Decoders write straight into the first enabled buffer, the others get a copy on commit
+int SampleProducerThread::reserve(short** samples, int maxCount)
+{
+	// Samples kept from before go first, while some are left there is no room for new ones
+	flushOverflow();
+	m_reservedBuffer = nullptr;
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled)
+		{
+			SampleBuffer::Lock lock(buffer.buffer->getMutex());
+			maxCount = std::min(maxCount, buffer.buffer->freeSpace());
+			if (!m_reservedBuffer)
+				m_reservedBuffer = buffer.buffer;
+		}
+	}
+
+	if (!m_reservedBuffer)
+		return 0;
+
+	SampleBuffer::Lock lock(m_reservedBuffer->getMutex());
+	int count = m_reservedBuffer->reserve(samples, std::max(maxCount, 0));
+	m_reservedSamples = *samples;
+	return count;
+}
+
+
+void SampleProducerThread::commit(int count)
+{
+	if (!m_reservedBuffer)
+		return;
+
+	// The reserved region stays untouched until the next reserve, so it can be copied without holding its lock
+	for (const buffer_t& buffer : m_buffers)
+	{
+		if (buffer.enabled && buffer.buffer != m_reservedBuffer)
+		{
+			SampleBuffer::Lock lock(buffer.buffer->getMutex());
+			if (m_source == m_fillSource)
+				buffer.buffer->produce(m_reservedSamples, count);
+		}
+	}
+
+	SampleBuffer::Lock lock(m_reservedBuffer->getMutex());
+	m_reservedBuffer->commit(m_source == m_fillSource ? count : 0);
+	m_reservedBuffer = nullptr;
 }
 
 
@@ -132,18 +636,39 @@ bool SampleProducerThread::singleBufferFill()
 	{
 		if (buffer.enabled)
 		{
-			std::unique_lock<SampleBuffer::Mutex> sbl(buffer.buffer->getMutex());
-			while (buffer.buffer->avail() < MIN_BUFFER_SAMPLES)
+			// Locked by hand rather than with std::unique_lock, so the lock telemetry sees this site
+			SampleBuffer::Mutex& mutex = buffer.buffer->getMutex();
+			mutex.lock();
+			// A new source is read at once, a scheduled one has to be ahead of its due sample as far as possible
+			if (buffer.buffer->avail() < m_sizing.low || m_sizing.samples == 0)
 			{
-				assert(buffer.buffer->maxSize() > MIN_BUFFER_SAMPLES && "Buffer too small");
-				sbl.unlock();
-				int samples = m_source->readSamples(this);
-				if (samples < 0) // error
-					return false;
-				if (samples == 0) // file is done
-					return true;
-				sbl.lock();
+				while (buffer.buffer->avail() < m_sizing.high)
+				{
+					assert(buffer.buffer->maxSize() > (size_t)m_sizing.high && "Buffer too small");
+					mutex.unlock();
+					if (m_source != m_fillSource) // Stopped or replaced meanwhile
+						return true;
+					if (scheduleDue() || m_seekPending)
+						return true;
+					if (!flushOverflow()) // Another enabled buffer is full, go on with the next fill
+						return true;
+					auto start = HighResClock::now();
+					int samples = m_fillSource->readSamples(this);
+					std::chrono::duration<double> took = HighResClock::now() - start;
+					if (samples < 0) // error
+						return false;
+					if (samples == 0) // file is done
+					{
+						markSourceDone();
+						finishSizing();
+						return true;
+					}
+					measureRead(samples, took.count());
+					applyBoost();
+					mutex.lock();
+				}
 			}
+			mutex.unlock();
 		}
 	}
 	return true;
@@ -9,10 +9,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "SampleProducer.h"
+#include "LockTelemetry.h"
 
 class SampleBuffer;
 class SampleSource;
@@ -26,7 +31,49 @@ class SampleProducerThread : public SampleProducer
 		bool enabled;
 	};
 
+	// Read ahead of the current source. A refill starts when a buffer holds less than low samples
+	// and tops it up to high. Both follow the measured decode speed and the longest read stall.
+	struct sizing_t
+	{
+		SampleSource* source;
+		std::string key;
+		unsigned generation; // Of the setSource() call, sources are recycled so the pointer is not enough
+		int low;
+		int high;
+		int lowFloor; // Raised by boost(), measuring doesn't lower the low watermark below it
+		bool boosted; // Thread priority raised for this source
+		int64_t samples; // Decoded so far
+		double readSeconds; // Spent in readSamples() so far
+		double stallSeconds; // Longest single read, decaying with the decoded audio
+		bool reported;
+	};
+
+	// Source waiting to replace the current one, see scheduleSource()
+	struct schedule_t
+	{
+		SampleSource* source; // Null if nothing is scheduled
+		SampleBuffer* clock;
+		int64_t due; // Read position of clock
+		std::string key;
+		int lowWatermark;
+	};
+
+	// Seek of the current source waiting for the thread, see seekSource()
+	struct seek_t
+	{
+		SampleSource* source; // Null if no seek is waiting
+		double seconds;
+		unsigned id;
+	};
+
   public:
+	class SizingCallback
+	{
+	  public:
+		// Called on the producer thread once a source is done or replaced, with the low watermark it needed
+		virtual void onSourceSized(const std::string& key, int lowWatermark) = 0;
+	};
+
 	SampleProducerThread();
 	void addBuffer(SampleBuffer* buffer, bool enableBuffer = true);
 	void remBuffer(SampleBuffer* buffer);
@@ -34,20 +81,111 @@ class SampleProducerThread : public SampleProducer
 	void start();
 	void stop(bool wait = true);
 	bool isRunning();
-	void setSource(SampleSource* source);
+
+	// Swap the source without waiting for the thread, samples of the previous source are dropped from now on
+	// key: Identifies the source towards the sizing callback, empty to not report it
+	// lowWatermark: Low watermark learned on an earlier play, 0 if unknown. Clamped to the bounds.
+	void setSource(SampleSource* source, const std::string& key = std::string(), int lowWatermark = 0);
+
+	// Replace the current source by source at exactly the sample the read position of clock reaches due.
+	// The current source keeps being read until then and is padded with silence if it ends before, samples of
+	// it produced beyond due are dropped. setSource() and another schedule cancel it.
+	// clock: Buffer the due position refers to, has to stay enabled until the switch
+	void scheduleSource(
+		SampleSource* source, SampleBuffer* clock, int64_t due, const std::string& key = std::string(),
+		int lowWatermark = 0
+	);
+
+	// Seek source on the thread, if it is still the current one, then drop what the buffers hold of it and refill
+	// them from the new position. Does not wait, a running fill stops after its current read. Returns the id of the
+	// request, see seeksApplied().
+	unsigned seekSource(SampleSource* source, double seconds);
+
+	// Id of the last seek request the thread is done with. Once it is reached, the buffers hold no samples from
+	// before the seek anymore. Safe to call on audio threads.
+	inline unsigned seeksApplied() const
+	{
+		return m_seekApplied.load(std::memory_order_acquire);
+	}
+
+	// Limits of the low watermark in samples. The buffers need room for at least one read above maxSamples.
+	void setWatermarkBounds(int minSamples, int maxSamples);
+
+	// Raise the thread priority and double the low watermark for the rest of the current source.
+	// Only sets a flag, safe to call on audio threads.
+	inline void boost()
+	{
+		m_boost.store(true, std::memory_order_relaxed);
+	}
+
+	// Set the callback that receives the sizing results, must be set before start()
+	inline void setSizingCallback(SizingCallback* cb)
+	{
+		m_cbSizing = cb;
+	}
+
+	// Whether the thread may still read from source, which was replaced by setSource() or scheduleSource()
+	bool isReading(const SampleSource* source);
+
+	// Block until the thread is done with source, which was replaced by setSource() or scheduleSource()
+	void waitForReleasedSource(const SampleSource* source);
 
   private:
 	void run();
 	void threadFunc();
 	bool singleBufferFill();
+	void beginSizing();
+	void finishSizing();
+	void measureRead(int samples, double seconds);
+	void applyBoost();
+	void applySchedule();
+	void applySeek();
+	bool scheduleDue();
+	bool reads(const SampleSource* source) const;
+	void releaseFillSource();
+	int padSilence(int count);
+	bool flushOverflow();
+	int produceToAll(const short* samples, int count);
+	int roomForAll(int count);
+	int bufferChannels();
+	void markSourceDone();
 	void produce(const short* samples, int count) override;
+	int reserve(short** samples, int maxCount) override;
+	void commit(int count) override;
 
-	typedef std::lock_guard<std::mutex> Lock;
+	typedef TrackedLock<InstrumentedMutex> Lock;
 
 	std::thread m_thread;
-	SampleSource* volatile m_source;
+	std::atomic<SampleSource*> m_source;
+	SampleSource* m_fillSource; // Source used by the running fill or seek, only set by the thread with m_sourceMutex
 	std::vector<buffer_t> m_buffers;
+	SampleBuffer* m_reservedBuffer;
+	short* m_reservedSamples;
+	std::vector<short> m_overflow; // Samples of the fill source that not every enabled buffer had room for yet
+	int m_overflowChannels;
 	bool m_running;
 	volatile bool m_stop;
-	std::mutex m_mutex;
+	InstrumentedMutex m_mutex;
+
+	// Source and sizing hints of the last setSource(), never held while reading a source.
+	// Taken before the lock of a buffer if both are needed.
+	std::mutex m_sourceMutex;
+	std::string m_sourceKey;
+	int m_sourceLowWatermark;
+	unsigned m_sourceGeneration;
+	unsigned m_doneGeneration; // Of the last source that was read to its end
+	schedule_t m_schedule;
+	std::condition_variable m_releasedCond; // Signaled when a schedule is applied or dropped, or a fill ends
+	seek_t m_seek;
+	std::atomic<bool> m_seekPending; // Set with m_seek, lets a running fill stop early
+	std::atomic<unsigned> m_seekApplied;
+
+	std::condition_variable m_wakeCond; // Signaled with m_sourceMutex when the source changes or on stop
+	bool m_wake;
+
+	sizing_t m_sizing; // Only accessed by the thread
+	std::atomic<bool> m_boost;
+	int m_minWatermark;
+	int m_maxWatermark;
+	SizingCallback* m_cbSizing;
 };
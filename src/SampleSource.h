@@ -15,4 +15,7 @@ class SampleSource
 {
   public:
 	virtual int readSamples(SampleProducer* sampleBuffer) = 0;
+
+	// Continue reading at seconds into the source, returns 0 on success
+	virtual int seek(double seconds) = 0;
 };
@@ -8,12 +8,14 @@
 
 
 #include <algorithm>
+#include <QString>
 #include "inputfile.h"
+#include "MediaInfoCache.h"
 #include "SampleVisualizerThread.h"
 #include "SampleBuffer.h"
 
 #define MIN_SAMPLES_PER_ITERATION (1024 * 32)
-#define SAMPLE_RATE 44100;
+#define SAMPLE_RATE 44100
 
 
 SampleVisualizerThread::SampleBufferSynced::SampleBufferSynced(int channels, size_t maxSize) :
@@ -29,8 +31,24 @@ void SampleVisualizerThread::SampleBufferSynced::produce(const short* samples, i
 }
 
 
+int SampleVisualizerThread::SampleBufferSynced::reserve(short** samples, int maxCount)
+{
+	SampleBuffer::Lock l(getMutex());
+	return SampleBuffer::reserve(samples, maxCount);
+}
+
+
+void SampleVisualizerThread::SampleBufferSynced::commit(int count)
+{
+	SampleBuffer::Lock l(getMutex());
+	SampleBuffer::commit(count);
+}
+
+
 double SampleVisualizerThread::fileLength() const
 {
+	if (m_knownLength > 0.0)
+		return m_knownLength;
 	uint64_t samples = m_running ? m_numSamplesTotalEst : m_numSamplesProcessed;
 	return double(samples) / SAMPLE_RATE;
 }
@@ -50,6 +68,7 @@ SampleVisualizerThread::SampleVisualizerThread() :
 	m_numSamplesProcessed(0),
 	m_numSamplesTotalEst(0),
 	m_numSamplesProcessedThisBin(0),
+	m_knownLength(-1.0),
 	m_file(nullptr),
 	m_running(false),
 	m_newFile(false),
@@ -69,6 +88,7 @@ void SampleVisualizerThread::startAnalysis(const char* filename, size_t numBins)
 	Lock lock(m_mutex);
 
 	m_filename = filename;
+	m_knownLength = MediaInfoCache::GetInstance().duration(QString::fromUtf8(filename));
 	m_numBins = numBins;
 	m_numBinsProcessed = 0;
 	m_numSamplesProcessed = 0;
@@ -154,9 +174,11 @@ void SampleVisualizerThread::openNewFile()
 	InputFileOptions options;
 	options.outputChannelLayout = InputFileOptions::MONO;
 	options.outputSampleRate = SAMPLE_RATE;
-	m_file = CreateInputFileFFmpeg(options);
+	options.pooledDecoder = false;
+	m_file = CreateInputFile(m_filename.c_str(), options);
 	if (m_file->open(m_filename.c_str()) == 0)
-		m_numSamplesTotalEst = m_file->outputSamplesEstimation();
+		m_numSamplesTotalEst = m_knownLength > 0.0 ? (int64_t)(m_knownLength * SAMPLE_RATE + 0.5)
+												   : m_file->outputSamplesEstimation();
 	else
 	{
 		delete m_file;
@@ -25,6 +25,8 @@ class SampleVisualizerThread
 	  public:
 		SampleBufferSynced(int channels, size_t maxSize = 0);
 		virtual void produce(const short* samples, int count) override;
+		virtual int reserve(short** samples, int maxCount) override;
+		virtual void commit(int count) override;
 	};
 
   public:
@@ -44,6 +46,7 @@ class SampleVisualizerThread
 	}
 
 	// Get file length in seconds, might be an estimation when processing isn't finished yet
+	// and the file isn't in the media info cache
 	double fileLength() const;
 
 	static SampleVisualizerThread& GetInstance();
@@ -64,6 +67,7 @@ class SampleVisualizerThread
 	int64_t m_numSamplesProcessed;
 	int64_t m_numSamplesTotalEst;
 	size_t m_numSamplesProcessedThisBin;
+	double m_knownLength; // Exact length in seconds from the media info cache, negative if unknown
 	int m_min;
 	int m_max;
 	mutable std::mutex m_mutex;
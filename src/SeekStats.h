@@ -0,0 +1,62 @@
+// src/SeekStats.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+
+
+// Latency of seeks during playback: from the request until an audio callback delivered the first samples of the
+// new position. Recorded by the audio threads with relaxed atomics only, readers may see a slightly torn snapshot.
+class SeekStats
+{
+  public:
+	struct snapshot_t
+	{
+		uint64_t seeks;
+		double averageMs;
+		double maxMs;
+		double lastMs;
+	};
+
+	SeekStats() :
+		m_seeks(0),
+		m_totalUs(0),
+		m_maxUs(0),
+		m_lastUs(0)
+	{
+	}
+
+	// Audio thread: a seek was heard after us microseconds. Only one thread records at a time.
+	inline void record(int64_t us)
+	{
+		m_seeks.fetch_add(1, std::memory_order_relaxed);
+		m_totalUs.fetch_add(us, std::memory_order_relaxed);
+		m_maxUs.store(std::max(us, m_maxUs.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+		m_lastUs.store(us, std::memory_order_relaxed);
+	}
+
+	snapshot_t read() const
+	{
+		snapshot_t s;
+		s.seeks = m_seeks.load(std::memory_order_relaxed);
+		const int64_t total = m_totalUs.load(std::memory_order_relaxed);
+		s.averageMs = s.seeks > 0 ? (double)total / (double)s.seeks / 1000.0 : 0.0;
+		s.maxMs = (double)m_maxUs.load(std::memory_order_relaxed) / 1000.0;
+		s.lastMs = (double)m_lastUs.load(std::memory_order_relaxed) / 1000.0;
+		return s;
+	}
+
+  private:
+	std::atomic<uint64_t> m_seeks;
+	std::atomic<int64_t> m_totalUs;
+	std::atomic<int64_t> m_maxUs;
+	std::atomic<int64_t> m_lastUs;
+};
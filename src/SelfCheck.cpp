@@ -0,0 +1,440 @@
+// src/SelfCheck.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "SelfCheck.h"
+#include "inputfile.h"
+#include "SampleBuffer.h"
+#include "MixKernel.h"
+#include "HighResClock.h"
+
+// The producer thread keeps at least this many frames buffered
+#define BUFFER_LOW_WATER 4096
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+
+
+namespace
+{
+struct fixture_t
+{
+	const char* name;
+	int formatTag;
+	int bitsPerSample;
+	int channels;
+	int sampleRate;
+	double seconds;
+};
+
+// Cover the native wave backend and the FFmpeg conversion paths (resample, mono, float)
+const fixture_t g_fixtures[] = {
+	{"pcm16_48k_stereo", WAVE_FORMAT_PCM, 16, 2, 48000, 3.0},
+	{"pcm16_44k_stereo", WAVE_FORMAT_PCM, 16, 2, 44100, 3.0},
+	{"pcm16_48k_mono", WAVE_FORMAT_PCM, 16, 1, 48000, 3.0},
+	{"float_48k_stereo", WAVE_FORMAT_IEEE_FLOAT, 32, 2, 48000, 3.0},
+};
+
+enum device_e
+{
+	eDEVICE_MONO = 0, // Capture device, nothing recorded
+	eDEVICE_STEREO_MIC, // Stereo capture with voice already in the buffer
+	eDEVICE_STEREO, // Playback, empty buffer
+	eDEVICE_SURROUND, // 5.1 playback, empty buffer
+	eDEVICE_COUNT
+};
+
+const unsigned int g_surroundSpeakers[] = {
+	SPEAKER_FRONT_LEFT, SPEAKER_FRONT_RIGHT, SPEAKER_FRONT_CENTER,
+	SPEAKER_LOW_FREQUENCY, SPEAKER_BACK_LEFT, SPEAKER_BACK_RIGHT,
+};
+
+struct case_t
+{
+	const char* name;
+	int fixture;
+	double startTime; // Crop like SoundInfo, odd values exercise the skip arithmetic after seeking
+	double playTime;
+	double volumeDb; // +6 dB drives the limiter
+	device_e device;
+};
+
+const case_t g_cases[] = {
+	{"wav_full_stereo", 0, 0.0, -1.0, 0.0, eDEVICE_STEREO},
+	{"wav_crop_mono", 0, 0.5, 1.25, 0.0, eDEVICE_MONO},
+	{"wav_loud_mic", 0, 0.123457, -1.0, 6.0, eDEVICE_STEREO_MIC},
+	{"wav_surround", 0, 0.0, 2.0, -3.0, eDEVICE_SURROUND},
+	{"resample_full_stereo", 1, 0.0, -1.0, 0.0, eDEVICE_STEREO},
+	{"resample_crop_mic", 1, 0.987654, 1.111111, 0.0, eDEVICE_STEREO_MIC},
+	{"resample_loud_surround", 1, 0.25, -1.0, 6.0, eDEVICE_SURROUND},
+	{"mono_full_stereo", 2, 0.0, -1.0, 0.0, eDEVICE_STEREO},
+	{"mono_crop_mono", 2, 1.000021, 0.5, 6.0, eDEVICE_MONO},
+	{"float_full_stereo", 3, 0.0, -1.0, 0.0, eDEVICE_STEREO},
+	{"float_crop_surround", 3, 0.333333, 2.2, 0.0, eDEVICE_SURROUND},
+	{"float_loud_mic", 3, 2.5, -1.0, 6.0, eDEVICE_STEREO_MIC},
+};
+
+// Frames per callback. TS3 mostly asks for 10 ms, the odd sizes catch assumptions about block sizes.
+const int g_schedule[] = {480, 480, 480, 960, 480, 441, 1024, 480, 17, 480, 2048, 480};
+
+
+// Deterministic noise, rand() differs between platforms
+struct Lcg
+{
+	uint32_t state;
+	inline int32_t nextInt()
+	{
+		state = state * 1664525u + 1013904223u;
+		return (int32_t)state;
+	}
+	inline float next()
+	{
+		return (float)nextInt() / 2147483648.0f;
+	}
+};
+
+
+// First quarter of a sine wave with an amplitude of 16384 (-6 dBFS). The fixtures are made with integer math
+// from it, sin() and the rounding functions may differ in the last bit between C libraries.
+const int16_t g_quarterSine[65] = {
+	0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196, 3590, 3981, 4370, 4756,
+	5139, 5520, 5897, 6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434,
+	9760, 10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406, 12665, 12916, 13160,
+	13395, 13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978, 15137, 15286, 15426, 15557,
+	15679, 15791, 15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379, 16384,
+};
+
+
+// Sine at step, a period being 256 steps
+int32_t sineStep(uint32_t step)
+{
+	const uint32_t i = step & 63;
+	switch ((step >> 6) & 3)
+	{
+	case 0:
+		return g_quarterSine[i];
+	case 1:
+		return g_quarterSine[64 - i];
+	case 2:
+		return -g_quarterSine[i];
+	default:
+		return -g_quarterSine[64 - i];
+	}
+}
+
+
+// Sine at phase, a full period being 2^32, linearly interpolated between the steps
+int32_t sine(uint32_t phase)
+{
+	const int32_t a = sineStep(phase >> 24);
+	const int32_t b = sineStep((phase >> 24) + 1);
+	return a + (b - a) * (int32_t)((phase >> 8) & 0xFFFF) / 65536;
+}
+
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	return hash;
+}
+
+
+void put(std::vector<uint8_t>& out, uint32_t v, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out.push_back((uint8_t)(v >> (i * 8)));
+}
+
+
+// Sweep from 100 Hz rising by 2 kHz per second plus noise at about -4 dBFS, different in every channel.
+// The float fixture holds the same 16 bit values, which convert exactly.
+bool writeFixture(const fixture_t& f, const std::string& path)
+{
+	const int frames = (int)(f.seconds * f.sampleRate);
+	const int bytesPerSample = f.bitsPerSample / 8;
+	const uint32_t dataSize = (uint32_t)(frames * f.channels * bytesPerSample);
+
+	std::vector<uint8_t> file;
+	file.reserve(44 + dataSize);
+	file.insert(file.end(), {'R', 'I', 'F', 'F'});
+	put(file, 36 + dataSize, 4);
+	file.insert(file.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+	put(file, 16, 4);
+	put(file, f.formatTag, 2);
+	put(file, f.channels, 2);
+	put(file, f.sampleRate, 4);
+	put(file, f.sampleRate * f.channels * bytesPerSample, 4);
+	put(file, f.channels * bytesPerSample, 2);
+	put(file, f.bitsPerSample, 2);
+	file.insert(file.end(), {'d', 'a', 't', 'a'});
+	put(file, dataSize, 4);
+
+	Lcg noise = {12345};
+	const uint64_t rate = (uint64_t)f.sampleRate;
+	uint32_t phase = 0;
+	for (int i = 0; i < frames; i++)
+	{
+		// Phase increment of the current frequency, 100 + 2000 * i / rate Hz
+		phase += (uint32_t)(((100 * rate + 2000 * (uint64_t)i) << 32) / (rate * rate));
+		for (int c = 0; c < f.channels; c++)
+		{
+			// Channel c runs at 1 + c / 2 times the frequency, the noise is at -20 dBFS
+			const uint32_t channelPhase = (uint32_t)(((uint64_t)phase * (uint64_t)(2 + c)) >> 1);
+			const int16_t v = (int16_t)(sine(channelPhase) + noise.nextInt() / 655360);
+			if (f.formatTag == WAVE_FORMAT_IEEE_FLOAT)
+			{
+				const float sample = (float)v / 32768.0f;
+				uint32_t bits;
+				memcpy(&bits, &sample, 4);
+				put(file, bits, 4);
+			}
+			else
+				put(file, (uint16_t)v, 2);
+		}
+	}
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (!fp)
+		return false;
+	const bool ok = fwrite(file.data(), 1, file.size(), fp) == file.size();
+	return fclose(fp) == 0 && ok;
+}
+
+
+// Feeds one buffer the way the producer thread does for a single enabled buffer
+class BufferFeeder : public SampleProducer
+{
+  public:
+	BufferFeeder(SampleBuffer& sb) :
+		m_sb(sb)
+	{
+	}
+
+	void produce(const short* samples, int count) override
+	{
+		SampleBuffer::Lock lock(m_sb.getMutex());
+		m_sb.produce(samples, count);
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		SampleBuffer::Lock lock(m_sb.getMutex());
+		return m_sb.reserve(samples, std::min(maxCount, m_sb.freeSpace()));
+	}
+
+	void commit(int count) override
+	{
+		SampleBuffer::Lock lock(m_sb.getMutex());
+		m_sb.commit(count);
+	}
+
+  private:
+	SampleBuffer& m_sb;
+};
+
+
+struct run_t
+{
+	uint64_t hash;
+	int64_t frames; // Frames taken out of the sample buffer
+	double seconds;
+};
+
+
+bool runCase(const case_t& c, const std::string& fixture, run_t& run)
+{
+	const HighResClock::time_point start = HighResClock::now();
+
+	std::unique_ptr<InputFile> file(CreateInputFile(fixture.c_str()));
+	if (file->open(fixture.c_str(), c.startTime, c.playTime) != 0)
+		return false;
+
+	SampleBuffer sb(file->channels(), MAX_SAMPLEBUFFER_SIZE);
+	BufferFeeder feeder(sb);
+
+	ChannelRouting routing;
+	unsigned int filledSpeakers = 0;
+	switch (c.device)
+	{
+	case eDEVICE_MONO:
+		routing.build(1, nullptr);
+		break;
+	case eDEVICE_STEREO_MIC:
+		routing.build(2, nullptr);
+		filledSpeakers = ~0u;
+		break;
+	case eDEVICE_STEREO:
+		routing.build(2, nullptr);
+		break;
+	default:
+		routing.build(6, g_surroundSpeakers);
+		break;
+	}
+	const int channels = routing.numChannels();
+
+	PeakMeter limiter = CreateLimiter();
+	const float volume = VolumeDbToFactor(c.volumeDb);
+	Lcg voice = {777};
+	std::vector<short> out;
+	MixStats stats;
+
+	run.hash = 14695981039346656037ull;
+	run.frames = 0;
+	bool fileDone = false;
+	for (size_t k = 0;; k++)
+	{
+		const int count = g_schedule[k % (sizeof(g_schedule) / sizeof(g_schedule[0]))];
+
+		int avail;
+		{
+			SampleBuffer::Lock lock(sb.getMutex());
+			avail = sb.avail();
+		}
+		while (!fileDone && avail < count + BUFFER_LOW_WATER)
+		{
+			const int read = file->readSamples(&feeder);
+			if (read < 0)
+				return false;
+			fileDone = read == 0;
+			SampleBuffer::Lock lock(sb.getMutex());
+			avail = sb.avail();
+		}
+
+		// Filled channels carry quiet voice, the others garbage that has to be overwritten
+		out.resize((size_t)count * channels);
+		for (short& s : out)
+			s = (short)(voice.next() * 2000.0f);
+
+		const int written = MixFromBuffer(sb, out.data(), count, routing, filledSpeakers, volume, limiter, stats);
+		if (written == 0 && fileDone)
+			break;
+		run.hash = fnv1a(out.data(), out.size() * sizeof(short), run.hash);
+		run.frames += written;
+	}
+	file->close();
+
+	std::chrono::duration<double> elapsed = HighResClock::now() - start;
+	run.seconds = elapsed.count();
+	return true;
+}
+
+
+bool readGolden(const std::string& path, std::map<std::string, uint64_t>& golden)
+{
+	FILE* fp = fopen(path.c_str(), "r");
+	if (!fp)
+		return false;
+	char name[128];
+	unsigned long long hash;
+	while (fscanf(fp, "%127s %llx", name, &hash) == 2)
+		golden[name] = hash;
+	fclose(fp);
+	return true;
+}
+} // namespace
+
+
+int RunSelfCheck(const std::string& workDir, const std::string& goldenFile, bool record, int repeat)
+{
+	std::map<std::string, uint64_t> golden;
+	if (!record && !readGolden(goldenFile, golden))
+	{
+		fprintf(stderr, "Cannot read %s\n", goldenFile.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> fixtures;
+	for (const fixture_t& f : g_fixtures)
+	{
+		fixtures.push_back(workDir + "/rpsb_fixture_" + f.name + ".wav");
+		if (!writeFixture(f, fixtures.back()))
+		{
+			fprintf(stderr, "Cannot write %s\n", fixtures.back().c_str());
+			return 1;
+		}
+	}
+
+	int failed = 0, unrecorded = 0;
+	double totalAudio = 0.0, totalSeconds = 0.0;
+	std::vector<std::pair<std::string, uint64_t>> results;
+	for (const case_t& c : g_cases)
+	{
+		run_t first = {}, run = {};
+		double best = 0.0;
+		bool ok = true;
+		for (int i = 0; i < repeat && ok; i++)
+		{
+			ok = runCase(c, fixtures[c.fixture], run);
+			if (i == 0)
+				first = run;
+			// The same input has to give the same output every time
+			ok = ok && run.hash == first.hash && run.frames == first.frames;
+			best = i == 0 ? run.seconds : std::min(best, run.seconds);
+		}
+
+		const char* verdict;
+		if (!ok)
+			verdict = "ERROR";
+		else if (record)
+			verdict = "RECORDED";
+		else if (golden.count(c.name) == 0)
+		{
+			// Every case has to be recorded, a case without a golden hash checks nothing
+			verdict = "MISSING";
+			unrecorded++;
+		}
+		else
+			verdict = golden[c.name] == first.hash ? "OK" : "MISMATCH";
+		if (strcmp(verdict, record ? "RECORDED" : "OK") != 0)
+			failed++;
+
+		const double audio = (double)first.frames / 48000.0;
+		totalAudio += audio;
+		totalSeconds += best;
+		printf(
+			"%-24s %-8s %016llx %7.2f s %8.1fx real-time\n", c.name, verdict, (unsigned long long)first.hash, audio,
+			best > 0.0 ? audio / best : 0.0
+		);
+		results.emplace_back(c.name, first.hash);
+	}
+
+	for (const std::string& fixture : fixtures)
+		remove(fixture.c_str());
+
+	printf(
+		"%i of %i cases failed, %.1fx real-time per core overall\n", failed, (int)results.size(),
+		totalSeconds > 0.0 ? totalAudio / totalSeconds : 0.0
+	);
+	if (unrecorded > 0)
+		printf("%i cases have no golden hash in %s, record them with --record\n", unrecorded, goldenFile.c_str());
+
+	if (record && failed == 0)
+	{
+		FILE* fp = fopen(goldenFile.c_str(), "w");
+		if (!fp)
+		{
+			fprintf(stderr, "Cannot write %s\n", goldenFile.c_str());
+			return 1;
+		}
+		for (const auto& result : results)
+			fprintf(fp, "%s %016llx\n", result.first.c_str(), (unsigned long long)result.second);
+		fclose(fp);
+	}
+	return failed == 0 ? 0 : 1;
+}
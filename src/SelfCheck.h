@@ -0,0 +1,21 @@
+// src/SelfCheck.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <string>
+
+
+// Bit-exact regression check of the playback engine.
+// Writes fixture files with known content to workDir, plays them through the input files, the sample
+// buffer and the mix kernel on a simulated TS3 callback schedule and hashes everything the callbacks
+// emit. The hashes are compared against goldenFile, or written to it if record is set. A case goldenFile
+// has no hash for fails, src/selfcheck.golden is recorded on a build with FFmpeg.
+// Every case is run repeat times, which doubles as a benchmark of the whole chain.
+// Returns 0 if all cases match.
+int RunSelfCheck(const std::string& workDir, const std::string& goldenFile, bool record, int repeat);
@@ -9,6 +9,8 @@
 
 #include "SoundInfo.h"
 
+#include <QStringList>
+
 #define NAME_PATH "path"
 #define NAME_CUSTOM_TEXT "customText"
 #define NAME_CUSTOM_COLOR "customColor"
@@ -19,6 +21,13 @@
 #define NAME_CROP_STOP_AFTER_AT "cropStopAfterAt"
 #define NAME_CROP_STOP_VALUE "cropStopValue"
 #define NAME_CROP_STOP_UNIT "cropStopUnit"
+#define NAME_PLAYLIST "playlist"
+#define NAME_PLAYLIST_ORDER "playlistOrder"
+#define NAME_CROSSFADE_MS "crossfadeMs"
+#define NAME_MACRO "macro"
+#define NAME_QUANTIZE_BPM "quantizeBpm"
+#define NAME_QUANTIZE_GRID "quantizeGrid"
+#define NAME_LOOP "loop"
 
 #define DEFAULT_PATH ""
 #define DEFAULT_CUSTOM_TEXT ""
@@ -30,6 +39,13 @@
 #define DEFAULT_CROP_STOP_AFTER_AT 0
 #define DEFAULT_CROP_STOP_VALUE 0
 #define DEFAULT_CROP_STOP_UNIT 1
+#define DEFAULT_PLAYLIST ""
+#define DEFAULT_PLAYLIST_ORDER ePLAYLIST_IN_ORDER
+#define DEFAULT_CROSSFADE_MS 0
+#define DEFAULT_MACRO ""
+#define DEFAULT_QUANTIZE_BPM 0
+#define DEFAULT_QUANTIZE_GRID eQUANTIZE_BEAT
+#define DEFAULT_LOOP false
 
 
 QColor stringToColor(const QString& str)
@@ -55,7 +71,12 @@ SoundInfo::SoundInfo() :
 	cropStartUnit(DEFAULT_CROP_START_UNIT),
 	cropStopAfterAt(DEFAULT_CROP_STOP_AFTER_AT),
 	cropStopValue(DEFAULT_CROP_STOP_VALUE),
-	cropStopUnit(DEFAULT_CROP_STOP_UNIT)
+	cropStopUnit(DEFAULT_CROP_STOP_UNIT),
+	playlistOrder(DEFAULT_PLAYLIST_ORDER),
+	crossfadeMs(DEFAULT_CROSSFADE_MS),
+	quantizeBpm(DEFAULT_QUANTIZE_BPM),
+	quantizeGrid(DEFAULT_QUANTIZE_GRID),
+	loop(DEFAULT_LOOP)
 {
 }
 
@@ -72,6 +93,16 @@ void SoundInfo::readFromConfig(const QSettings& settings)
 	cropStopAfterAt = settings.value(NAME_CROP_STOP_AFTER_AT, DEFAULT_CROP_STOP_AFTER_AT).toInt();
 	cropStopValue = settings.value(NAME_CROP_STOP_VALUE, DEFAULT_CROP_STOP_VALUE).toInt();
 	cropStopUnit = settings.value(NAME_CROP_STOP_UNIT, DEFAULT_CROP_STOP_UNIT).toInt();
+	playlist.clear();
+	const QString ids = settings.value(NAME_PLAYLIST, DEFAULT_PLAYLIST).toString();
+	for (const QString& id : ids.split(',', QString::SkipEmptyParts))
+		playlist.append(id.toInt());
+	playlistOrder = settings.value(NAME_PLAYLIST_ORDER, DEFAULT_PLAYLIST_ORDER).toInt();
+	crossfadeMs = settings.value(NAME_CROSSFADE_MS, DEFAULT_CROSSFADE_MS).toInt();
+	macro = parseMacro(settings.value(NAME_MACRO, DEFAULT_MACRO).toString(), 0);
+	quantizeBpm = settings.value(NAME_QUANTIZE_BPM, DEFAULT_QUANTIZE_BPM).toInt();
+	quantizeGrid = settings.value(NAME_QUANTIZE_GRID, DEFAULT_QUANTIZE_GRID).toInt();
+	loop = settings.value(NAME_LOOP, DEFAULT_LOOP).toBool();
 }
 
 
@@ -87,6 +118,16 @@ void SoundInfo::saveToConfig(QSettings& settings) const
 	settings.setValue(NAME_CROP_STOP_AFTER_AT, cropStopAfterAt);
 	settings.setValue(NAME_CROP_STOP_VALUE, cropStopValue);
 	settings.setValue(NAME_CROP_STOP_UNIT, cropStopUnit);
+	QStringList ids;
+	for (int id : playlist)
+		ids.append(QString::number(id));
+	settings.setValue(NAME_PLAYLIST, ids.join(','));
+	settings.setValue(NAME_PLAYLIST_ORDER, playlistOrder);
+	settings.setValue(NAME_CROSSFADE_MS, crossfadeMs);
+	settings.setValue(NAME_MACRO, formatMacro(macro, 0, ","));
+	settings.setValue(NAME_QUANTIZE_BPM, quantizeBpm);
+	settings.setValue(NAME_QUANTIZE_GRID, quantizeGrid);
+	settings.setValue(NAME_LOOP, loop);
 }
 
 
@@ -121,3 +162,61 @@ double SoundInfo::getTimeUnitFactor(int unit)
 		throw std::logic_error("No such unit");
 	}
 }
+
+
+double SoundInfo::getQuantizeBeats(int grid)
+{
+	switch (grid)
+	{
+	case eQUANTIZE_BAR:
+		return 4.0;
+	case eQUANTIZE_HALF_BEAT:
+		return 0.5;
+	case eQUANTIZE_QUARTER_BEAT:
+		return 0.25;
+	case eQUANTIZE_BEAT:
+	default:
+		return 1.0;
+	}
+}
+
+
+QList<SoundInfo::macro_voice_t> SoundInfo::parseMacro(const QString& text, int firstId)
+{
+	QList<macro_voice_t> macro;
+	for (const QString& part : text.split(',', QString::SkipEmptyParts))
+	{
+		const QStringList at = part.split('@');
+		bool ok = false;
+		const int number = at.front().trimmed().toInt(&ok);
+		if (!ok || number < firstId)
+			continue;
+
+		macro_voice_t voice = {number - firstId, 0, -1};
+		if (at.size() > 1)
+		{
+			const QStringList times = at[1].split('-');
+			voice.startMs = std::max(times.front().trimmed().toInt(), 0);
+			if (times.size() > 1)
+				voice.stopMs = std::max(times[1].trimmed().toInt(), voice.startMs);
+		}
+		macro.append(voice);
+	}
+	return macro;
+}
+
+
+QString SoundInfo::formatMacro(const QList<macro_voice_t>& macro, int firstId, const QString& separator)
+{
+	QStringList parts;
+	for (const macro_voice_t& voice : macro)
+	{
+		QString part = QString::number(voice.buttonId + firstId);
+		if (voice.startMs > 0 || voice.stopMs >= 0)
+			part += QString("@%1").arg(voice.startMs);
+		if (voice.stopMs >= 0)
+			part += QString("-%1").arg(voice.stopMs);
+		parts.append(part);
+	}
+	return parts.join(separator);
+}
@@ -10,10 +10,35 @@
 
 #include <QSettings>
 #include <QColor>
+#include <QList>
 #include <stdexcept>
 
 class SoundInfo
 {
+  public:
+	enum playlist_order_e
+	{
+		ePLAYLIST_IN_ORDER = 0,
+		ePLAYLIST_SHUFFLED,
+	};
+
+	// Distance of the lines of the grid quantized presses start on
+	enum quantize_grid_e
+	{
+		eQUANTIZE_BEAT = 0,
+		eQUANTIZE_BAR, // Four beats
+		eQUANTIZE_HALF_BEAT,
+		eQUANTIZE_QUARTER_BEAT,
+	};
+
+	// A sound of a macro and when it plays, relative to the start of the macro
+	struct macro_voice_t
+	{
+		int buttonId;
+		int startMs;
+		int stopMs; // -1 plays the sound to its end
+	};
+
   public:
 	SoundInfo();
 	void readFromConfig(const QSettings& settings);
@@ -31,6 +56,26 @@ class SoundInfo
 		customColor.setAlpha(enabled ? 255 : 0);
 	}
 
+	// Plays the sounds of other buttons back to back instead of a file
+	bool isPlaylist() const
+	{
+		return !playlist.isEmpty();
+	}
+
+	// Layers the sounds of other buttons at fixed offsets instead of a file, takes precedence over a playlist
+	bool isMacro() const
+	{
+		return !macro.isEmpty();
+	}
+
+	// Beats between two lines of a quantize_grid_e
+	static double getQuantizeBeats(int grid);
+
+	// Macro voices as text like "1, 4@250, 5@250-1250": the button, optionally followed by the start and the stop
+	// in ms. firstId is the number of the first button in the text.
+	static QList<macro_voice_t> parseMacro(const QString& text, int firstId);
+	static QString formatMacro(const QList<macro_voice_t>& macro, int firstId, const QString& separator);
+
   public:
 	QString filename;
 	QString customText;
@@ -42,4 +87,11 @@ class SoundInfo
 	int cropStopAfterAt;
 	int cropStopValue;
 	int cropStopUnit;
+	QList<int> playlist; // Ids of the buttons to play, in this order unless shuffled
+	int playlistOrder; // playlist_order_e
+	int crossfadeMs; // Between the sounds of the playlist
+	QList<macro_voice_t> macro;
+	int quantizeBpm; // Tempo of the grid a press is delayed to, 0 starts the sound at once
+	int quantizeGrid; // quantize_grid_e
+	bool loop; // Start over without a gap when the sound or the last sound of the playlist ends, until stopped
 };
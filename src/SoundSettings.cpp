@@ -18,6 +18,32 @@
 #include <QFileInfo>
 #include "MainWindow.h"
 #include <QColorDialog>
+#include <QStringList>
+
+
+// Button numbers as shown on the buttons, e.g. "3, 5, 7-9", to button ids
+static QList<int> parseButtonList(const QString& text)
+{
+	QList<int> ids;
+	for (const QString& part : text.split(',', QString::SkipEmptyParts))
+	{
+		const QStringList range = part.split('-');
+		const int first = range.front().trimmed().toInt();
+		const int last = range.size() > 1 ? range.back().trimmed().toInt() : first;
+		for (int number = first; number > 0 && number <= last; number++)
+			ids.append(number - 1);
+	}
+	return ids;
+}
+
+
+static QString formatButtonList(const QList<int>& ids)
+{
+	QStringList numbers;
+	for (int id : ids)
+		numbers.append(QString::number(id + 1));
+	return numbers.join(", ");
+}
 
 
 SoundSettingsQt::SoundSettingsQt(const SoundInfo& soundInfo, size_t buttonId, QWidget* parent /*= 0*/) :
@@ -40,6 +66,12 @@ SoundSettingsQt::SoundSettingsQt(const SoundInfo& soundInfo, size_t buttonId, QW
 	ui->stopSoundUnitCombo->addItem("seconds");
 	ui->stopSoundAtAfterCombo->addItem("after");
 	ui->stopSoundAtAfterCombo->addItem("at");
+	ui->playlistOrderCombo->addItem("in order");
+	ui->playlistOrderCombo->addItem("shuffled");
+	ui->quantizeGridCombo->addItem("beat");
+	ui->quantizeGridCombo->addItem("bar");
+	ui->quantizeGridCombo->addItem("1/2 beat");
+	ui->quantizeGridCombo->addItem("1/4 beat");
 	connect(ui->soundVolumeSlider, SIGNAL(valueChanged(int)), this, SLOT(onVolumeChanged(int)));
 	connect(ui->filenameBrowseButton, SIGNAL(released()), this, SLOT(onBrowsePressed()));
 	connect(ui->previewSoundButton, SIGNAL(released()), this, SLOT(onPreviewPressed()));
@@ -74,6 +106,17 @@ void SoundSettingsQt::initGui(const SoundInfo& sound)
 	ui->stopSoundAtAfterCombo->setCurrentIndex(sound.cropStopAfterAt);
 	ui->stopSoundValueSpin->setValue(sound.cropStopValue);
 	ui->stopSoundUnitCombo->setCurrentIndex(sound.cropStopUnit);
+	ui->groupPlaylist->setChecked(sound.isPlaylist());
+	ui->playlistEdit->setText(formatButtonList(sound.playlist));
+	ui->playlistOrderCombo->setCurrentIndex(sound.playlistOrder);
+	ui->crossfadeSpin->setValue(sound.crossfadeMs);
+	ui->groupMacro->setChecked(sound.isMacro());
+	ui->macroEdit->setText(SoundInfo::formatMacro(sound.macro, 1, ", "));
+	ui->groupQuantize->setChecked(sound.quantizeBpm > 0);
+	if (sound.quantizeBpm > 0)
+		ui->quantizeBpmSpin->setValue(sound.quantizeBpm);
+	ui->quantizeGridCombo->setCurrentIndex(sound.quantizeGrid);
+	ui->loopCheckBox->setChecked(sound.loop);
 	ui->colorCheckBox->setChecked(sound.customColorEnabled());
 	ui->colorButton->setEnabled(sound.customColorEnabled());
 	ui->colorButton->setStyleSheet(QString("background-color: %1").arg(sound.customColor.name()));
@@ -96,6 +139,14 @@ void SoundSettingsQt::fillFromGui(SoundInfo& sound)
 	sound.cropStopAfterAt = ui->stopSoundAtAfterCombo->currentIndex();
 	sound.cropStopValue = ui->stopSoundValueSpin->value();
 	sound.cropStopUnit = ui->stopSoundUnitCombo->currentIndex();
+	sound.playlist = ui->groupPlaylist->isChecked() ? parseButtonList(ui->playlistEdit->text()) : QList<int>();
+	sound.playlistOrder = ui->playlistOrderCombo->currentIndex();
+	sound.crossfadeMs = ui->crossfadeSpin->value();
+	sound.macro = ui->groupMacro->isChecked() ? SoundInfo::parseMacro(ui->macroEdit->text(), 1)
+											  : QList<SoundInfo::macro_voice_t>();
+	sound.quantizeBpm = ui->groupQuantize->isChecked() ? ui->quantizeBpmSpin->value() : 0;
+	sound.quantizeGrid = ui->quantizeGridCombo->currentIndex();
+	sound.loop = ui->loopCheckBox->isChecked();
 	sound.customColor = this->customColor;
 }
 
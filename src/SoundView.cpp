@@ -7,6 +7,7 @@
 //----------------------------------
 
 
+#include <algorithm>
 #include <QPainter>
 #include <QTimer>
 #include "SoundView.h"
@@ -38,7 +39,7 @@ void SoundView::paintEvent(QPaintEvent* evt)
 	double songLength = SampleVisualizerThread::GetInstance().fileLength();
 	double start = m_soundInfo.getStartTime();
 	double playTime = m_soundInfo.getPlayTime();
-	double end = (playTime > 0.0) ? (start + playTime) : songLength;
+	double end = (playTime > 0.0) ? std::min(start + playTime, songLength) : songLength;
 	int startPixel = int(start / songLength * (width() - 1));
 	int endPixel = int(end / songLength * (width() - 1));
 
@@ -0,0 +1,65 @@
+// src/SpscRing.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+
+// Fixed size lock-free queue for exactly one producer and one consumer thread.
+// Neither push nor pop allocate, lock or call into the system, so the producer may be a real-time thread.
+template <class T, size_t N> class SpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "Size must be a power of two");
+
+  public:
+	SpscRing() :
+		m_head(0),
+		m_tail(0)
+	{
+	}
+
+	// Producer: append item, returns false if the ring is full
+	bool push(const T& item)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) == N)
+			return false;
+		m_items[head & (N - 1)] = item;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: take the oldest item, returns false if the ring is empty
+	bool pop(T& item)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail == m_head.load(std::memory_order_acquire))
+			return false;
+		item = m_items[tail & (N - 1)];
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Number of queued items, only exact when called from producer or consumer without the other running
+	size_t size() const
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+	}
+
+	static constexpr size_t capacity()
+	{
+		return N;
+	}
+
+  private:
+	T m_items[N];
+	alignas(64) std::atomic<size_t> m_head; // Written by the producer
+	alignas(64) std::atomic<size_t> m_tail; // Written by the consumer
+};
@@ -0,0 +1,65 @@
+// src/StreamItem.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include "StreamItem.h"
+#include "HeadCache.h"
+#include "MixKernel.h"
+
+
+bool OpenStreamItem(const StreamItem& item, std::unique_ptr<InputFile>& file, const InputFileOptions& options)
+{
+	const char* filename = item.filename.c_str();
+	const InputFile::backend_e backend = HeadCache::GetInstance().contains(item.filename, item.startTime, item.playTime)
+											 ? InputFile::eBACKEND_HEAD
+											 : ChooseInputFileBackend(filename, options);
+	if (!file || file->backend() != backend)
+		file.reset(CreateInputFile(backend, options));
+
+	if (file->open(filename, item.startTime, item.playTime) != 0)
+	{
+		file->close();
+		return false;
+	}
+	return true;
+}
+
+
+ItemCollector::ItemCollector(
+	std::vector<short>& out, std::vector<short>& scratch, int inChannels, int outChannels, float gain
+) :
+	m_out(out),
+	m_scratch(scratch),
+	m_inChannels(inChannels),
+	m_outChannels(outChannels),
+	m_gain(gain)
+{
+}
+
+
+void ItemCollector::produce(const short* samples, int count)
+{
+	const size_t size = m_out.size();
+	m_out.resize(size + (size_t)count * m_outChannels);
+	ConvertFrames(samples, m_inChannels, m_out.data() + size, m_outChannels, count, m_gain);
+}
+
+
+int ItemCollector::reserve(short** samples, int maxCount)
+{
+	m_scratch.resize((size_t)maxCount * m_inChannels);
+	*samples = m_scratch.data();
+	return maxCount;
+}
+
+
+void ItemCollector::commit(int count)
+{
+	produce(m_scratch.data(), count);
+}
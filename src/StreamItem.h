@@ -0,0 +1,51 @@
+// src/StreamItem.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inputfile.h"
+#include "SampleProducer.h"
+
+
+// A sound played as part of a stream that joins several of them, see InputFilePlaylist and InputFileMacro
+struct StreamItem
+{
+	std::string filename; // UTF-8
+	double startTime;
+	double playTime;
+	float gain; // Linear, applied before the volume of the stream
+};
+
+
+// Open item in file, which is replaced if it has the wrong backend. Sounds with a decoded head start from it.
+// Returns false if the file cannot be opened, file is closed then.
+bool OpenStreamItem(const StreamItem& item, std::unique_ptr<InputFile>& file, const InputFileOptions& options);
+
+
+// Appends the output of a decoder to a stream, converted to its channels and gain
+class ItemCollector : public SampleProducer
+{
+  public:
+	// scratch: Holds the decoder output before it is converted, kept to not allocate on every read
+	ItemCollector(std::vector<short>& out, std::vector<short>& scratch, int inChannels, int outChannels, float gain);
+
+	void produce(const short* samples, int count) override;
+	int reserve(short** samples, int maxCount) override;
+	void commit(int count) override;
+
+  private:
+	std::vector<short>& m_out;
+	std::vector<short>& m_scratch;
+	const int m_inChannels;
+	const int m_outChannels;
+	const float m_gain;
+};
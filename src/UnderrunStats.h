@@ -0,0 +1,79 @@
+// src/UnderrunStats.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+// Number of underrun times kept for the statistics
+#define UNDERRUN_HISTORY 16
+
+
+// Counts the underruns of the audio callbacks: a sound was playing, its source had samples left,
+// but the buffer couldn't fill the block. Recorded by the audio threads with relaxed atomics only,
+// readers may see a snapshot that is a few frames off.
+class UnderrunStats
+{
+  public:
+	struct snapshot_t
+	{
+		uint64_t capture; // Underruns of the stream sent to the channel
+		uint64_t playback; // Underruns of the local playback
+		uint64_t missingFrames; // Frames that weren't delivered during underruns
+		int numRecent;
+		int64_t recent[UNDERRUN_HISTORY]; // Wall clock times in ms since the epoch, newest first
+	};
+
+	UnderrunStats() :
+		m_capture(0),
+		m_playback(0),
+		m_missingFrames(0),
+		m_next(0)
+	{
+		for (std::atomic<int64_t>& t : m_times)
+			t.store(0, std::memory_order_relaxed);
+	}
+
+	// Audio thread: a new underrun started
+	inline void record(bool capture)
+	{
+		(capture ? m_capture : m_playback).fetch_add(1, std::memory_order_relaxed);
+		using namespace std::chrono;
+		const int64_t now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+		const unsigned slot = m_next.fetch_add(1, std::memory_order_relaxed) % UNDERRUN_HISTORY;
+		m_times[slot].store(now, std::memory_order_relaxed);
+	}
+
+	// Audio thread: frames missing in a block during an underrun
+	inline void addMissing(int frames)
+	{
+		m_missingFrames.fetch_add((uint64_t)frames, std::memory_order_relaxed);
+	}
+
+	snapshot_t read() const
+	{
+		snapshot_t s;
+		s.capture = m_capture.load(std::memory_order_relaxed);
+		s.playback = m_playback.load(std::memory_order_relaxed);
+		s.missingFrames = m_missingFrames.load(std::memory_order_relaxed);
+		const unsigned next = m_next.load(std::memory_order_relaxed);
+		s.numRecent = 0;
+		for (unsigned i = 1; i <= UNDERRUN_HISTORY && i <= next; i++)
+			s.recent[s.numRecent++] = m_times[(next - i) % UNDERRUN_HISTORY].load(std::memory_order_relaxed);
+		return s;
+	}
+
+  private:
+	std::atomic<uint64_t> m_capture;
+	std::atomic<uint64_t> m_playback;
+	std::atomic<uint64_t> m_missingFrames;
+	std::atomic<unsigned> m_next;
+	std::atomic<int64_t> m_times[UNDERRUN_HISTORY];
+};
@@ -0,0 +1,44 @@
+// src/inputfile.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "inputfile.h"
+
+
+InputFile::backend_e ChooseInputFileBackend(const char* filename, InputFileOptions options /*= InputFileOptions()*/)
+{
+	// Wave files that already match the output format need no decoding at all
+	if (CanOpenInputFileWav(filename, options))
+		return InputFile::eBACKEND_WAV;
+
+	return InputFile::eBACKEND_FFMPEG;
+}
+
+
+InputFile* CreateInputFile(const char* filename, InputFileOptions options /*= InputFileOptions()*/)
+{
+	return CreateInputFile(ChooseInputFileBackend(filename, options), options);
+}
+
+
+InputFile* CreateInputFile(InputFile::backend_e backend, InputFileOptions options /*= InputFileOptions()*/)
+{
+	switch (backend)
+	{
+	case InputFile::eBACKEND_WAV:
+		return CreateInputFileWav(options);
+	case InputFile::eBACKEND_HEAD:
+		return CreateInputFileHead(options);
+	case InputFile::eBACKEND_PLAYLIST:
+		return CreateInputFilePlaylist(options);
+	case InputFile::eBACKEND_MACRO:
+		return CreateInputFileMacro(options);
+	case InputFile::eBACKEND_FFMPEG:
+	default:
+		return CreateInputFileFFmpeg(options);
+	}
+}
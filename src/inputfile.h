@@ -19,17 +19,23 @@ struct InputFileOptions
 	{
 		MONO = 0,
 		STEREO,
+		NATIVE, // Mono sources stay mono, everything else is mixed to stereo
 	};
 
 	channel_layout_e outputChannelLayout;
 	int outputSampleRate;
+	bool quiet; // Don't log opening the file, for files examined in the background
+	bool pooledDecoder; // Take the decoder from and return it to the DecoderPool, which is kept for playback
 
 	InputFileOptions() :
-		outputChannelLayout(STEREO),
-		outputSampleRate(48000)
+		outputChannelLayout(NATIVE),
+		outputSampleRate(48000),
+		quiet(false),
+		pooledDecoder(true)
 	{
 	}
 
+	// Maximum number of channels of the output, InputFile::channels() tells the actual number
 	inline int getNumChannels() const
 	{
 		switch (outputChannelLayout)
@@ -37,6 +43,7 @@ struct InputFileOptions
 		case MONO:
 			return 1;
 		case STEREO:
+		case NATIVE:
 			return 2;
 		default:
 			return 0;
@@ -47,13 +54,44 @@ struct InputFileOptions
 
 class InputFile : public SampleSource
 {
+  public:
+	enum backend_e
+	{
+		eBACKEND_FFMPEG = 0,
+		eBACKEND_WAV,
+		eBACKEND_HEAD, // Starts from the HeadCache, then continues with one of the others
+		eBACKEND_PLAYLIST, // Several files back to back, see InputFilePlaylist
+		eBACKEND_MACRO, // Several files layered at fixed offsets, see InputFileMacro
+		eBACKEND_COUNT,
+	};
+
   public:
 	virtual ~InputFile() {};
+	virtual backend_e backend() const = 0;
 	virtual int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) = 0;
 	virtual int close() = 0;
 	virtual bool done() const = 0;
-	virtual int seek(double seconds) = 0;
+
+	// Seconds are counted from startPosSeconds of open(), the play time still ends the sound where it did before
+	int seek(double seconds) override = 0;
 	virtual int64_t outputSamplesEstimation() const = 0;
+
+	// Number of interleaved channels of the produced samples, valid after open
+	virtual int channels() const = 0;
 };
 
 extern InputFile* CreateInputFileFFmpeg(InputFileOptions options = InputFileOptions());
+extern InputFile* CreateInputFileWav(InputFileOptions options = InputFileOptions());
+extern InputFile* CreateInputFileHead(InputFileOptions options = InputFileOptions());
+extern InputFile* CreateInputFilePlaylist(InputFileOptions options = InputFileOptions());
+extern InputFile* CreateInputFileMacro(InputFileOptions options = InputFileOptions());
+
+// Returns true if filename is a wave file that can be played without any conversion
+extern bool CanOpenInputFileWav(const char* filename, InputFileOptions options = InputFileOptions());
+
+// Find the cheapest backend that is able to play filename with the given options
+extern InputFile::backend_e ChooseInputFileBackend(const char* filename, InputFileOptions options = InputFileOptions());
+
+// Create the cheapest backend that is able to play filename with the given options
+extern InputFile* CreateInputFile(const char* filename, InputFileOptions options = InputFileOptions());
+extern InputFile* CreateInputFile(InputFile::backend_e backend, InputFileOptions options = InputFileOptions());
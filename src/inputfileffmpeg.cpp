@@ -17,18 +17,27 @@
 #include <vector>
 #include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <string>
 
 #include "ts3log.h"
 #include "inputfile.h"
 #include "SampleBuffer.h"
 #include "SampleSource.h"
 #include "main.h"
+#include "MappedFile.h"
+#include "DecoderPool.h"
+#include "MediaInfoCache.h"
+#include "HighResClock.h"
 #include <mutex>
 
 extern "C"
 {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/avstring.h>
 #include <libavutil/avutil.h>
 #include <libswresample/swresample.h>
 }
@@ -36,6 +45,21 @@ extern "C"
 
 #define OUTPUT_BUFFER_COUNT 32768
 #define OUTPUT_FORMAT AV_SAMPLE_FMT_S16
+#define IO_BUFFER_SIZE 32768
+
+// Number of files whose open profile is remembered
+#define MAX_OPEN_PROFILES 256
+
+// Probing limits for containers that describe their streams in the header
+#define FAST_PROBE_SIZE 32768
+#define FAST_ANALYZE_DURATION 100000 // microseconds
+
+// Log time from open() to the first decoded samples and the time spent decoding the whole file.
+// Also logs the time spent in openInternal() per container type, with and without a cached open profile.
+// #define MEASURE_OPEN_PERFORMANCE
+
+// Log CPU time spent converting decoded frames, per conversion path and minute of audio
+// #define MEASURE_CONVERSION_PERFORMANCE
 
 
 int checkFFmpegErr(int code, const char* msg = nullptr)
@@ -55,6 +79,108 @@ int checkFFmpegErr(int code, const char* msg = nullptr)
 }
 
 
+namespace
+{
+// What was learned while opening a file the first time, so opening it again doesn't need any probing
+struct OpenProfile
+{
+	int64_t fileSize;
+	int64_t fileMTime;
+	const AVInputFormat* format;
+	unsigned int numStreams;
+	int streamIndex;
+	AVCodecParameters* codecParams;
+	AVRational timeBase;
+	int64_t streamDuration;
+	int64_t duration;
+	uint64_t lastUse;
+};
+
+
+class OpenProfileCache
+{
+  public:
+	~OpenProfileCache()
+	{
+		for (auto& entry : m_profiles)
+			avcodec_parameters_free(&entry.second.codecParams);
+	}
+
+	// Copy the profile of filename into profile. Returns false if there is none or the file changed since.
+	bool get(const std::string& filename, int64_t size, int64_t mtime, OpenProfile& profile)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_profiles.find(filename);
+		if (it == m_profiles.end())
+			return false;
+		if (it->second.fileSize != size || it->second.fileMTime != mtime)
+		{
+			avcodec_parameters_free(&it->second.codecParams);
+			m_profiles.erase(it);
+			return false;
+		}
+
+		it->second.lastUse = ++m_useCounter;
+		profile = it->second;
+		profile.codecParams = avcodec_parameters_alloc();
+		if (!profile.codecParams || avcodec_parameters_copy(profile.codecParams, it->second.codecParams) < 0)
+		{
+			avcodec_parameters_free(&profile.codecParams);
+			return false;
+		}
+		return true;
+	}
+
+	// Remember profile for filename, the cache takes ownership of profile.codecParams
+	void put(const std::string& filename, OpenProfile& profile)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		profile.lastUse = ++m_useCounter;
+
+		auto it = m_profiles.find(filename);
+		if (it != m_profiles.end())
+		{
+			avcodec_parameters_free(&it->second.codecParams);
+			it->second = profile;
+			return;
+		}
+
+		if (m_profiles.size() >= MAX_OPEN_PROFILES)
+		{
+			auto oldest = std::min_element(
+				m_profiles.begin(), m_profiles.end(),
+				[](const auto& a, const auto& b) { return a.second.lastUse < b.second.lastUse; }
+			);
+			avcodec_parameters_free(&oldest->second.codecParams);
+			m_profiles.erase(oldest);
+		}
+		m_profiles.emplace(filename, profile);
+	}
+
+  private:
+	std::mutex m_mutex;
+	std::map<std::string, OpenProfile> m_profiles;
+	uint64_t m_useCounter = 0;
+};
+
+OpenProfileCache g_openProfiles;
+
+
+// Whether the container describes its streams completely in the header,
+// so stream info can be found by reading very little of the file
+bool hasDescriptiveHeader(const AVInputFormat* format)
+{
+	static const char* const names[] = {"wav", "w64", "aiff", "flac", "ogg", "mp3", "mov", "matroska", "caf"};
+	for (const char* name : names)
+	{
+		if (av_match_name(name, format->name))
+			return true;
+	}
+	return false;
+}
+} // namespace
+
+
 class InputFileFFmpeg : public InputFile
 {
   public:
@@ -62,44 +188,93 @@ class InputFileFFmpeg : public InputFile
 	~InputFileFFmpeg();
 	int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) override;
 	int close() override;
+	backend_e backend() const override
+	{
+		return eBACKEND_FFMPEG;
+	}
 
 	int readSamples(SampleProducer* sampleBuffer) override;
 	bool done() const override;
 	int seek(double seconds) override;
 	int64_t outputSamplesEstimation() const override;
+	int channels() const override
+	{
+		return m_outputChannels;
+	}
 
   private:
+	// How decoded frames are turned into the output format
+	enum convert_path_e
+	{
+		eCONVERT_RESAMPLE = 0, // Anything else, use swresample
+		eCONVERT_PASSTHROUGH, // Already s16 with output rate and channels, use frame data directly
+		eCONVERT_S16P, // Planar s16, just interleave
+		eCONVERT_FLT, // Packed float, convert to s16
+		eCONVERT_FLTP, // Planar float, convert to s16 and interleave
+		eCONVERT_COUNT,
+	};
+
 	bool openInternal(const char* filename, double startPosSeconds, double playTimeSeconds);
+	void setOutputChannels(int channels);
 	int closeNoLock();
 	void reset();
 	int getAudioStreamNum() const;
 	int handleDecoded(AVFrame* frame, SampleProducer* sb);
+	int convertDirect(AVFrame* frame, convert_path_e path, SampleProducer* sb);
+	int16_t* reserveOutput(SampleProducer* sb, int count);
+	int commitOutput(const int16_t* samples, int count, SampleProducer* sb);
+	convert_path_e getConvertPath(int format, int sampleRate, int channels) const;
+	bool openFromProfile(const OpenProfile& profile);
+	void storeProfile(const char* filename, int64_t fileSize, int64_t fileMTime);
+	bool openDecoder(const DecoderKey& key, const AVCodecParameters* codecParams, AVRational timeBase);
+	bool initResampler(const AVChannelLayout* inLayout, AVSampleFormat inFormat, int inSampleRate);
 	int receiveSamples(SampleProducer* sampleBuffer, int& producedSamples);
 	int seekNoLock(double seconds);
+	bool openMappedIO(const char* filename);
+
+	static int readMapped(void* opaque, uint8_t* buf, int bufSize);
+	static int64_t seekMapped(void* opaque, int64_t offset, int whence);
 
 	typedef std::lock_guard<std::mutex> Lock;
 
   private:
 	const InputFileOptions m_inputFileOptions;
-	const int m_outputChannels;
+	int m_outputChannels; // Fixed unless the options ask for the native layout, then set on open
 	const int m_outputSamplerate;
 	AVChannelLayout m_outputChannelLayout;
 
+	QString m_filename;
 	AVFormatContext* m_fmtCtx;
+	AVIOContext* m_ioCtx;
+	std::shared_ptr<MappedFile> m_mappedFile;
+	int64_t m_mappedPos;
 	AVCodecContext* m_codecCtx;
 	AVFrame* m_frame = nullptr;
 	AVPacket* m_packet = nullptr;
 	SwrContext* m_swrCtx;
+	DecoderSlot* m_slot; // Owns codec context, resampler, frame, packet and output buffer
 	int m_streamIndex;
 	uint8_t* m_outBuf;
+	bool m_outputReserved;
 	bool m_opened;
 	std::atomic<bool> m_done;
 	std::mutex m_mutex;
 	int64_t m_decodedSamples;
 	int64_t m_convertedSamples;
 	int64_t m_maxConvertedSamples;
+	double m_startPos; // Given to open, seeking is relative to it
 	int64_t m_nextSeekTimestamp;
 	int64_t m_skipSamples;
+
+#ifdef MEASURE_CONVERSION_PERFORMANCE
+	double m_convertTime[eCONVERT_COUNT];
+	int64_t m_convertSamples[eCONVERT_COUNT];
+#endif
+
+#ifdef MEASURE_OPEN_PERFORMANCE
+	std::chrono::time_point<HighResClock> m_openTime;
+	bool m_firstSamplesLogged;
+#endif
 };
 
 
@@ -114,51 +289,308 @@ InputFileFFmpeg::InputFileFFmpeg(const InputFileOptions& options) :
 	);
 
 	reset();
-	av_samples_alloc(&m_outBuf, nullptr, m_outputChannels, OUTPUT_BUFFER_COUNT, OUTPUT_FORMAT, 0);
 }
 
 
 void InputFileFFmpeg::reset()
 {
 	m_fmtCtx = nullptr;
+	m_ioCtx = nullptr;
+	m_mappedPos = 0;
+	m_outputReserved = false;
 	m_codecCtx = nullptr;
 	m_swrCtx = nullptr;
+	m_frame = nullptr;
+	m_packet = nullptr;
+	m_outBuf = nullptr;
+	m_slot = nullptr;
 	m_streamIndex = 0;
 	m_opened = false;
 	m_done = false;
 	m_decodedSamples = 0;
 	m_convertedSamples = 0;
 	m_maxConvertedSamples = 0;
+	m_startPos = 0.0;
 	m_nextSeekTimestamp = 0;
 	m_skipSamples = 0;
+
+#ifdef MEASURE_CONVERSION_PERFORMANCE
+	std::fill(std::begin(m_convertTime), std::end(m_convertTime), 0.0);
+	std::fill(std::begin(m_convertSamples), std::end(m_convertSamples), 0);
+#endif
 }
 
 
 InputFileFFmpeg::~InputFileFFmpeg()
 {
 	closeNoLock();
-	av_freep(&m_outBuf);
 
 	av_channel_layout_uninit(&m_outputChannelLayout);
 }
 
 
-bool InputFileFFmpeg::openInternal(const char* filename, double startPosSeconds, double playTimeSeconds)
+int InputFileFFmpeg::readMapped(void* opaque, uint8_t* buf, int bufSize)
 {
-	if (checkFFmpegErr(avformat_open_input(&m_fmtCtx, filename, nullptr, nullptr), "Cannot open file") != 0)
+	InputFileFFmpeg* self = (InputFileFFmpeg*)opaque;
+	const MappedFile& file = *self->m_mappedFile;
+	int64_t remaining = file.size() - self->m_mappedPos;
+	if (remaining <= 0)
+		return AVERROR_EOF;
+
+	// The file may have been truncated since it was mapped
+	int count = (int)std::min((int64_t)bufSize, remaining);
+	if (!file.read(self->m_mappedPos, buf, count))
+		return AVERROR(EIO);
+	self->m_mappedPos += count;
+	return count;
+}
+
+
+int64_t InputFileFFmpeg::seekMapped(void* opaque, int64_t offset, int whence)
+{
+	InputFileFFmpeg* self = (InputFileFFmpeg*)opaque;
+	const MappedFile& file = *self->m_mappedFile;
+	int64_t pos;
+	switch (whence & ~AVSEEK_FORCE)
+	{
+	case AVSEEK_SIZE:
+		return file.size();
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = self->m_mappedPos + offset;
+		break;
+	case SEEK_END:
+		pos = file.size() + offset;
+		break;
+	default:
+		return AVERROR(EINVAL);
+	}
+
+	if (pos < 0 || pos > file.size())
+		return AVERROR(EINVAL);
+
+	// Jumping around (e.g. seeking to the crop start), make sure the new position is paged in
+	if (pos != self->m_mappedPos)
+		file.willNeed(pos, IO_BUFFER_SIZE * 4);
+	self->m_mappedPos = pos;
+	return pos;
+}
+
+
+// Set up a custom IO context that reads from a memory mapped view of the file instead of
+// going through FFmpegs file protocol. Returns false if the file can't be mapped.
+bool InputFileFFmpeg::openMappedIO(const char* filename)
+{
+	m_mappedFile = MappedFile::Open(filename);
+	if (!m_mappedFile)
 		return false;
 
-	if (checkFFmpegErr(avformat_find_stream_info(m_fmtCtx, nullptr), "Cannot find stream info") < 0)
+	uint8_t* ioBuffer = (uint8_t*)av_malloc(IO_BUFFER_SIZE);
+	if (ioBuffer)
+		m_ioCtx = avio_alloc_context(ioBuffer, IO_BUFFER_SIZE, 0, this, &readMapped, nullptr, &seekMapped);
+	m_fmtCtx = m_ioCtx ? avformat_alloc_context() : nullptr;
+	if (!m_fmtCtx)
+	{
+		if (m_ioCtx)
+			avio_context_free(&m_ioCtx);
+		av_free(ioBuffer);
+		m_mappedFile.reset();
 		return false;
+	}
 
-	m_streamIndex = getAudioStreamNum();
-	if (m_streamIndex < 0)
+	m_mappedPos = 0;
+	m_fmtCtx->pb = m_ioCtx;
+	m_fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+	return true;
+}
+
+
+bool InputFileFFmpeg::openInternal(const char* filename, double startPosSeconds, double playTimeSeconds)
+{
+#ifdef MEASURE_OPEN_PERFORMANCE
+	m_openTime = HighResClock::now();
+	m_firstSamplesLogged = false;
+#endif
+
+	m_filename = QString::fromUtf8(filename);
+
+	// Files that cannot be mapped (e.g. too big for the address space or on a network share) use FFmpegs own
+	// file IO
+	if (!openMappedIO(filename))
+		logDebug("Cannot map file %s, using buffered IO", filename);
+
+	// A file opened before doesn't need format probing or searching for stream info
+	OpenProfile profile;
+	int64_t fileSize = 0, fileMTime = 0;
+	const bool haveFileInfo = MappedFile::GetFileInfo(filename, fileSize, fileMTime);
+	bool haveProfile = haveFileInfo && g_openProfiles.get(filename, fileSize, fileMTime, profile);
+
+	if (checkFFmpegErr(
+			avformat_open_input(&m_fmtCtx, filename, haveProfile ? profile.format : nullptr, nullptr),
+			"Cannot open file"
+		) != 0)
 	{
-		logError("Cannot find a suitable stream");
+		if (haveProfile)
+			avcodec_parameters_free(&profile.codecParams);
 		return false;
 	}
 
+	if (haveProfile)
+	{
+		haveProfile = openFromProfile(profile);
+		avcodec_parameters_free(&profile.codecParams);
+	}
+
+	if (!haveProfile)
+	{
+		// Streams of formats without header are only discovered while reading packets, that can't be cached
+		const bool cacheable = haveFileInfo && (m_fmtCtx->ctx_flags & AVFMTCTX_NOHEADER) == 0;
+		const unsigned int headerStreams = m_fmtCtx->nb_streams;
+
+		if (hasDescriptiveHeader(m_fmtCtx->iformat))
+		{
+			m_fmtCtx->probesize = FAST_PROBE_SIZE;
+			m_fmtCtx->max_analyze_duration = FAST_ANALYZE_DURATION;
+		}
+
+		if (checkFFmpegErr(avformat_find_stream_info(m_fmtCtx, nullptr), "Cannot find stream info") < 0)
+			return false;
+
+		m_streamIndex = getAudioStreamNum();
+		if (m_streamIndex < 0)
+		{
+			logError("Cannot find a suitable stream");
+			return false;
+		}
+
+		if (cacheable && m_fmtCtx->nb_streams == headerStreams)
+			storeProfile(filename, fileSize, fileMTime);
+	}
+
+	// Let the demuxer drop packets of all other streams instead of handing them to readSamples
+	for (unsigned int i = 0; i < m_fmtCtx->nb_streams; i++)
+	{
+		if ((int)i != m_streamIndex)
+			m_fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+	}
+
 	AVCodecParameters* codecParams = m_fmtCtx->streams[m_streamIndex]->codecpar;
+	AVRational timeBase = m_fmtCtx->streams[m_streamIndex]->time_base;
+
+	// Mono stays mono, the mix kernel spreads it to the output channels
+	if (m_inputFileOptions.outputChannelLayout == InputFileOptions::NATIVE)
+		setOutputChannels(codecParams->ch_layout.nb_channels == 1 ? 1 : 2);
+
+	// A decoder of a previously played file with the same format can be used as is
+	DecoderKey key(codecParams, timeBase.num, timeBase.den, m_outputChannels, m_outputSamplerate);
+	if (m_inputFileOptions.pooledDecoder)
+		m_slot = DecoderPool::GetInstance().acquire(key);
+	const bool pooled = m_slot != nullptr;
+	if (pooled)
+	{
+		m_codecCtx = m_slot->codecCtx;
+		m_swrCtx = m_slot->swrCtx;
+		m_frame = m_slot->frame;
+		m_packet = m_slot->packet;
+		m_outBuf = m_slot->outBuf;
+
+		// Drop samples the resampler still buffers from the last file
+		if (m_swrCtx && checkFFmpegErr(swr_init(m_swrCtx), "Cannot initialize resample context") < 0)
+			return false;
+	}
+	else if (!openDecoder(key, codecParams, timeBase))
+		return false;
+
+	convert_path_e convertPath =
+		getConvertPath(m_codecCtx->sample_fmt, m_codecCtx->sample_rate, m_codecCtx->ch_layout.nb_channels);
+
+	if (!m_inputFileOptions.quiet)
+		logInfo(
+			"Opened file: %s; Codec: %s, Channels: %i, Rate: %i, Format: %s, Timebase: %i/%i, Sample-Estimation: %lld, "
+			"Resampling: %s, Pooled decoder: %s",
+			filename, m_codecCtx->codec->long_name, m_codecCtx->ch_layout.nb_channels, m_codecCtx->sample_rate,
+			av_get_sample_fmt_name(m_codecCtx->sample_fmt), m_codecCtx->time_base.num, m_codecCtx->time_base.den,
+			outputSamplesEstimation(), convertPath == eCONVERT_RESAMPLE ? "yes" : "no", pooled ? "yes" : "no"
+		);
+
+#ifdef MEASURE_OPEN_PERFORMANCE
+	std::chrono::duration<double> openElapsed = HighResClock::now() - m_openTime;
+	logInfo(
+		"Opened %s container in %f ms (%s)", m_fmtCtx->iformat->name, openElapsed.count() * 1000.0,
+		haveProfile ? "cached profile" : "probed"
+	);
+#endif
+
+	m_opened = true;
+
+	m_startPos = std::max(startPosSeconds, 0.0);
+	if (startPosSeconds > 0.0)
+		seekNoLock(startPosSeconds);
+
+	// The crop range may reach past the end of the file, clamp it if the exact length is known
+	MediaInfo info;
+	if (playTimeSeconds > 0.0 && MediaInfoCache::GetInstance().get(m_filename, info) && info.exact)
+		playTimeSeconds = std::max(std::min(playTimeSeconds, info.duration() - m_startPos), 0.0);
+	if (playTimeSeconds > 0.0)
+		m_maxConvertedSamples = uint64_t(playTimeSeconds * (double)m_outputSamplerate + 0.5);
+
+	return true;
+}
+
+
+bool InputFileFFmpeg::openFromProfile(const OpenProfile& profile)
+{
+	// The header must still yield the streams we saw last time
+	if (m_fmtCtx->nb_streams != profile.numStreams || (m_fmtCtx->ctx_flags & AVFMTCTX_NOHEADER) != 0)
+		return false;
+
+	AVStream* stream = m_fmtCtx->streams[profile.streamIndex];
+	if (stream->codecpar->codec_id != profile.codecParams->codec_id ||
+		av_cmp_q(stream->time_base, profile.timeBase) != 0)
+		return false;
+
+	// Fill in what avformat_find_stream_info found out by decoding the first frames
+	if (avcodec_parameters_copy(stream->codecpar, profile.codecParams) < 0)
+		return false;
+	if (stream->duration <= 0)
+		stream->duration = profile.streamDuration;
+	if (m_fmtCtx->duration <= 0)
+		m_fmtCtx->duration = profile.duration;
+
+	m_streamIndex = profile.streamIndex;
+	return true;
+}
+
+
+void InputFileFFmpeg::storeProfile(const char* filename, int64_t fileSize, int64_t fileMTime)
+{
+	const AVStream* stream = m_fmtCtx->streams[m_streamIndex];
+
+	OpenProfile profile;
+	profile.fileSize = fileSize;
+	profile.fileMTime = fileMTime;
+	profile.format = m_fmtCtx->iformat;
+	profile.numStreams = m_fmtCtx->nb_streams;
+	profile.streamIndex = m_streamIndex;
+	profile.timeBase = stream->time_base;
+	profile.streamDuration = stream->duration;
+	profile.duration = m_fmtCtx->duration;
+	profile.codecParams = avcodec_parameters_alloc();
+	if (!profile.codecParams || avcodec_parameters_copy(profile.codecParams, stream->codecpar) < 0)
+	{
+		avcodec_parameters_free(&profile.codecParams);
+		return;
+	}
+
+	g_openProfiles.put(filename, profile);
+}
+
+
+bool InputFileFFmpeg::openDecoder(const DecoderKey& key, const AVCodecParameters* codecParams, AVRational timeBase)
+{
+	m_slot = new DecoderSlot(key);
 
 	// 2. Find the appropriate decoder
 	const AVCodec* decoder = avcodec_find_decoder(codecParams->codec_id);
@@ -181,20 +613,56 @@ bool InputFileFFmpeg::openInternal(const char* filename, double startPosSeconds,
 
 	// Decoder needs to know the timebase to calculate correct timestamps during decoding,
 	// but it's not always set by the demuxer, so set it manually from the stream info
-	m_codecCtx->pkt_timebase = m_fmtCtx->streams[m_streamIndex]->time_base;
+	m_codecCtx->pkt_timebase = timeBase;
 
 	if (checkFFmpegErr(avcodec_open2(m_codecCtx, decoder, nullptr), "Cannot open codec") < 0)
 		return false; // Cannot open codec
 
-	// Open Resample context
+	// The resampler is only needed if the decoded format can't be converted directly
+	convert_path_e convertPath =
+		getConvertPath(m_codecCtx->sample_fmt, m_codecCtx->sample_rate, m_codecCtx->ch_layout.nb_channels);
+	if (convertPath == eCONVERT_RESAMPLE &&
+		!initResampler(&m_codecCtx->ch_layout, m_codecCtx->sample_fmt, m_codecCtx->sample_rate))
+		return false;
+
+	m_frame = av_frame_alloc();
+	m_packet = av_packet_alloc();
+	if (!m_frame || !m_packet)
+	{
+		logError("Failed to allocate frame or packet");
+		return false;
+	}
+
+	if (av_samples_alloc(&m_outBuf, nullptr, m_outputChannels, OUTPUT_BUFFER_COUNT, OUTPUT_FORMAT, 0) < 0)
+	{
+		logError("Failed to allocate output buffer");
+		return false;
+	}
+
+	return true;
+}
+
+
+void InputFileFFmpeg::setOutputChannels(int channels)
+{
+	if (channels == m_outputChannels)
+		return;
+	m_outputChannels = channels;
+	av_channel_layout_uninit(&m_outputChannelLayout);
+	av_channel_layout_from_mask(&m_outputChannelLayout, channels == 1 ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO);
+}
+
+
+bool InputFileFFmpeg::initResampler(const AVChannelLayout* inLayout, AVSampleFormat inFormat, int inSampleRate)
+{
 	int result = swr_alloc_set_opts2(
 		&m_swrCtx,
-		&m_outputChannelLayout, // Output layout (stereo)
+		&m_outputChannelLayout, // Output layout (mono or stereo)
 		OUTPUT_FORMAT, // Output format (signed 16bit int)
 		m_outputSamplerate, // Output Sample Rate
-		&m_codecCtx->ch_layout, // Input layout
-		m_codecCtx->sample_fmt, // Input format
-		m_codecCtx->sample_rate, // Input Sample Rate
+		inLayout, // Input layout
+		inFormat, // Input format
+		inSampleRate, // Input Sample Rate
 		0, nullptr
 	);
 
@@ -211,32 +679,33 @@ bool InputFileFFmpeg::openInternal(const char* filename, double startPosSeconds,
 	}
 
 	if (checkFFmpegErr(swr_init(m_swrCtx), "Cannot initialize resample context") < 0)
-		return false;
-
-	logInfo(
-		"Opened file: %s; Codec: %s, Channels: %i, Rate: %i, Format: %s, Timebase: %i/%i, Sample-Estimation: %lld",
-		filename, m_codecCtx->codec->long_name, m_codecCtx->ch_layout.nb_channels, m_codecCtx->sample_rate,
-		av_get_sample_fmt_name(m_codecCtx->sample_fmt), m_codecCtx->time_base.num, m_codecCtx->time_base.den,
-		outputSamplesEstimation()
-	);
-
-	m_frame = av_frame_alloc();
-	m_packet = av_packet_alloc();
-	if (!m_frame || !m_packet)
 	{
-		logError("Failed to allocate frame or packet");
+		swr_free(&m_swrCtx);
 		return false;
 	}
 
-	m_opened = true;
+	return true;
+}
 
-	if (startPosSeconds > 0.0)
-		seekNoLock(startPosSeconds);
 
-	if (playTimeSeconds > 0.0)
-		m_maxConvertedSamples = uint64_t(playTimeSeconds * (double)m_outputSamplerate + 0.5);
+InputFileFFmpeg::convert_path_e InputFileFFmpeg::getConvertPath(int format, int sampleRate, int channels) const
+{
+	if (sampleRate != m_outputSamplerate || channels != m_outputChannels)
+		return eCONVERT_RESAMPLE;
 
-	return true;
+	switch (format)
+	{
+	case AV_SAMPLE_FMT_S16:
+		return eCONVERT_PASSTHROUGH;
+	case AV_SAMPLE_FMT_S16P:
+		return channels == 1 ? eCONVERT_PASSTHROUGH : eCONVERT_S16P;
+	case AV_SAMPLE_FMT_FLT:
+		return eCONVERT_FLT;
+	case AV_SAMPLE_FMT_FLTP:
+		return channels == 1 ? eCONVERT_FLT : eCONVERT_FLTP;
+	default:
+		return eCONVERT_RESAMPLE;
+	}
 }
 
 
@@ -244,11 +713,9 @@ int InputFileFFmpeg::open(const char* filename, double startPosSeconds /*= 0.0*/
 {
 	Lock lock(m_mutex);
 
-	if (m_opened)
-	{
-		closeNoLock();
-		reset();
-	}
+	// Instances are reused after close(), so always start from a clean state
+	closeNoLock();
+	reset();
 
 	if (!openInternal(filename, startPosSeconds, playTimeSeconds))
 	{
@@ -267,6 +734,10 @@ int InputFileFFmpeg::seekNoLock(double seconds)
 	if (checkFFmpegErr(avformat_seek_file(m_fmtCtx, m_streamIndex, INT64_MIN, ts, ts, 0), "Seeking failed") < 0)
 		return -1;
 	avcodec_flush_buffers(m_codecCtx);
+
+	// Drop the samples the resampler still buffers from before the seek
+	if (m_swrCtx && checkFFmpegErr(swr_init(m_swrCtx), "Cannot initialize resample context") < 0)
+		return -1;
 	m_nextSeekTimestamp = ts;
 	return 0;
 }
@@ -278,7 +749,14 @@ int InputFileFFmpeg::seek(double seconds)
 	if (!m_opened)
 		return -1;
 
-	return seekNoLock(seconds);
+	// Continue within the crop, possibly after the decoder was flushed at the end of the file
+	seconds = std::max(seconds, 0.0);
+	if (seekNoLock(m_startPos + seconds) != 0)
+		return -1;
+	m_skipSamples = 0;
+	m_convertedSamples = (int64_t)(seconds * m_outputSamplerate + 0.5);
+	m_done = m_maxConvertedSamples > 0 && m_convertedSamples >= m_maxConvertedSamples;
+	return 0;
 }
 
 
@@ -314,38 +792,153 @@ int InputFileFFmpeg::handleDecoded(AVFrame* frame, SampleProducer* sb)
 		m_nextSeekTimestamp = 0;
 	}
 
-	int res;
+#ifdef MEASURE_CONVERSION_PERFORMANCE
+	std::chrono::time_point<HighResClock> start = HighResClock::now();
+#endif
+
+	convert_path_e path = eCONVERT_RESAMPLE;
+	if (frame)
+	{
+		int rate = frame->sample_rate > 0 ? frame->sample_rate : m_codecCtx->sample_rate;
+		path = getConvertPath(frame->format, rate, frame->ch_layout.nb_channels);
+		if (path == eCONVERT_RESAMPLE && !m_swrCtx &&
+			!initResampler(&frame->ch_layout, (AVSampleFormat)frame->format, rate))
+			return AVERROR(EINVAL);
+	}
+
 	int generatedSamples = 0;
-	do
+	if (path != eCONVERT_RESAMPLE)
+		generatedSamples = convertDirect(frame, path, sb);
+	else if (m_swrCtx) // Nothing to flush if we never needed to resample
 	{
-		res = swr_convert(
-			m_swrCtx, &m_outBuf, OUTPUT_BUFFER_COUNT, frame ? (const uint8_t**)frame->extended_data : nullptr,
-			frame ? frame->nb_samples : 0
-		);
-		if (res < 0)
-			return res;
-		int64_t outSamples = std::max(int64_t(0), res - m_skipSamples);
-		int64_t skippedSamples = res - outSamples;
-		if (m_maxConvertedSamples > 0 && outSamples > (m_maxConvertedSamples - m_convertedSamples))
+		int res;
+		do
 		{
-			outSamples = m_maxConvertedSamples - m_convertedSamples;
-			m_done = true;
-		}
-		if (outSamples > 0)
-			sb->produce(((int16_t*)m_outBuf) + (skippedSamples * m_outputChannels), outSamples);
+			uint8_t* out = (uint8_t*)reserveOutput(sb, OUTPUT_BUFFER_COUNT);
+			res = swr_convert(
+				m_swrCtx, &out, OUTPUT_BUFFER_COUNT, frame ? (const uint8_t**)frame->extended_data : nullptr,
+				frame ? frame->nb_samples : 0
+			);
+			generatedSamples += commitOutput((const int16_t*)out, std::max(res, 0), sb);
+			if (res < 0)
+				return res;
+			frame = nullptr; // Only use the frame for the first conversion, then pass NULL to flush the resampler
+		} while (
+			!m_done && res == OUTPUT_BUFFER_COUNT
+		); // If we filled the whole output buffer, there might be more data to convert, so try again immediately
+	}
+
+#ifdef MEASURE_CONVERSION_PERFORMANCE
+	std::chrono::duration<double> elapsed = HighResClock::now() - start;
+	m_convertTime[path] += elapsed.count();
+	m_convertSamples[path] += generatedSamples;
+#endif
+
+	return generatedSamples;
+}
 
-		m_skipSamples -= skippedSamples;
-		m_convertedSamples += outSamples;
-		generatedSamples += outSamples;
-		frame = nullptr; // Only use the frame for the first conversion, then pass NULL to flush the resampler
-	} while (
-		!m_done && res == OUTPUT_BUFFER_COUNT
-	); // If we filled the whole output buffer, there might be more data to convert, so try again immediately
+
+// Convert a frame that already has the output rate and channel count without the resampler
+int InputFileFFmpeg::convertDirect(AVFrame* frame, convert_path_e path, SampleProducer* sb)
+{
+	if (path == eCONVERT_PASSTHROUGH)
+		return commitOutput((const int16_t*)frame->extended_data[0], frame->nb_samples, sb);
+
+	// Same rounding and clipping as swresample, so the output doesn't depend on the path taken
+	auto floatToS16 = [](float f) -> int16_t { return (int16_t)av_clip_int16((int)lrintf(f * (1 << 15))); };
+
+	const int channels = m_outputChannels;
+	int generatedSamples = 0;
+	for (int offset = 0; offset < frame->nb_samples && !m_done; offset += OUTPUT_BUFFER_COUNT)
+	{
+		const int count = std::min(frame->nb_samples - offset, OUTPUT_BUFFER_COUNT);
+		int16_t* out = reserveOutput(sb, count);
+		switch (path)
+		{
+		case eCONVERT_S16P:
+			for (int c = 0; c < channels; c++)
+			{
+				const int16_t* in = (const int16_t*)frame->extended_data[c] + offset;
+				for (int i = 0; i < count; i++)
+					out[i * channels + c] = in[i];
+			}
+			break;
+		case eCONVERT_FLT:
+		{
+			const float* in = (const float*)frame->extended_data[0] + offset * channels;
+			for (int i = 0; i < count * channels; i++)
+				out[i] = floatToS16(in[i]);
+			break;
+		}
+		case eCONVERT_FLTP:
+			for (int c = 0; c < channels; c++)
+			{
+				const float* in = (const float*)frame->extended_data[c] + offset;
+				for (int i = 0; i < count; i++)
+					out[i * channels + c] = floatToS16(in[i]);
+			}
+			break;
+		default:
+			assert(false && "Unhandled conversion path");
+			commitOutput(out, 0, sb);
+			return 0;
+		}
+		generatedSamples += commitOutput(out, count, sb);
+	}
 
 	return generatedSamples;
 }
 
 
+// Get memory to convert count samples into. This is the consumers buffer itself if it has enough
+// free space, so converted samples don't need to be copied again. Must be followed by commitOutput.
+int16_t* InputFileFFmpeg::reserveOutput(SampleProducer* sb, int count)
+{
+	// Samples that are skipped after seeking must not end up in the consumer, so convert those into m_outBuf
+	if (m_skipSamples == 0)
+	{
+		short* samples = nullptr;
+		if (sb->reserve(&samples, count) == count)
+		{
+			m_outputReserved = true;
+			return samples;
+		}
+		sb->commit(0);
+	}
+
+	m_outputReserved = false;
+	return (int16_t*)m_outBuf;
+}
+
+
+// Pass converted samples to the producer, honoring pending skips after seeking and the maximum play time.
+// samples is either the region returned by reserveOutput or any other memory (e.g. passthrough frame data).
+// Returns the number of samples actually produced.
+int InputFileFFmpeg::commitOutput(const int16_t* samples, int count, SampleProducer* sb)
+{
+	int64_t outSamples = std::max(int64_t(0), count - m_skipSamples);
+	int64_t skippedSamples = count - outSamples;
+	if (m_maxConvertedSamples > 0 && outSamples > (m_maxConvertedSamples - m_convertedSamples))
+	{
+		outSamples = m_maxConvertedSamples - m_convertedSamples;
+		m_done = true;
+	}
+
+	if (m_outputReserved)
+	{
+		assert(skippedSamples == 0);
+		sb->commit((int)outSamples);
+		m_outputReserved = false;
+	}
+	else if (outSamples > 0)
+		sb->produce(samples + (skippedSamples * m_outputChannels), (int)outSamples);
+
+	m_skipSamples -= skippedSamples;
+	m_convertedSamples += outSamples;
+	return (int)outSamples;
+}
+
+
 // Returns the number of generated samples, or a negative error code
 int InputFileFFmpeg::receiveSamples(SampleProducer* sampleBuffer, int& producedSamples)
 {
@@ -384,6 +977,10 @@ int InputFileFFmpeg::readSamples(SampleProducer* sampleBuffer)
 	if (!m_opened)
 		return -1;
 
+#ifdef MEASURE_OPEN_PERFORMANCE
+	const bool wasDone = m_done;
+#endif
+
 	int written = 0; // samples read
 	while (!m_done && written == 0)
 	{
@@ -441,6 +1038,20 @@ int InputFileFFmpeg::readSamples(SampleProducer* sampleBuffer)
 		}
 	}
 
+#ifdef MEASURE_OPEN_PERFORMANCE
+	std::chrono::duration<double> elapsed = HighResClock::now() - m_openTime;
+	if (written > 0 && !m_firstSamplesLogged)
+	{
+		logInfo("Open to first samples: %f ms (%s)", elapsed.count() * 1000.0, m_ioCtx ? "mapped" : "buffered");
+		m_firstSamplesLogged = true;
+	}
+	if (m_done && !wasDone)
+		logInfo(
+			"Decoded %lld samples in %f ms (%s)", m_convertedSamples, elapsed.count() * 1000.0,
+			m_ioCtx ? "mapped" : "buffered"
+		);
+#endif
+
 	return written;
 }
 
@@ -459,21 +1070,53 @@ int InputFileFFmpeg::getAudioStreamNum() const
 
 int InputFileFFmpeg::closeNoLock()
 {
-	if (m_frame)
-		av_frame_free(&m_frame);
-
-	if (m_packet)
-		av_packet_free(&m_packet);
-
-	if (m_swrCtx)
-		swr_free(&m_swrCtx);
+#ifdef MEASURE_CONVERSION_PERFORMANCE
+	static const char* const pathNames[eCONVERT_COUNT] = {"resample", "passthrough", "s16p", "flt", "fltp"};
+	for (int i = 0; i < eCONVERT_COUNT; i++)
+	{
+		if (m_convertSamples[i] > 0)
+			logInfo(
+				"Conversion path %s: %f ms CPU per minute of audio", pathNames[i],
+				m_convertTime[i] * 1000.0 * (60.0 * m_outputSamplerate / (double)m_convertSamples[i])
+			);
+		m_convertTime[i] = 0.0;
+		m_convertSamples[i] = 0;
+	}
+#endif
 
-	if (m_codecCtx)
-		avcodec_free_context(&m_codecCtx);
+	if (m_slot)
+	{
+		// The resampler may have been created while decoding, the slot owns everything from now on
+		m_slot->codecCtx = m_codecCtx;
+		m_slot->swrCtx = m_swrCtx;
+		m_slot->frame = m_frame;
+		m_slot->packet = m_packet;
+		m_slot->outBuf = m_outBuf;
+
+		// Only keep decoders that were opened completely and meant for the pool
+		if (m_opened && m_inputFileOptions.pooledDecoder)
+			DecoderPool::GetInstance().release(m_slot);
+		else
+			delete m_slot;
+	}
+	m_slot = nullptr;
+	m_codecCtx = nullptr;
+	m_swrCtx = nullptr;
+	m_frame = nullptr;
+	m_packet = nullptr;
+	m_outBuf = nullptr;
 
 	if (m_fmtCtx)
 		avformat_close_input(&m_fmtCtx);
 
+	// Custom IO contexts are not freed by avformat_close_input
+	if (m_ioCtx)
+	{
+		av_freep(&m_ioCtx->buffer);
+		avio_context_free(&m_ioCtx);
+	}
+	m_mappedFile.reset();
+
 	m_opened = false;
 
 	return 0;
@@ -482,6 +1125,11 @@ int InputFileFFmpeg::closeNoLock()
 
 int64_t InputFileFFmpeg::outputSamplesEstimation() const
 {
+	// Container durations are often estimated, prefer the exact length if the file was counted before
+	MediaInfo info;
+	if (MediaInfoCache::GetInstance().get(m_filename, info) && info.exact && info.numSamples > 0)
+		return (int64_t)(info.duration() * m_outputSamplerate + 0.5);
+
 	AVStream* stream = m_fmtCtx->streams[m_streamIndex];
 	if (stream->duration > 0)
 		return stream->duration * (int64_t)stream->time_base.num * (int64_t)m_outputSamplerate /
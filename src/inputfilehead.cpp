@@ -0,0 +1,518 @@
+// src/inputfilehead.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ts3log.h"
+#include "inputfile.h"
+#include "HeadCache.h"
+#include "SampleProducer.h"
+#include "StreamItem.h"
+
+// Number of samples of the head handed to the producer per readSamples call
+#define HEAD_READ_CHUNK 8192
+
+
+namespace
+{
+// Hands out the samples of a head in pieces. Compressed heads are inflated one chunk at a time, only
+// when the chunk is about to be produced.
+class HeadReader
+{
+  public:
+	HeadReader() :
+		m_head(nullptr),
+		m_chunk(-1),
+		m_frames(0)
+	{
+	}
+
+	void reset(const HeadCache::head_t* head)
+	{
+		m_head = head;
+		m_chunk = -1;
+		if (head && head->isPacked())
+			m_inflated.resize((size_t)PCM_CHUNK_FRAMES * head->channels);
+	}
+
+	// Frames from frame on up to the end of the piece that contains it, returns their number
+	int get(int frame, const short** samples)
+	{
+		if (!m_head->isPacked())
+		{
+			*samples = m_head->samples.data() + (size_t)frame * m_head->channels;
+			return m_head->frames - frame;
+		}
+
+		const int chunk = frame / PCM_CHUNK_FRAMES;
+		if (chunk != m_chunk)
+		{
+			m_frames = m_head->packed.decodeChunk(chunk, m_inflated.data());
+			m_chunk = chunk;
+		}
+		const int offset = frame - chunk * PCM_CHUNK_FRAMES;
+		*samples = m_inflated.data() + (size_t)offset * m_head->channels;
+		return m_frames - offset;
+	}
+
+  private:
+	const HeadCache::head_t* m_head;
+	std::vector<short> m_inflated; // The chunk m_chunk of a compressed head
+	int m_chunk;
+	int m_frames; // Frames in m_inflated
+};
+
+
+// Passes the decoder's output on to the producer, minus the part the head already played.
+// The skipped samples are checked against the head, they have to be identical for the join to be seamless.
+class HandoffProducer : public SampleProducer
+{
+  public:
+	HandoffProducer(
+		SampleProducer* target, const HeadCache::head_t& head, HeadReader& reader, int& skip, bool& mismatch
+	) :
+		m_target(target),
+		m_head(head),
+		m_reader(reader),
+		m_channels(head.channels),
+		m_skip(skip),
+		m_mismatch(mismatch),
+		m_scratching(false),
+		m_forwarded(0)
+	{
+	}
+
+	void produce(const short* samples, int count) override
+	{
+		const int skipped = skip(samples, count);
+		if (count > skipped)
+		{
+			m_target->produce(samples + skipped * m_channels, count - skipped);
+			m_forwarded += count - skipped;
+		}
+	}
+
+	int reserve(short** samples, int maxCount) override
+	{
+		// Samples to skip are decoded into scratch memory, the producer only sees what remains
+		m_scratching = m_skip > 0;
+		if (!m_scratching)
+			return m_target->reserve(samples, maxCount);
+		m_scratch.resize((size_t)maxCount * m_channels);
+		*samples = m_scratch.data();
+		return maxCount;
+	}
+
+	void commit(int count) override
+	{
+		if (m_scratching)
+			produce(m_scratch.data(), count);
+		else
+		{
+			m_target->commit(count);
+			m_forwarded += count;
+		}
+		m_scratching = false;
+	}
+
+	inline int forwarded() const
+	{
+		return m_forwarded;
+	}
+
+  private:
+	// Drop up to count samples still covered by the head, returns how many were dropped
+	int skip(const short* samples, int count)
+	{
+		const int n = std::min(count, m_skip);
+		for (int done = 0; done < n && !m_mismatch;)
+		{
+			const short* expected;
+			const int piece = std::min(m_reader.get(m_head.frames - m_skip + done, &expected), n - done);
+			const size_t size = (size_t)piece * m_channels * sizeof(short);
+			m_mismatch = memcmp(samples + (size_t)done * m_channels, expected, size) != 0;
+			done += piece;
+		}
+		m_skip -= n;
+		return n;
+	}
+
+  private:
+	SampleProducer* const m_target;
+	const HeadCache::head_t& m_head;
+	HeadReader& m_reader;
+	const int m_channels;
+	int& m_skip;
+	bool& m_mismatch;
+	bool m_scratching;
+	std::vector<short> m_scratch;
+	int m_forwarded;
+};
+} // namespace
+
+
+// Plays a sound from its head in the HeadCache first, so playback starts without waiting for FFmpeg.
+// Meanwhile a worker thread opens the decoder with the same crop and decodes the head again, dropping
+// those samples and keeping what it decodes beyond the head. Seeking the decoder straight to the end
+// of the head would not be sample accurate for most formats, decoding the head again is.
+// Without a head for the file, it is played by its usual backend.
+class InputFileHead : public InputFile
+{
+  public:
+	InputFileHead(const InputFileOptions& options);
+	~InputFileHead();
+	int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) override;
+	int close() override;
+	backend_e backend() const override
+	{
+		return eBACKEND_HEAD;
+	}
+
+	int readSamples(SampleProducer* sampleBuffer) override;
+	bool done() const override;
+	int seek(double seconds) override;
+	int64_t outputSamplesEstimation() const override;
+	int channels() const override;
+
+  private:
+	int closeNoLock();
+	int openDecoder();
+	int openInner();
+	void startOpener();
+	void runOpener();
+	bool waitForOpener();
+	void stopOpener();
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	const InputFileOptions m_inputFileOptions;
+	std::shared_ptr<const HeadCache::head_t> m_head;
+	HeadReader m_reader;
+	std::unique_ptr<InputFile> m_inner; // Kept between sounds, like the files of the pool
+	bool m_innerOpen;
+	std::string m_filename;
+	double m_startTime;
+	double m_playTime;
+	int m_headPos; // Frames of the head handed out
+	std::atomic<bool> m_done;
+	mutable std::mutex m_mutex; // Held by the producer thread while reading
+
+	// While the opener runs it owns m_inner and the members below, afterwards the producer does
+	std::thread m_opener;
+	std::mutex m_openerMutex;
+	std::condition_variable m_openerCond;
+	bool m_openerDone; // With m_openerMutex
+	int m_openerResult;
+	std::atomic<bool> m_stopOpener;
+	int m_skip; // Frames the decoder still has to drop
+	bool m_mismatch;
+	std::vector<short> m_ahead; // Decoded behind the head before it was played out
+	size_t m_aheadPos; // Start of the samples in m_ahead not handed out yet
+};
+
+
+InputFileHead::InputFileHead(const InputFileOptions& options) :
+	m_inputFileOptions(options),
+	m_innerOpen(false),
+	m_startTime(0.0),
+	m_playTime(-1.0),
+	m_headPos(0),
+	m_done(false),
+	m_openerDone(false),
+	m_openerResult(0),
+	m_stopOpener(false),
+	m_skip(0),
+	m_mismatch(false),
+	m_aheadPos(0)
+{
+}
+
+
+InputFileHead::~InputFileHead()
+{
+	closeNoLock();
+}
+
+
+int InputFileHead::open(const char* filename, double startPosSeconds /*= 0.0*/, double playTimeSeconds /*= -1.0*/)
+{
+	Lock lock(m_mutex);
+	closeNoLock();
+
+	m_filename = filename;
+	m_startTime = startPosSeconds;
+	m_playTime = playTimeSeconds;
+	m_head = HeadCache::GetInstance().find(m_filename, startPosSeconds, playTimeSeconds);
+	if (!m_head)
+		return openInner();
+	m_reader.reset(m_head.get());
+
+	m_done = m_head->complete && m_head->frames == 0;
+	startOpener();
+	return 0;
+}
+
+
+// Open m_inner with the crop of the sound, returns 0 if it is open with the channels of the head
+int InputFileHead::openDecoder()
+{
+	const backend_e backend = ChooseInputFileBackend(m_filename.c_str(), m_inputFileOptions);
+	if (!m_inner || m_inner->backend() != backend)
+		m_inner.reset(CreateInputFile(backend, m_inputFileOptions));
+
+	if (m_inner->open(m_filename.c_str(), m_startTime, m_playTime) != 0)
+		return -1;
+	if (m_head && m_inner->channels() != m_head->channels)
+	{
+		logError("%s is decoded with other channels than its head", m_filename.c_str());
+		m_inner->close();
+		return -1;
+	}
+	return 0;
+}
+
+
+// Open the decoder on the calling thread, to play the sound by it alone
+int InputFileHead::openInner()
+{
+	if (openDecoder() != 0)
+		return -1;
+	m_innerOpen = true;
+	m_skip = 0;
+	m_done = m_inner->done();
+	return 0;
+}
+
+
+// Open the decoder behind the head in the background, unless the head holds the whole sound
+void InputFileHead::startOpener()
+{
+	if (m_head->complete)
+		return;
+	m_openerDone = false;
+	m_openerResult = -1;
+	m_skip = m_head->frames;
+	m_mismatch = false;
+	m_ahead.clear();
+	m_aheadPos = 0;
+	m_opener = std::thread(&InputFileHead::runOpener, this);
+}
+
+
+void InputFileHead::runOpener()
+{
+	int result = openDecoder();
+	if (result == 0)
+	{
+		// Decode the head again to get to its end sample accurately, what comes behind it is kept
+		HeadReader reader;
+		reader.reset(m_head.get());
+		std::vector<short> scratch;
+		ItemCollector collector(m_ahead, scratch, m_head->channels, m_head->channels, 1.0f);
+		HandoffProducer handoff(&collector, *m_head, reader, m_skip, m_mismatch);
+		while (m_skip > 0 && !m_inner->done() && !m_stopOpener && result == 0)
+		{
+			if (m_inner->readSamples(&handoff) < 0)
+				result = -1;
+		}
+
+		if (m_stopOpener || result != 0)
+		{
+			m_inner->close();
+			result = -1;
+		}
+		else if (m_mismatch)
+			logWarning("Decoder output of %s differs from its head, the join may be audible", m_filename.c_str());
+		else if (m_skip > 0)
+			logWarning("%s ended before its head", m_filename.c_str());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_openerMutex);
+		m_openerResult = result;
+		m_openerDone = true;
+	}
+	m_openerCond.notify_all();
+}
+
+
+// Take over the decoder from the opener, returns false if it could not be opened.
+// Only waits if the head was played out faster than the decoder opened.
+bool InputFileHead::waitForOpener()
+{
+	if (!m_opener.joinable())
+		return false;
+	{
+		std::unique_lock<std::mutex> lock(m_openerMutex);
+		m_openerCond.wait(lock, [this] { return m_openerDone; });
+	}
+	m_opener.join();
+	m_innerOpen = m_openerResult == 0;
+	return m_innerOpen;
+}
+
+
+// Cancel the opener and take over what it left, the decoder is closed if it didn't get past the head
+void InputFileHead::stopOpener()
+{
+	if (!m_opener.joinable())
+		return;
+	m_stopOpener = true;
+	waitForOpener();
+	m_stopOpener = false;
+}
+
+
+int InputFileHead::close()
+{
+	Lock lock(m_mutex);
+	return closeNoLock();
+}
+
+
+int InputFileHead::closeNoLock()
+{
+	stopOpener();
+	if (m_inner && m_innerOpen)
+		m_inner->close();
+	m_innerOpen = false;
+	m_reader.reset(nullptr);
+	m_head.reset();
+	m_headPos = 0;
+	m_skip = 0;
+	m_mismatch = false;
+	m_ahead.clear();
+	m_aheadPos = 0;
+	m_done = false;
+	return 0;
+}
+
+
+int InputFileHead::readSamples(SampleProducer* sampleBuffer)
+{
+	Lock lock(m_mutex);
+
+	if (m_head && m_headPos < m_head->frames)
+	{
+		const short* samples;
+		const int count = std::min(m_reader.get(m_headPos, &samples), HEAD_READ_CHUNK);
+		sampleBuffer->produce(samples, count);
+		m_headPos += count;
+		if (m_headPos >= m_head->frames && m_head->complete)
+			m_done = true;
+		return count;
+	}
+
+	if (m_head && m_head->complete)
+	{
+		m_done = true;
+		return 0;
+	}
+
+	// The head is out, the decoder was opened behind it meanwhile
+	if (!m_innerOpen && !waitForOpener())
+	{
+		logError("Cannot continue %s behind its head", m_filename.c_str());
+		m_done = true;
+		return -1;
+	}
+
+	// What the opener decoded behind the head comes first
+	const int channels = m_head ? m_head->channels : m_inner->channels();
+	if (m_aheadPos < m_ahead.size())
+	{
+		const int count = std::min((int)((m_ahead.size() - m_aheadPos) / channels), HEAD_READ_CHUNK);
+		sampleBuffer->produce(m_ahead.data() + m_aheadPos, count);
+		m_aheadPos += (size_t)count * channels;
+		m_done = m_aheadPos >= m_ahead.size() && m_inner->done();
+		return count;
+	}
+
+	const int count = m_inner->readSamples(sampleBuffer);
+	m_done = m_inner->done();
+	return count;
+}
+
+
+bool InputFileHead::done() const
+{
+	return m_done;
+}
+
+
+int InputFileHead::seek(double seconds)
+{
+	Lock lock(m_mutex);
+
+	// Within the head it is played from memory again, after an earlier seek dropped it as well
+	const int64_t frame = std::max((int64_t)(seconds * m_inputFileOptions.outputSampleRate + 0.5), (int64_t)0);
+	if (!m_head)
+	{
+		m_head = HeadCache::GetInstance().find(m_filename, m_startTime, m_playTime);
+		m_reader.reset(m_head.get());
+	}
+	stopOpener();
+	if (m_head && frame < m_head->frames)
+	{
+		// A decoder that went on behind the head is opened anew and drops the head again, seeking it back to
+		// the start would not be sample accurate
+		if (m_innerOpen)
+			m_inner->close();
+		m_innerOpen = false;
+		m_headPos = (int)frame;
+		m_done = false;
+		startOpener();
+		return 0;
+	}
+
+	// Anywhere else is played by the decoder alone
+	m_reader.reset(nullptr);
+	m_head.reset();
+	m_ahead.clear();
+	m_aheadPos = 0;
+	if (!m_innerOpen && openInner() != 0)
+		return -1;
+	const int ret = m_inner->seek(seconds);
+	m_done = m_inner->done();
+	return ret;
+}
+
+
+int64_t InputFileHead::outputSamplesEstimation() const
+{
+	Lock lock(m_mutex);
+	if (m_innerOpen)
+		return m_inner->outputSamplesEstimation();
+	return m_head ? m_head->estimation : 0;
+}
+
+
+int InputFileHead::channels() const
+{
+	Lock lock(m_mutex);
+	if (m_head)
+		return m_head->channels;
+	return m_inner ? m_inner->channels() : m_inputFileOptions.getNumChannels();
+}
+
+
+InputFile* CreateInputFileHead(InputFileOptions options /*= InputFileOptions()*/)
+{
+	return new InputFileHead(options);
+}
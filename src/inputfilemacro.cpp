@@ -0,0 +1,334 @@
+// src/inputfilemacro.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <algorithm>
+
+#include "inputfilemacro.h"
+#include "MixKernel.h"
+#include "ts3log.h"
+
+// Frames of every voice decoded by the worker before it is due
+#define MACRO_PREROLL_FRAMES 4800
+
+// Number of frames handed to the producer per readSamples call
+#define MACRO_READ_CHUNK 4096
+
+// Length of the fade before the stop frame of a voice, 5 ms
+#define MACRO_STOP_FADE_FRAMES 240
+
+
+InputFileMacro::InputFileMacro(const InputFileOptions& options) :
+	m_inputFileOptions(options),
+	m_channels(options.getNumChannels()),
+	m_done(false),
+	m_pos(0),
+	m_stop(false)
+{
+}
+
+
+InputFileMacro::~InputFileMacro()
+{
+	close();
+}
+
+
+int InputFileMacro::openMacro(const std::vector<voice_t>& voices, int channels)
+{
+	Lock lock(m_mutex);
+	closeNoLock();
+
+	m_voices = voices;
+	std::stable_sort(m_voices.begin(), m_voices.end(), [](const voice_t& a, const voice_t& b) {
+		return a.startFrame < b.startFrame;
+	});
+	m_channels = channels;
+	m_stop = false;
+	m_slots.resize(m_voices.size());
+	for (slot_t& slot : m_slots)
+	{
+		slot.state = eSLOT_PENDING;
+		slot.finished = true;
+	}
+
+	// The first voice is opened right away like a single file would be, so a macro of missing files fails
+	size_t first = 0;
+	for (; first < m_slots.size() && !prepare(m_slots[first], m_voices[first], 0); first++)
+		m_slots[first].state = eSLOT_FAILED;
+	if (first == m_slots.size())
+		return -1;
+
+	m_slots[first].state = eSLOT_READY;
+	m_thread = std::thread(&InputFileMacro::run, this);
+	return 0;
+}
+
+
+int InputFileMacro::open(const char* filename, double /*startPosSeconds*/, double /*playTimeSeconds*/)
+{
+	logError("Cannot open %s as macro", filename);
+	return -1;
+}
+
+
+int InputFileMacro::close()
+{
+	// Release a producer waiting for a voice before taking its lock
+	stopWorker();
+	Lock lock(m_mutex);
+	return closeNoLock();
+}
+
+
+void InputFileMacro::stopWorker()
+{
+	{
+		Lock lock(m_slotMutex);
+		m_stop = true;
+	}
+	m_slotCond.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+
+int InputFileMacro::closeNoLock()
+{
+	stopWorker();
+	for (slot_t& slot : m_slots)
+	{
+		if (slot.state == eSLOT_READY || slot.state == eSLOT_RETIRED)
+			slot.file->close();
+	}
+	m_slots.clear();
+	m_voices.clear();
+	m_pos = 0;
+	m_done = false;
+	return 0;
+}
+
+
+void InputFileMacro::run()
+{
+	std::unique_lock<std::mutex> lock(m_slotMutex);
+	while (!m_stop)
+	{
+		// Open the voices in the order they start, close the ones that were played in between
+		auto it =
+			std::find_if(m_slots.begin(), m_slots.end(), [](const slot_t& s) { return s.state == eSLOT_PENDING; });
+		if (it != m_slots.end())
+		{
+			const size_t index = it - m_slots.begin();
+			lock.unlock();
+			const bool ready = prepare(m_slots[index], m_voices[index], MACRO_PREROLL_FRAMES);
+			lock.lock();
+			m_slots[index].state = ready ? eSLOT_READY : eSLOT_FAILED;
+			m_slotCond.notify_all();
+			continue;
+		}
+
+		it = std::find_if(m_slots.begin(), m_slots.end(), [](const slot_t& s) { return s.state == eSLOT_RETIRED; });
+		if (it != m_slots.end())
+		{
+			lock.unlock();
+			it->file->close();
+			lock.lock();
+			it->state = eSLOT_CLOSED;
+			continue;
+		}
+
+		m_slotCond.wait(lock);
+	}
+}
+
+
+// Open the voice and decode prerollFrames of it, at most up to its stop frame
+bool InputFileMacro::prepare(slot_t& slot, const voice_t& voice, int prerollFrames)
+{
+	if (!OpenStreamItem(voice.item, slot.file, m_inputFileOptions))
+	{
+		logWarning("Cannot open %s, leaving it out of the macro", voice.item.filename.c_str());
+		return false;
+	}
+
+	slot.finished = slot.file->done();
+	slot.played = 0;
+	slot.frames.clear();
+	slot.pos = 0;
+	int64_t limit = prerollFrames;
+	if (voice.stopFrame >= 0)
+		limit = std::min(limit, voice.stopFrame - voice.startFrame);
+	while (!slot.finished && (int64_t)(slot.frames.size() / m_channels) < limit && !m_stop)
+		decode(slot, voice);
+	return true;
+}
+
+
+// Decode the next piece of the voice and append it to its frames
+void InputFileMacro::decode(slot_t& slot, const voice_t& voice)
+{
+	ItemCollector collector(slot.frames, slot.scratch, slot.file->channels(), m_channels, voice.item.gain);
+	const int count = slot.file->readSamples(&collector);
+	if (count < 0)
+		logWarning("Cannot decode %s, skipping the rest of it", voice.item.filename.c_str());
+	if (count <= 0 || slot.file->done())
+		slot.finished = true;
+}
+
+
+// State of the slot once the worker is done opening it
+InputFileMacro::slot_state_e InputFileMacro::waitForSlot(size_t index)
+{
+	// Only waits if the voice is due before the worker got to it
+	std::unique_lock<std::mutex> lock(m_slotMutex);
+	m_slotCond.wait(lock, [this, index] { return m_stop || m_slots[index].state != eSLOT_PENDING; });
+	return m_slots[index].state;
+}
+
+
+// Hand the played voice back to the worker, which closes it
+void InputFileMacro::retire(size_t index)
+{
+	std::vector<short>().swap(m_slots[index].frames);
+	{
+		Lock lock(m_slotMutex);
+		m_slots[index].state = eSLOT_RETIRED;
+	}
+	m_slotCond.notify_all();
+}
+
+
+// Add the frames of the voice that fall into the block of the stream starting at blockStart to m_sums.
+// Returns the end of the frames added within the block, 0 if there were none.
+int InputFileMacro::mixVoice(size_t index, int64_t blockStart, int blockFrames)
+{
+	const voice_t& voice = m_voices[index];
+	slot_t& slot = m_slots[index];
+	const int64_t length = voice.stopFrame >= 0 ? std::max(voice.stopFrame - voice.startFrame, (int64_t)0) : INT64_MAX;
+	const int offset = (int)std::max(voice.startFrame - blockStart, (int64_t)0);
+	const int want = (int)std::min((int64_t)(blockFrames - offset), length - slot.played);
+
+	int avail = (int)((slot.frames.size() - slot.pos) / m_channels);
+	while (!slot.finished && avail < want)
+	{
+		decode(slot, voice);
+		avail = (int)((slot.frames.size() - slot.pos) / m_channels);
+	}
+	const int take = std::min(want, avail);
+	short* frames = slot.frames.data() + slot.pos;
+
+	// Cut off at the stop frame with a short fade instead of a click
+	if (voice.stopFrame >= 0)
+	{
+		const int64_t fade = std::min((int64_t)MACRO_STOP_FADE_FRAMES, length);
+		for (int i = 0; i < take; i++)
+		{
+			const int64_t frame = slot.played + i;
+			if (frame < length - fade)
+				continue;
+			const float gain = (float)(length - frame) / (float)fade;
+			for (int c = 0; c < m_channels; c++)
+				frames[i * m_channels + c] = (short)((float)frames[i * m_channels + c] * gain);
+		}
+	}
+
+	AccumulateFrames(frames, m_sums.data() + (size_t)offset * m_channels, take * m_channels);
+	slot.pos += (size_t)take * m_channels;
+	slot.played += take;
+
+	if (slot.played >= length || (slot.finished && take == avail))
+		retire(index);
+	else if (slot.pos > slot.frames.size() / 2)
+	{
+		slot.frames.erase(slot.frames.begin(), slot.frames.begin() + slot.pos);
+		slot.pos = 0;
+	}
+	return take > 0 ? offset + take : 0;
+}
+
+
+int InputFileMacro::readSamples(SampleProducer* sampleBuffer)
+{
+	Lock lock(m_mutex);
+	if (m_done)
+		return 0;
+
+	m_sums.assign((size_t)MACRO_READ_CHUNK * m_channels, 0);
+	int written = 0;
+	bool more = false;
+	for (size_t i = 0; i < m_voices.size(); i++)
+	{
+		if (m_voices[i].startFrame >= m_pos + MACRO_READ_CHUNK)
+		{
+			more = true; // Voices are sorted, this and all behind it start in a later block
+			break;
+		}
+		if (waitForSlot(i) != eSLOT_READY)
+			continue;
+		written = std::max(written, mixVoice(i, m_pos, MACRO_READ_CHUNK));
+		if (waitForSlot(i) == eSLOT_READY)
+			more = true;
+	}
+
+	// Gaps between voices are silence, but the stream ends with the last voice
+	const int count = more ? MACRO_READ_CHUNK : written;
+	if (!more)
+		m_done = true;
+	if (count == 0)
+		return 0;
+
+	m_block.resize((size_t)count * m_channels);
+	StoreFrames(m_sums.data(), m_block.data(), count * m_channels);
+	sampleBuffer->produce(m_block.data(), count);
+	m_pos += count;
+	return count;
+}
+
+
+bool InputFileMacro::done() const
+{
+	return m_done;
+}
+
+
+int InputFileMacro::seek(double /*seconds*/)
+{
+	return -1;
+}
+
+
+int64_t InputFileMacro::outputSamplesEstimation() const
+{
+	Lock lock(m_mutex);
+	Lock slotLock(m_slotMutex);
+	int64_t end = m_pos;
+	for (size_t i = 0; i < m_voices.size(); i++)
+	{
+		const voice_t& voice = m_voices[i];
+		if (voice.stopFrame >= 0)
+			end = std::max(end, voice.stopFrame);
+		else if (m_slots[i].state == eSLOT_READY)
+			end = std::max(end, voice.startFrame + m_slots[i].file->outputSamplesEstimation());
+	}
+	return end;
+}
+
+
+int InputFileMacro::channels() const
+{
+	Lock lock(m_mutex);
+	return m_channels;
+}
+
+
+InputFile* CreateInputFileMacro(InputFileOptions options /*= InputFileOptions()*/)
+{
+	return new InputFileMacro(options);
+}
@@ -0,0 +1,113 @@
+// src/inputfilemacro.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "inputfile.h"
+#include "StreamItem.h"
+
+
+// Layers several files into one stream, each starting and optionally stopping at a fixed frame of it.
+// Offsets are counted in frames of the stream, so every voice starts at exactly the sample it is due,
+// independent of how the producer splits its reads. A worker thread opens all voices in the order they
+// start and decodes the beginning of each, so a voice is ready long before its frame comes up.
+class InputFileMacro : public InputFile
+{
+  public:
+	struct voice_t
+	{
+		StreamItem item;
+		int64_t startFrame; // Relative to the start of the stream
+		int64_t stopFrame; // Cut off here with a short fade, -1 to play the sound to its end
+	};
+
+  public:
+	InputFileMacro(const InputFileOptions& options);
+	~InputFileMacro();
+
+	// Start a stream of the voices, returns 0 if the first voice that can be opened was.
+	// Voices that cannot be opened are left out with a warning.
+	// channels: Of the stream, 1 or 2
+	int openMacro(const std::vector<voice_t>& voices, int channels);
+
+	// Macros are opened with openMacro(), fails
+	int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) override;
+	int close() override;
+	backend_e backend() const override
+	{
+		return eBACKEND_MACRO;
+	}
+
+	int readSamples(SampleProducer* sampleBuffer) override;
+	bool done() const override;
+
+	// Voices are bound to the stream, seeking is not supported
+	int seek(double seconds) override;
+
+	// End of the last voice known so far
+	int64_t outputSamplesEstimation() const override;
+	int channels() const override;
+
+  private:
+	enum slot_state_e
+	{
+		eSLOT_PENDING = 0, // The worker still has to open it
+		eSLOT_READY, // Owned by the producer from now on
+		eSLOT_FAILED,
+		eSLOT_RETIRED, // Played, the worker closes it
+		eSLOT_CLOSED,
+	};
+
+	// A voice with the frames decoded ahead of it, already converted to the stream
+	struct slot_t
+	{
+		std::unique_ptr<InputFile> file;
+		slot_state_e state;
+		bool finished; // Nothing left to decode behind frames
+		int64_t played; // Frames of the voice mixed so far
+		std::vector<short> frames;
+		size_t pos; // Start of the frames not mixed yet
+		std::vector<short> scratch; // Decoder output before it is converted
+	};
+
+	int closeNoLock();
+	void stopWorker();
+	void run();
+	bool prepare(slot_t& slot, const voice_t& voice, int prerollFrames);
+	void decode(slot_t& slot, const voice_t& voice);
+	slot_state_e waitForSlot(size_t index);
+	void retire(size_t index);
+	int mixVoice(size_t index, int64_t blockStart, int blockFrames);
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	const InputFileOptions m_inputFileOptions;
+	std::vector<voice_t> m_voices; // Sorted by startFrame
+	int m_channels;
+	std::atomic<bool> m_done;
+	int64_t m_pos; // Frames of the stream handed out so far
+	std::vector<int> m_sums;
+	std::vector<short> m_block;
+	mutable std::mutex m_mutex; // Held by the producer thread while reading
+
+	// Slot states are changed with m_slotMutex, the worker only touches slots that are pending or retired
+	std::vector<slot_t> m_slots;
+	mutable std::mutex m_slotMutex;
+	std::condition_variable m_slotCond;
+	std::thread m_thread;
+	volatile bool m_stop;
+};
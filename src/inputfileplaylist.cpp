@@ -0,0 +1,392 @@
+// src/inputfileplaylist.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <algorithm>
+
+#include "inputfileplaylist.h"
+#include "MixKernel.h"
+#include "ts3log.h"
+
+// Frames of the next item decoded ahead at least, on top of the crossfade
+#define PLAYLIST_PREROLL_FRAMES 4800
+
+// Number of frames handed to the producer per readSamples call
+#define PLAYLIST_READ_CHUNK 8192
+
+// Items of a loop are kept in memory up to this many frames all together, 20 s at 48 kHz
+#define PLAYLIST_MEMORY_FRAMES (48000 * 20)
+
+
+InputFilePlaylist::InputFilePlaylist(const InputFileOptions& options) :
+	m_inputFileOptions(options),
+	m_channels(options.getNumChannels()),
+	m_crossfade(0),
+	m_loop(false),
+	m_silentItems(0),
+	m_done(false),
+	m_cur({nullptr, false, 0, true, {}, {}, nullptr, false, {}}),
+	m_tailPos(0),
+	m_curFrames(0),
+	m_next({nullptr, false, 0, true, {}, {}, nullptr, false, {}}),
+	m_nextState(eNEXT_END),
+	m_nextIndex(0),
+	m_memorySamples(0),
+	m_stop(false)
+{
+}
+
+
+InputFilePlaylist::~InputFilePlaylist()
+{
+	close();
+}
+
+
+int InputFilePlaylist::openList(const std::vector<item_t>& items, int channels, int crossfadeFrames, bool loop)
+{
+	Lock lock(m_mutex);
+	closeNoLock();
+
+	m_items = items;
+	m_channels = channels;
+	m_crossfade = std::max(crossfadeFrames, 0);
+	m_loop = loop;
+	m_unplayable.assign(m_items.size(), false);
+	m_memory.assign(m_items.size(), nullptr);
+	m_stop = false;
+
+	// The first item starts right away, like a single file would
+	if (!prepare(m_cur, 0, 0))
+		return -1;
+	requestNext(m_cur.index + 1);
+	m_thread = std::thread(&InputFilePlaylist::run, this);
+	return 0;
+}
+
+
+int InputFilePlaylist::open(const char* filename, double /*startPosSeconds*/, double /*playTimeSeconds*/)
+{
+	logError("Cannot open %s as playlist", filename);
+	return -1;
+}
+
+
+int InputFilePlaylist::close()
+{
+	// Release a producer waiting for the next item before taking its lock
+	stopWorker();
+	Lock lock(m_mutex);
+	return closeNoLock();
+}
+
+
+void InputFilePlaylist::stopWorker()
+{
+	{
+		Lock lock(m_nextMutex);
+		m_stop = true;
+	}
+	m_nextCond.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+
+int InputFilePlaylist::closeNoLock()
+{
+	stopWorker();
+	for (slot_t* slot : {&m_cur, &m_next})
+	{
+		if (slot->open)
+			slot->file->close();
+		slot->open = false;
+		slot->finished = true;
+		slot->preroll.clear();
+		slot->memory.reset();
+		slot->recording = false;
+		std::vector<short>().swap(slot->record);
+	}
+	m_tail.clear();
+	m_tailPos = 0;
+	m_curFrames = 0;
+	m_silentItems = 0;
+	m_nextState = eNEXT_END;
+	m_memory.clear();
+	m_memorySamples = 0;
+	m_done = false;
+	return 0;
+}
+
+
+void InputFilePlaylist::run()
+{
+	std::unique_lock<std::mutex> lock(m_nextMutex);
+	while (true)
+	{
+		m_nextCond.wait(lock, [this] { return m_stop || m_nextState == eNEXT_WANTED; });
+		if (m_stop)
+			break;
+
+		// The slot still holds the item played before the current one, it is closed here as well
+		const int index = m_nextIndex;
+		lock.unlock();
+		const bool ready = prepare(m_next, index, m_crossfade + PLAYLIST_PREROLL_FRAMES);
+		lock.lock();
+		m_nextState = ready ? eNEXT_READY : eNEXT_END;
+		m_nextCond.notify_all();
+	}
+}
+
+
+// Open the first item from index on that can be opened and decode prerollFrames of it.
+// An item a loop keeps in memory is not opened, the slot refers to its frames instead.
+bool InputFilePlaylist::prepare(slot_t& slot, int index, int prerollFrames)
+{
+	if (slot.open)
+		slot.file->close();
+	slot.open = false;
+	slot.finished = true;
+	slot.preroll.clear();
+	slot.memory.reset();
+	slot.recording = false;
+	slot.record.clear();
+
+	// A loop wraps around to the first item, but tries every item only once
+	const int size = (int)m_items.size();
+	const int candidates = m_loop ? size : size - index;
+	for (int i = 0; i < candidates && !m_stop; i++, index = (index + 1) % size)
+	{
+		if (m_unplayable[index])
+			continue;
+
+		slot.index = index;
+		{
+			Lock lock(m_nextMutex);
+			slot.memory = m_memory[index];
+		}
+		if (slot.memory)
+			return true;
+
+		if (!OpenStreamItem(m_items[index], slot.file, m_inputFileOptions))
+		{
+			logWarning("Cannot open %s, skipping it in the playlist", m_items[index].filename.c_str());
+			m_unplayable[index] = true;
+			continue;
+		}
+
+		slot.open = true;
+		slot.finished = slot.file->done();
+		slot.recording = m_loop;
+		while (!slot.finished && (int)(slot.preroll.size() / m_channels) < prerollFrames && !m_stop)
+			decode(slot, slot.preroll);
+		return true;
+	}
+	return false;
+}
+
+
+// Decode the next piece of the item in slot and append it to out
+void InputFilePlaylist::decode(slot_t& slot, std::vector<short>& out)
+{
+	const size_t size = out.size();
+	ItemCollector collector(out, slot.scratch, slot.file->channels(), m_channels, m_items[slot.index].gain);
+	const int count = slot.file->readSamples(&collector);
+	if (count < 0)
+		logWarning("Cannot decode %s, skipping the rest of it", m_items[slot.index].filename.c_str());
+
+	if (slot.recording)
+	{
+		// The frames are recorded before any crossfade, which only ever writes to the item before
+		const size_t added = out.size() - size;
+		slot.recording = count >= 0 && slot.record.size() + added <= (size_t)PLAYLIST_MEMORY_FRAMES * m_channels;
+		if (slot.recording)
+			slot.record.insert(slot.record.end(), out.begin() + size, out.end());
+		else
+			std::vector<short>().swap(slot.record);
+	}
+
+	if (count <= 0 || slot.file->done())
+	{
+		slot.finished = true;
+		if (slot.recording)
+			keep(slot);
+	}
+}
+
+
+// Keep the recorded frames of a finished item, so the next passes of the loop play it from memory
+void InputFilePlaylist::keep(slot_t& slot)
+{
+	{
+		Lock lock(m_nextMutex);
+		const size_t budget = (size_t)PLAYLIST_MEMORY_FRAMES * m_channels;
+		if (!m_memory[slot.index] && m_memorySamples + slot.record.size() <= budget)
+		{
+			m_memorySamples += slot.record.size();
+			m_memory[slot.index] = std::make_shared<const std::vector<short>>(std::move(slot.record));
+		}
+	}
+	slot.recording = false;
+	std::vector<short>().swap(slot.record);
+}
+
+
+void InputFilePlaylist::requestNext(int index)
+{
+	{
+		Lock lock(m_nextMutex);
+		m_nextIndex = m_loop && index == (int)m_items.size() ? 0 : index;
+		m_nextState = m_nextIndex < (int)m_items.size() ? eNEXT_WANTED : eNEXT_END;
+	}
+	m_nextCond.notify_all();
+}
+
+
+// Continue with the next item right behind the current one, returns false if there is none
+bool InputFilePlaylist::switchToNext()
+{
+	// A loop of items that have no frames would never hand out anything
+	m_silentItems = m_curFrames > 0 ? 0 : m_silentItems + 1;
+	if (m_silentItems > (int)m_items.size())
+		return false;
+
+	{
+		// Only waits if the worker couldn't open the next item during the whole current one
+		std::unique_lock<std::mutex> lock(m_nextMutex);
+		m_nextCond.wait(lock, [this] { return m_stop || m_nextState != eNEXT_WANTED; });
+		if (m_nextState != eNEXT_READY)
+			return false;
+	}
+
+	// Crossfade the frames held back at the end of the current item with the start of the next
+	const std::vector<short>& preroll = m_next.memory ? *m_next.memory : m_next.preroll;
+	const int prerollFrames = (int)(preroll.size() / m_channels);
+	const int overlap = std::min(std::min(std::min(tailFrames(), m_curFrames), m_crossfade), prerollFrames);
+	CrossfadeFrames(preroll.data(), m_tail.data() + m_tail.size() - overlap * m_channels, m_channels, overlap);
+	m_tail.insert(m_tail.end(), preroll.begin() + overlap * m_channels, preroll.end());
+	m_curFrames = prerollFrames - overlap;
+
+	std::swap(m_cur, m_next);
+	requestNext(m_cur.index + 1);
+	return true;
+}
+
+
+int InputFilePlaylist::readSamples(SampleProducer* sampleBuffer)
+{
+	Lock lock(m_mutex);
+
+	// 0 would tell the producer that the stream is done, so go on until there is something to hand out
+	while (!m_done)
+	{
+		// Hand out an item before switching to the next one, a loop of items played from memory never stops switching
+		const int hold = m_loop || m_cur.index + 1 < (int)m_items.size() ? m_crossfade : 0;
+		if (tailFrames() > hold)
+			return handOut(sampleBuffer, tailFrames() - hold);
+
+		if (!m_cur.finished)
+		{
+			const int before = tailFrames();
+			decode(m_cur, m_tail);
+			m_curFrames += tailFrames() - before;
+		}
+		else if (!switchToNext())
+		{
+			if (tailFrames() > 0)
+				return handOut(sampleBuffer, tailFrames());
+			m_done = true;
+		}
+	}
+	return 0;
+}
+
+
+int InputFilePlaylist::handOut(SampleProducer* producer, int frames)
+{
+	const int count = std::min(frames, PLAYLIST_READ_CHUNK);
+	producer->produce(m_tail.data() + m_tailPos, count);
+	m_tailPos += (size_t)count * m_channels;
+
+	// Move the rest to the front once most of the tail was handed out
+	if (m_tailPos == m_tail.size())
+	{
+		m_tail.clear();
+		m_tailPos = 0;
+	}
+	else if (m_tailPos > m_tail.size() / 2)
+	{
+		m_tail.erase(m_tail.begin(), m_tail.begin() + m_tailPos);
+		m_tailPos = 0;
+	}
+	return count;
+}
+
+
+int InputFilePlaylist::tailFrames() const
+{
+	return (int)((m_tail.size() - m_tailPos) / m_channels);
+}
+
+
+bool InputFilePlaylist::done() const
+{
+	return m_done;
+}
+
+
+int InputFilePlaylist::seek(double seconds)
+{
+	Lock lock(m_mutex);
+	m_tail.clear();
+	m_tailPos = 0;
+	m_curFrames = 0;
+	m_done = false;
+
+	if (m_cur.memory)
+	{
+		// Kept in memory by the loop, nothing has to be decoded
+		const int64_t frames = (int64_t)(m_cur.memory->size() / m_channels);
+		const int64_t frame = (int64_t)(seconds * m_inputFileOptions.outputSampleRate + 0.5);
+		const size_t pos = (size_t)std::min(std::max(frame, (int64_t)0), frames) * m_channels;
+		m_tail.assign(m_cur.memory->begin() + pos, m_cur.memory->end());
+		m_curFrames = tailFrames();
+		return 0;
+	}
+	if (!m_cur.open)
+		return -1;
+
+	m_cur.recording = false; // The item is not played in full anymore
+	std::vector<short>().swap(m_cur.record);
+	const int ret = m_cur.file->seek(seconds);
+	m_cur.finished = m_cur.file->done();
+	return ret;
+}
+
+
+int64_t InputFilePlaylist::outputSamplesEstimation() const
+{
+	Lock lock(m_mutex);
+	if (m_cur.memory)
+		return (int64_t)(m_cur.memory->size() / m_channels);
+	return m_cur.open ? m_cur.file->outputSamplesEstimation() : 0;
+}
+
+
+int InputFilePlaylist::channels() const
+{
+	Lock lock(m_mutex);
+	return m_channels;
+}
+
+
+InputFile* CreateInputFilePlaylist(InputFileOptions options /*= InputFileOptions()*/)
+{
+	return new InputFilePlaylist(options);
+}
@@ -0,0 +1,128 @@
+// src/inputfileplaylist.h
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inputfile.h"
+#include "StreamItem.h"
+
+
+// Plays several files back to back as one stream, without a gap between them.
+// While an item plays, a worker thread opens the next one and decodes its start, so the producer
+// only has to append it at the exact sample the previous one ended. Optionally the end of every item
+// is crossfaded with the start of the next. Items with other channels than the stream are converted.
+// A looping stream starts over with the first item behind the last one. Items short enough are kept in memory
+// on the first pass and played from there afterwards, longer ones are opened again by the worker ahead of time.
+class InputFilePlaylist : public InputFile
+{
+  public:
+	typedef StreamItem item_t;
+
+  public:
+	InputFilePlaylist(const InputFileOptions& options);
+	~InputFilePlaylist();
+
+	// Start a stream of the items in this order, returns 0 if the first one that can be opened was.
+	// Items that cannot be opened are skipped with a warning.
+	// channels: Of the stream, 1 or 2
+	// crossfadeFrames: Length of the crossfades, 0 to join the items without one
+	// loop: Play the items over and over until closed, the last one is crossfaded with the first as well
+	int openList(const std::vector<item_t>& items, int channels, int crossfadeFrames, bool loop);
+
+	// Playlists are opened with openList(), fails
+	int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) override;
+	int close() override;
+	backend_e backend() const override
+	{
+		return eBACKEND_PLAYLIST;
+	}
+
+	int readSamples(SampleProducer* sampleBuffer) override;
+	bool done() const override;
+
+	// Seek within the item decoded last, from memory if the loop keeps it there
+	int seek(double seconds) override;
+
+	// Of the item playing
+	int64_t outputSamplesEstimation() const override;
+	int channels() const override;
+
+  private:
+	// An opened item, with the frames decoded ahead of it already converted to the stream
+	struct slot_t
+	{
+		std::unique_ptr<InputFile> file;
+		bool open;
+		int index; // In m_items
+		bool finished; // Nothing left to decode behind preroll
+		std::vector<short> preroll;
+		std::vector<short> scratch; // Decoder output before it is converted
+		std::shared_ptr<const std::vector<short>> memory; // All frames of the item, played instead of file
+		bool recording; // Everything decoded so far is in record, to be kept in m_memory once finished
+		std::vector<short> record;
+	};
+
+	enum next_e
+	{
+		eNEXT_WANTED = 0, // The worker is preparing m_next
+		eNEXT_READY,
+		eNEXT_END, // No item left that could be opened
+	};
+
+	int closeNoLock();
+	void stopWorker();
+	void run();
+	bool prepare(slot_t& slot, int index, int prerollFrames);
+	void decode(slot_t& slot, std::vector<short>& out);
+	void keep(slot_t& slot);
+	void requestNext(int index);
+	bool switchToNext();
+	int handOut(SampleProducer* producer, int frames);
+	int tailFrames() const;
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	const InputFileOptions m_inputFileOptions;
+	std::vector<item_t> m_items;
+	int m_channels;
+	int m_crossfade;
+	bool m_loop;
+	std::vector<bool> m_unplayable; // Items that could not be opened are not tried again, only used in prepare()
+	int m_silentItems; // Items in a row that had no frames, a loop of only those ends
+	std::atomic<bool> m_done;
+	mutable std::mutex m_mutex; // Held by the producer thread while reading
+
+	// Converted frames of the item playing that were not handed out yet. While another item follows,
+	// the last m_crossfade of them are held back to be crossfaded with it.
+	slot_t m_cur;
+	std::vector<short> m_tail;
+	size_t m_tailPos;
+	int m_curFrames; // Frames appended for the current item after its crossfade, a short item is faded only once
+
+	// The next item, owned by the worker while m_nextState is eNEXT_WANTED
+	slot_t m_next;
+	next_e m_nextState;
+	int m_nextIndex;
+
+	// Items of a loop played from memory, by index. Guarded by m_nextMutex like the next item.
+	std::vector<std::shared_ptr<const std::vector<short>>> m_memory;
+	size_t m_memorySamples;
+	std::mutex m_nextMutex;
+	std::condition_variable m_nextCond;
+	std::thread m_thread;
+	volatile bool m_stop;
+};
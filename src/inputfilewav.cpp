@@ -0,0 +1,327 @@
+// src/inputfilewav.cpp
+//----------------------------------
+// RP Soundboard Source Code
+// Copyright (c) 2026 Marius Graefe
+// All rights reserved
+// Contact: rp_soundboard@mgraefe.de
+//----------------------------------
+
+#include "common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ts3log.h"
+#include "inputfile.h"
+#include "MappedFile.h"
+
+// Number of samples handed to the producer per readSamples call
+#define WAV_READ_CHUNK 8192
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+
+namespace
+{
+struct WavFormat
+{
+	int formatTag;
+	int channels;
+	int sampleRate;
+	int bitsPerSample;
+	int64_t dataOffset;
+	int64_t dataSize;
+};
+
+
+inline uint32_t readLE32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+inline uint16_t readLE16(const uint8_t* p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+// Walk the RIFF chunks and extract the format and position of the sample data
+bool parseWavHeader(const MappedFile& file, WavFormat& fmt)
+{
+	const int64_t size = file.size();
+	uint8_t riff[12];
+	if (!file.read(0, riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+		return false;
+
+	bool haveFmt = false;
+	int64_t pos = 12;
+	while (pos + 8 <= size)
+	{
+		uint8_t chunk[8 + 40]; // Header and the longest format chunk used
+		if (!file.read(pos, chunk, 8))
+			return false;
+		int64_t chunkSize = readLE32(chunk + 4);
+		pos += 8;
+
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if (chunkSize < 16 || pos + chunkSize > size ||
+				!file.read(pos, chunk + 8, (size_t)std::min(chunkSize, (int64_t)40)))
+				return false;
+			fmt.formatTag = readLE16(chunk + 8);
+			fmt.channels = readLE16(chunk + 10);
+			fmt.sampleRate = (int)readLE32(chunk + 12);
+			fmt.bitsPerSample = readLE16(chunk + 22);
+			// Extensible format: actual format is in the first two bytes of the sub format GUID
+			if (fmt.formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40)
+				fmt.formatTag = readLE16(chunk + 32);
+			haveFmt = true;
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (!haveFmt)
+				return false;
+			fmt.dataOffset = pos;
+			// Streaming writers leave the size at 0 or 0xFFFFFFFF, so never trust it beyond the file end
+			fmt.dataSize = (chunkSize == 0) ? size - pos : std::min(chunkSize, size - pos);
+			return true;
+		}
+
+		pos += chunkSize + (chunkSize & 1); // Chunks are padded to even sizes
+	}
+
+	return false;
+}
+
+
+// Whether the samples can be handed out as they are stored in the file
+bool isDirectlyPlayable(const WavFormat& fmt, const InputFileOptions& options)
+{
+	bool channelsMatch = fmt.channels == options.getNumChannels();
+	if (options.outputChannelLayout == InputFileOptions::NATIVE)
+		channelsMatch = fmt.channels == 1 || fmt.channels == 2;
+	return fmt.formatTag == WAVE_FORMAT_PCM && fmt.bitsPerSample == 16 && fmt.sampleRate == options.outputSampleRate &&
+		   channelsMatch && fmt.dataOffset % 2 == 0;
+}
+} // namespace
+
+
+// Plays 16 bit PCM wave files that are already in the output format.
+// Samples are copied into the producer straight out of the memory mapped file, without decoding.
+// All targets are little endian, so the file data can be used as is.
+class InputFileWav : public InputFile
+{
+  public:
+	InputFileWav(const InputFileOptions& options);
+	~InputFileWav();
+	int open(const char* filename, double startPosSeconds = 0.0, double playTimeSeconds = -1.0) override;
+	int close() override;
+	backend_e backend() const override
+	{
+		return eBACKEND_WAV;
+	}
+
+	int readSamples(SampleProducer* sampleBuffer) override;
+	bool done() const override;
+	int seek(double seconds) override;
+	int64_t outputSamplesEstimation() const override;
+	int channels() const override
+	{
+		return m_channels;
+	}
+
+  private:
+	int closeNoLock();
+
+	typedef std::lock_guard<std::mutex> Lock;
+
+  private:
+	const InputFileOptions m_inputFileOptions;
+	std::shared_ptr<MappedFile> m_file;
+	int64_t m_dataOffset; // Of the sample data in the file
+	int m_channels;
+	int64_t m_numSamples;
+	int64_t m_begin; // Start position given to open
+	int64_t m_pos;
+	int64_t m_end;
+	std::atomic<bool> m_done;
+	std::vector<short> m_chunk; // Read into if the producer has no room to lend
+	std::mutex m_mutex;
+};
+
+
+InputFileWav::InputFileWav(const InputFileOptions& options) :
+	m_inputFileOptions(options),
+	m_dataOffset(0),
+	m_channels(options.getNumChannels()),
+	m_numSamples(0),
+	m_begin(0),
+	m_pos(0),
+	m_end(0),
+	m_done(false)
+{
+}
+
+
+InputFileWav::~InputFileWav()
+{
+	closeNoLock();
+}
+
+
+int InputFileWav::open(const char* filename, double startPosSeconds /*= 0.0*/, double playTimeSeconds /*= -1.0*/)
+{
+	Lock lock(m_mutex);
+	closeNoLock();
+
+	m_file = MappedFile::Open(filename);
+	WavFormat fmt;
+	if (!m_file || !parseWavHeader(*m_file, fmt) ||
+		!isDirectlyPlayable(fmt, m_inputFileOptions))
+	{
+		logError("Cannot open %s as native wave file", filename);
+		closeNoLock();
+		return -1;
+	}
+
+	const int rate = m_inputFileOptions.outputSampleRate;
+	m_dataOffset = fmt.dataOffset;
+	m_channels = fmt.channels;
+	m_numSamples = fmt.dataSize / (fmt.channels * 2);
+	m_pos = startPosSeconds > 0.0 ? std::min((int64_t)(startPosSeconds * rate + 0.5), m_numSamples) : 0;
+	m_begin = m_pos;
+	m_end = m_numSamples;
+	if (playTimeSeconds > 0.0)
+		m_end = std::min(m_end, m_pos + (int64_t)(playTimeSeconds * (double)rate + 0.5));
+	m_done = m_pos >= m_end;
+
+	m_file->willNeed(fmt.dataOffset + m_pos * fmt.channels * 2, WAV_READ_CHUNK * 2 * fmt.channels * 4);
+
+	if (!m_inputFileOptions.quiet)
+		logInfo(
+			"Opened file: %s; Native PCM wave, Channels: %i, Rate: %i, Samples: %lld", filename, fmt.channels,
+			rate, m_numSamples
+		);
+	return 0;
+}
+
+
+int InputFileWav::close()
+{
+	Lock lock(m_mutex);
+	return closeNoLock();
+}
+
+
+int InputFileWav::closeNoLock()
+{
+	m_file.reset();
+	m_dataOffset = 0;
+	m_numSamples = 0;
+	m_begin = 0;
+	m_pos = 0;
+	m_end = 0;
+	m_done = false;
+	return 0;
+}
+
+
+int InputFileWav::readSamples(SampleProducer* sampleBuffer)
+{
+	Lock lock(m_mutex);
+
+	if (!m_file)
+		return -1;
+
+	int count = (int)std::max(std::min((int64_t)WAV_READ_CHUNK, m_end - m_pos), (int64_t)0);
+	if (count > 0)
+	{
+		// Without room to lend the producer keeps what it cannot take yet, a zero count would mean the end
+		short* samples;
+		const int reserved = sampleBuffer->reserve(&samples, count);
+		if (reserved > 0)
+			count = reserved;
+		else
+		{
+			sampleBuffer->commit(0);
+			m_chunk.resize((size_t)count * m_channels);
+			samples = m_chunk.data();
+		}
+
+		const size_t bytes = (size_t)count * m_channels * 2;
+		if (!m_file->read(m_dataOffset + m_pos * m_channels * 2, samples, bytes))
+		{
+			// Truncated or gone since it was opened
+			if (reserved > 0)
+				sampleBuffer->commit(0);
+			logError("Cannot read %s", m_file->filename().c_str());
+			return -1;
+		}
+		if (reserved > 0)
+			sampleBuffer->commit(count);
+		else
+			sampleBuffer->produce(samples, count);
+		m_pos += count;
+	}
+
+	if (m_pos >= m_end)
+		m_done = true;
+
+	return count;
+}
+
+
+bool InputFileWav::done() const
+{
+	return m_done;
+}
+
+
+int InputFileWav::seek(double seconds)
+{
+	Lock lock(m_mutex);
+	if (!m_file)
+		return -1;
+
+	int64_t pos = m_begin + (int64_t)(seconds * m_inputFileOptions.outputSampleRate + 0.5);
+	m_pos = std::min(std::max(pos, m_begin), m_end);
+	m_done = m_pos >= m_end;
+	return 0;
+}
+
+
+int64_t InputFileWav::outputSamplesEstimation() const
+{
+	return m_numSamples;
+}
+
+
+InputFile* CreateInputFileWav(InputFileOptions options /*= InputFileOptions()*/)
+{
+	return new InputFileWav(options);
+}
+
+
+bool CanOpenInputFileWav(const char* filename, InputFileOptions options /*= InputFileOptions()*/)
+{
+	// Checking the extension first avoids mapping files that are certainly not wave files
+	const char* ext = strrchr(filename, '.');
+	if (!ext)
+		return false;
+	std::string extLower(ext);
+	std::transform(extLower.begin(), extLower.end(), extLower.begin(), [](char c) { return (char)tolower(c); });
+	if (extLower != ".wav" && extLower != ".wave")
+		return false;
+
+	// The mapping stays warm, so opening the file right after this check doesn't map it again
+	std::shared_ptr<MappedFile> file = MappedFile::Open(filename);
+	WavFormat fmt;
+	return file && parseWavHeader(*file, fmt) && isDirectlyPlayable(fmt, options);
+}
@@ -18,10 +18,19 @@
 #include <vector>
 #include <cstdarg>
 #include <map>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include <QObject>
 #include <QMessageBox>
 #include <QString>
+#include <QDir>
+#include <QFileInfo>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStringList>
 
 #include "main.h"
 #include "ts3log.h"
@@ -34,6 +43,13 @@
 #include "SoundInfo.h"
 #include "TalkStateManager.h"
 #include "SpeechBubble.h"
+#include "DecoderPool.h"
+#include "MediaInfoCache.h"
+#include "RtCheck.h"
+#include "OfflineRenderer.h"
+#include "BatchTranscoder.h"
+#include "LockTelemetry.h"
+#include "HeadCache.h"
 
 class ModelObserver_Prog : public ConfigModel::Observer
 {
@@ -57,6 +73,40 @@ ModelObserver_Prog* modelObserver = nullptr;
 UpdateChecker* updateChecker = nullptr;
 std::map<uint64, int> connectionStatusMap;
 typedef std::lock_guard<std::mutex> Lock;
+bool headCacheUpdatePending = false;
+std::thread renderThread;
+std::atomic<bool> renderRunning(false);
+
+
+// Sounds are often changed in bursts, e.g. while loading a config, so the heads are updated once it settles
+static void scheduleHeadCacheUpdate()
+{
+	if (headCacheUpdatePending)
+		return;
+	headCacheUpdatePending = true;
+	QTimer::singleShot(
+		1000,
+		[]
+		{
+			headCacheUpdatePending = false;
+			if (!configModel)
+				return;
+
+			std::vector<HeadCache::sound_t> heads;
+			for (int i = 0; i < NUM_CONFIGS; i++)
+			{
+				for (const SoundInfo& sound : configModel->sounds(i))
+				{
+					// Prepared sounds are mapped wave files, they start instantly anyway
+					if (sound.filename.isEmpty() || !BatchTranscoder::GetInstance().preparedFile(sound).isEmpty())
+						continue;
+					heads.push_back({sound.filename.toUtf8().toStdString(), sound.getStartTime(), sound.getPlayTime()});
+				}
+			}
+			HeadCache::GetInstance().update(heads);
+		}
+	);
+}
 
 
 void ModelObserver_Prog::notify(ConfigModel& model, ConfigModel::notifications_e what, int data)
@@ -74,6 +124,29 @@ void ModelObserver_Prog::notify(ConfigModel& model, ConfigModel::notifications_e
 		break;
 	case ConfigModel::NOTIFY_SET_MUTE_MYSELF_DURING_PB:
 		sampler->setMuteMyself(model.getMuteMyselfDuringPb());
+		break;
+	case ConfigModel::NOTIFY_SET_UNDERRUN_POLICY:
+		sampler->setUnderrunPolicy(model.getUnderrunPolicy());
+		break;
+	case ConfigModel::NOTIFY_SET_HEAD_CACHE_LENGTH:
+		HeadCache::GetInstance().setLength(model.getHeadCacheLength());
+		scheduleHeadCacheUpdate();
+		break;
+	case ConfigModel::NOTIFY_SET_HEAD_CACHE_COMPRESSION:
+		HeadCache::GetInstance().setCompression(model.getHeadCacheCompression());
+		scheduleHeadCacheUpdate();
+		break;
+	case ConfigModel::NOTIFY_SET_MEDIA_EXACT_LENGTH:
+		MediaInfoCache::GetInstance().setExactLength(model.getMediaExactLength());
+		break;
+	case ConfigModel::NOTIFY_SET_BUFFER_BOUNDS:
+		sampler->setBufferBounds(model.getBufferMinMs(), model.getBufferMaxMs());
+		break;
+	case ConfigModel::NOTIFY_SET_SOUND:
+		if (const SoundInfo* info = model.getSoundInfo(data))
+			MediaInfoCache::GetInstance().request(info->filename);
+		scheduleHeadCacheUpdate();
+		break;
 	default:
 		break;
 	}
@@ -85,6 +158,8 @@ void sb_handlePlaybackData(
 	const unsigned int* channelSpeakerArray, unsigned int* channelFillMask
 )
 {
+	RT_AUDIO_SCOPE();
+
 	if (serverConnectionHandlerID != activeServerId)
 		return; // Ignore other servers
 
@@ -94,6 +169,8 @@ void sb_handlePlaybackData(
 
 void sb_handleCaptureData(uint64 serverConnectionHandlerID, short* samples, int sampleCount, int channels, int* edited)
 {
+	RT_AUDIO_SCOPE();
+
 	if (serverConnectionHandlerID != activeServerId)
 		return; // Ignore other servers
 
@@ -103,10 +180,51 @@ void sb_handleCaptureData(uint64 serverConnectionHandlerID, short* samples, int
 }
 
 
+// Sounds of the buttons of a playlist in the order to play them. Empty buttons and other playlists are left out.
+static std::vector<SoundInfo> getPlaylistSounds(const SoundInfo& playlist)
+{
+	std::vector<SoundInfo> sounds;
+	for (int buttonId : playlist.playlist)
+	{
+		const SoundInfo* sound = configModel->getSoundInfo(buttonId);
+		if (sound && !sound->filename.isEmpty() && !sound->isPlaylist() && !sound->isMacro())
+			sounds.push_back(*sound);
+	}
+
+	if (playlist.playlistOrder == SoundInfo::ePLAYLIST_SHUFFLED)
+	{
+		static std::mt19937 random(std::random_device{}());
+		std::shuffle(sounds.begin(), sounds.end(), random);
+	}
+	return sounds;
+}
+
+
+// Sound of every voice of a macro, in its order. Buttons without a file and other playlists or macros
+// get an empty sound, which is left out.
+static std::vector<SoundInfo> getMacroSounds(const SoundInfo& macro)
+{
+	std::vector<SoundInfo> sounds;
+	for (const SoundInfo::macro_voice_t& voice : macro.macro)
+	{
+		const SoundInfo* sound = configModel->getSoundInfo(voice.buttonId);
+		if (sound && !sound->isPlaylist() && !sound->isMacro())
+			sounds.push_back(*sound);
+		else
+			sounds.push_back(SoundInfo());
+	}
+	return sounds;
+}
+
+
 int sb_playFile(const SoundInfo& sound)
 {
 	if (activeServerId == 0)
 		return 2;
+	if (sound.isMacro())
+		return sampler->playMacro(sound, getMacroSounds(sound)) ? 0 : 1;
+	if (sound.isPlaylist())
+		return sampler->playPlaylist(sound, getPlaylistSounds(sound)) ? 0 : 1;
 	return sampler->playFile(sound) ? 0 : 1;
 }
 
@@ -160,6 +278,16 @@ void sb_init()
 			configModel = new ConfigModel();
 			configModel->readConfig();
 
+			// Only reads the stored media infos, the sound files are checked in the background
+			QDir configDir = QFileInfo(ConfigModel::GetFullConfigPath()).dir();
+			MediaInfoCache::GetInstance().load(configDir.filePath("rp_soundboard_media.cache"));
+			BatchTranscoder::GetInstance().setDirectory(configDir.filePath("rp_soundboard_prepared"));
+			for (int i = 0; i < NUM_CONFIGS; i++)
+			{
+				for (const SoundInfo& sound : configModel->sounds(i))
+					MediaInfoCache::GetInstance().request(sound.filename);
+			}
+
 			/* This if first QObject instantiated, it will load the resources */
 			sampler = new Sampler();
 			sampler->init();
@@ -201,6 +329,13 @@ void sb_kill()
 	sampler->shutdown();
 	delete sampler;
 	sampler = nullptr;
+	if (renderThread.joinable())
+		renderThread.join();
+	MediaInfoCache::GetInstance().shutdown();
+	BatchTranscoder::GetInstance().stop();
+	HeadCache::GetInstance().stop();
+	// Only once no worker can open files anymore
+	DecoderPool::GetInstance().clear();
 
 	configDialog->close();
 	delete configDialog;
@@ -219,6 +354,8 @@ void sb_kill()
 
 	delete updateChecker;
 	updateChecker = nullptr;
+
+	RT_CHECK_SUMMARY();
 }
 
 
@@ -413,10 +550,182 @@ void sb_resetFirstTimeUsage()
 	);
 }
 
+void sb_printStats()
+{
+	const DecoderPool& pool = DecoderPool::GetInstance();
+	const uint64_t hits = pool.hits();
+	const uint64_t total = hits + pool.misses();
+	char buf[256];
+	snprintf(
+		buf, sizeof(buf), "Decoder pool: %llu of %llu opens reused a decoder (%.1f%%)", (unsigned long long)hits,
+		(unsigned long long)total, total > 0 ? 100.0 * (double)hits / (double)total : 0.0
+	);
+	ts3Functions.printMessageToCurrentTab(buf);
+
+	const UnderrunStats::snapshot_t underruns = sampler->getUnderrunStats();
+	snprintf(
+		buf, sizeof(buf), "Underruns: %llu sent to the channel, %llu local playback, %.2f s of audio missing",
+		(unsigned long long)underruns.capture, (unsigned long long)underruns.playback,
+		(double)underruns.missingFrames / 48000.0
+	);
+	ts3Functions.printMessageToCurrentTab(buf);
+	if (underruns.numRecent > 0)
+	{
+		QStringList times;
+		for (int i = 0; i < underruns.numRecent; i++)
+			times.append(QDateTime::fromMSecsSinceEpoch(underruns.recent[i]).toString("yyyy-MM-dd hh:mm:ss.zzz"));
+		ts3Functions.printMessageToCurrentTab(("Last underruns: " + times.join(", ")).toUtf8().constData());
+	}
+
+	const SeekStats::snapshot_t seeks = sampler->getSeekStats();
+	snprintf(
+		buf, sizeof(buf), "Seeks: %llu, %.1f ms from request to audio on average, %.1f ms at most, %.1f ms last",
+		(unsigned long long)seeks.seeks, seeks.averageMs, seeks.maxMs, seeks.lastMs
+	);
+	ts3Functions.printMessageToCurrentTab(buf);
+
+	int heads = 0;
+	int64_t headBytes = 0;
+	HeadCache::GetInstance().usage(heads, headBytes);
+	snprintf(
+		buf, sizeof(buf), "Head cache: %i sounds start from memory, %.1f MB%s", heads,
+		(double)headBytes / (1024.0 * 1024.0), configModel->getHeadCacheCompression() ? " compressed" : ""
+	);
+	ts3Functions.printMessageToCurrentTab(buf);
+}
+
+
+void sb_renderButton(const char* button, const char* filename)
+{
+	const SoundInfo* sound = configModel->getSoundInfo(strtol(button, nullptr, 10));
+	if (!sound || sound->filename.isEmpty())
+	{
+		ts3Functions.printMessageToCurrentTab("No such button found");
+		return;
+	}
+	if (renderRunning)
+	{
+		ts3Functions.printMessageToCurrentTab("A sound is already being rendered");
+		return;
+	}
+
+	// Same settings the sound would be sent to the channel with
+	RenderJob job;
+	job.input = sound->filename.toUtf8().constData();
+	job.startTime = sound->getStartTime();
+	job.playTime = sound->getPlayTime();
+	job.volumeDb = sampler->getVolumeDbRemote() + (double)sound->volume;
+	job.output = filename;
+	const QString output(filename);
+	if (output.endsWith(".raw", Qt::CaseInsensitive) || output.endsWith(".pcm", Qt::CaseInsensitive))
+		job.format = RenderJob::eFORMAT_RAW;
+
+	// Long sounds take a while to render, the client must not freeze meanwhile
+	if (renderThread.joinable())
+		renderThread.join(); // Done already, renderRunning is cleared last
+	renderRunning = true;
+	renderThread = std::thread(
+		[job]()
+		{
+			RenderResult result;
+			const bool ok = RenderOffline(job, result) == 0;
+
+			// Print from the GUI thread
+			QMetaObject::invokeMethod(
+				qApp,
+				[job, result, ok]()
+				{
+					char buf[256];
+					if (ok)
+						snprintf(
+							buf, sizeof(buf), "Rendered %.2f s in %.3f s (%.1fx real-time)",
+							result.audioSeconds(job.sampleRate), result.renderSeconds,
+							result.realtimeFactor(job.sampleRate)
+						);
+					else
+						snprintf(buf, sizeof(buf), "Rendering failed, see the client log for details");
+					ts3Functions.printMessageToCurrentTab(buf);
+				},
+				Qt::QueuedConnection
+			);
+			renderRunning = false;
+		}
+	);
+	ts3Functions.printMessageToCurrentTab("Rendering in the background...");
+}
+
+
+void sb_prepareSounds(int config)
+{
+	std::vector<SoundInfo> sounds;
+	for (int i = 0; i < NUM_CONFIGS; i++)
+	{
+		if (config < 0 || config == i)
+		{
+			const std::vector<SoundInfo>& s = configModel->sounds(i);
+			sounds.insert(sounds.end(), s.begin(), s.end());
+		}
+	}
+
+	auto finished = [](const BatchTranscoder::report_t& report)
+	{
+		// Called on a worker thread, print from the GUI thread
+		QMetaObject::invokeMethod(
+			qApp,
+			[report]()
+			{
+				char buf[256];
+				snprintf(
+					buf, sizeof(buf),
+					"Prepared %i of %i sounds, %i were up to date, %i failed. %.1f s of audio in %.2f s "
+					"(%.1fx real-time)",
+					report.converted, report.total, report.skipped, report.failed.size(), report.audioSeconds,
+					report.seconds, report.seconds > 0.0 ? report.audioSeconds / report.seconds : 0.0
+				);
+				ts3Functions.printMessageToCurrentTab(buf);
+				for (const QString& filename : report.failed)
+					ts3Functions.printMessageToCurrentTab(("Failed: " + filename).toUtf8().constData());
+				scheduleHeadCacheUpdate(); // Prepared sounds don't need their heads anymore
+			},
+			Qt::QueuedConnection
+		);
+	};
+
+	if (BatchTranscoder::GetInstance().running())
+		ts3Functions.printMessageToCurrentTab("Sounds are already being prepared");
+	else if (BatchTranscoder::GetInstance().start(sounds, finished))
+		ts3Functions.printMessageToCurrentTab("Preparing sounds in the background...");
+	else
+		ts3Functions.printMessageToCurrentTab("Cannot prepare sounds, see the client log for details");
+}
+
+
+void sb_lockTelemetry(const char* action)
+{
+	if (strcmp(action, "on") == 0)
+	{
+		LockTelemetry::reset();
+		LockTelemetry::setEnabled(true);
+		ts3Functions.printMessageToCurrentTab("Lock telemetry enabled");
+	}
+	else if (strcmp(action, "off") == 0 || strcmp(action, "dump") == 0)
+	{
+		if (strcmp(action, "off") == 0)
+			LockTelemetry::setEnabled(false);
+		LockTelemetry::dump();
+		ts3Functions.printMessageToCurrentTab("Lock telemetry written to the client log");
+	}
+	else
+		ts3Functions.printMessageToCurrentTab("Usage: locks on|off|dump");
+}
+
+
 /** return 0 if the command was handled, 1 otherwise */
 int sb_parseCommand(char** args, int argc)
 {
-	if (argc >= 3)
+	if (argc == 3 && strcmp(args[0], "render") == 0)
+		sb_renderButton(args[1], args[2]);
+	else if (argc >= 3)
 		ts3Functions.printMessageToCurrentTab("Too many arguments");
 	else if (argc == 0)
 		sb_openDialog();
@@ -425,13 +734,31 @@ int sb_parseCommand(char** args, int argc)
 		long arg1 = strtol(args[0], nullptr, 10);
 		if (strcmp(args[0], "stop") == 0)
 			sb_stopPlayback();
+		else if (strcmp(args[0], "stats") == 0)
+			sb_printStats();
+		else if (strcmp(args[0], "prepare") == 0)
+			sb_prepareSounds(-1);
 		else if (strcmp(args[0], "-?") == 0)
 			ts3Functions.printMessageToCurrentTab(
-				"Arguments: 'stop' to stop playback or '[configuration number] <button number>'"
+				"Arguments: 'stop' to stop playback, 'stats' to show playback statistics, "
+				"'render <button number> <file>' to render a button to a wave or raw file, "
+				"'prepare [configuration number]' to convert the sounds for faster playback, "
+				"'locks on|off|dump' to record mutex contention or "
+				"'[configuration number] <button number>'"
 			);
 		else if (sb_playButtonEx(args[0]) != 0)
 			ts3Functions.printMessageToCurrentTab("No such button found");
 	}
+	else if (argc == 2 && strcmp(args[0], "locks") == 0)
+		sb_lockTelemetry(args[1]);
+	else if (argc == 2 && strcmp(args[0], "prepare") == 0)
+	{
+		long config = strtol(args[1], nullptr, 10);
+		if (config < 1 || config > NUM_CONFIGS)
+			ts3Functions.printMessageToCurrentTab("Invalid configuration number");
+		else
+			sb_prepareSounds((int)config - 1);
+	}
 	else if (argc == 2)
 	{
 		long arg0 = strtol(args[0], nullptr, 10);
@@ -42,6 +42,10 @@ void sb_onStopTalking();
 void sb_onHotkeyPressed(const char* keyword);
 void sb_checkForUpdates();
 void sb_resetFirstTimeUsage();
+void sb_printStats();
+void sb_renderButton(const char* button, const char* filename);
+void sb_prepareSounds(int config);
+void sb_lockTelemetry(const char* action);
 int sb_parseCommand(char**, int);
 void sb_disableHotkeysTemporarily(bool disable);
 
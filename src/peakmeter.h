@@ -48,6 +48,12 @@ class PeakMeter
 		return (short)(sample + 0.5f);
 	}
 
+	// Factor limit() scales samples with
+	inline float gain(float threshold) const
+	{
+		return output > threshold ? threshold / output : 1.0f;
+	}
+
 	inline float getOutput() const
 	{
 		return output;
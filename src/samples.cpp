@@ -14,7 +14,17 @@
 #include "SoundInfo.h"
 #include "ts3log.h"
 #include "HighResClock.h"
+#include "RtCheck.h"
+#include "MixKernel.h"
+#include "BatchTranscoder.h"
+#include "MediaInfoCache.h"
+#include "HeadCache.h"
+#include "inputfilemacro.h"
+#include "inputfileplaylist.h"
 
+#include <QTimer>
+
+#include <algorithm>
 #include <queue>
 #include <vector>
 #include <cassert>
@@ -22,6 +32,9 @@
 
 // #define MEASURE_PERFORMANCE
 
+// Log the time stopSoundInternal() blocks the calling thread
+// #define MEASURE_STOP_PERFORMANCE
+
 using std::queue;
 using std::vector;
 
@@ -37,23 +50,42 @@ static_assert(sizeof(short) == 2, "Short is weird size");
 
 #define ALIGNED_STACK_ARRAY(name, size, alignment) name[size] ALIGNED_(alignment)
 
-#define MAX_SAMPLEBUFFER_SIZE (48000 * 5)
-#define AMP_THRESH (SHRT_MAX / 2)
+// Room the buffers keep above the highest watermark, for the decoder read that crosses it
+#define BUFFER_READ_ROOM (48000 / 2)
+
+// How often the GUI thread delivers events posted by the audio threads, in ms
+#define EVENT_DRAIN_INTERVAL 20
 
 
 Sampler::Sampler() :
-	m_sbCapture(2, MAX_SAMPLEBUFFER_SIZE),
-	m_sbPlayback(2, MAX_SAMPLEBUFFER_SIZE),
+	m_sbCapture(2, MAX_SAMPLEBUFFER_SIZE, "Capture buffer"),
+	m_sbPlayback(2, MAX_SAMPLEBUFFER_SIZE, "Playback buffer"),
 	m_sampleProducerThread(),
+	m_inputFilePool(m_sampleProducerThread),
 	m_inputFile(nullptr),
-	m_peakMeterCapture(0.01f, 0.00005f, 24000),
-	m_peakMeterPlayback(0.01f, 0.00005f, 24000),
+	m_peakMeterCapture(CreateLimiter()),
+	m_peakMeterPlayback(CreateLimiter()),
 	m_volumeDivider(1),
 	m_globalDbSettingLocal(-1.0),
 	m_globalDbSettingRemote(-1.0),
 	m_soundDbSetting(0.0),
+	m_mutex("Sampler"),
 	m_state(eSILENT),
-	m_localPlayback(true)
+	m_localPlayback(true),
+	m_underrunCapture({false, false}),
+	m_underrunPlayback({false, false}),
+	m_underrunPolicy(eUNDERRUN_DEFAULT),
+	m_captureClock(0),
+	m_startDue(-1),
+	m_startDbSetting(0.0),
+	m_seekable(false),
+	m_looping(false),
+	m_soundFrames(0),
+	m_posBase(0),
+	m_posOffset(0),
+	m_seekId(0),
+	m_droppedEvents(0),
+	m_eventTimer(nullptr)
 {
 	/* Ensure resources are loaded */
 	Q_INIT_RESOURCE(qtres);
@@ -69,22 +101,124 @@ void Sampler::init()
 {
 	m_sampleProducerThread.addBuffer(&m_sbCapture);
 	m_sampleProducerThread.addBuffer(&m_sbPlayback, m_localPlayback);
+	m_sampleProducerThread.setSizingCallback(this);
 	m_sampleProducerThread.start();
+	m_inputFilePool.start();
+
+	m_eventTimer = new QTimer(this);
+	connect(m_eventTimer, SIGNAL(timeout()), this, SLOT(onDrainEvents()));
+	m_eventTimer->start(EVENT_DRAIN_INTERVAL);
 }
 
 
 void Sampler::shutdown()
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 
-	if (m_inputFile)
+	m_sampleProducerThread.setSource(nullptr);
+	m_inputFilePool.reclaim(m_inputFile);
+	m_inputFile = nullptr;
+
+	m_sampleProducerThread.stop();
+	m_inputFilePool.stop();
+
+	if (m_eventTimer)
+		m_eventTimer->stop();
+}
+
+
+void Sampler::postEvent(event_e type, bool capture /*= false*/)
+{
+	event_t evt = {type, m_state == ePLAYING_PREVIEW, capture};
+	if (!m_events.push(evt))
+		m_droppedEvents++;
+}
+
+
+// Producer thread, must not take m_mutex: it is held while reconfiguring the producer
+void Sampler::onSourceSized(const std::string& key, int lowWatermark)
+{
+	MediaInfoCache::GetInstance().setBufferHint(QString::fromStdString(key), lowWatermark);
+}
+
+
+// Report an underrun once when a buffer runs dry while the file still has samples to deliver
+void Sampler::checkUnderrun(int written, int count, bool capture, underrun_t& state)
+{
+	if (written == count)
 	{
-		m_inputFile->close();
-		delete m_inputFile;
-		m_inputFile = nullptr;
+		state.armed = true;
+		state.active = false;
+		return;
 	}
+	if (!m_inputFile || m_inputFile->done())
+		return; // Regular end of the sound
 
-	m_sampleProducerThread.stop();
+	state.active = true;
+	if (state.armed)
+	{
+		state.armed = false;
+		m_underrunStats.record(capture);
+		postEvent(eEVENT_UNDERRUN, capture);
+		if (m_underrunPolicy & eUNDERRUN_BOOST)
+			m_sampleProducerThread.boost();
+	}
+	m_underrunStats.addMissing(count - written);
+}
+
+
+// Fades to apply to the next block of an output
+unsigned int Sampler::underrunFade(const underrun_t& state) const
+{
+	if (!(m_underrunPolicy & eUNDERRUN_FADE))
+		return eFADE_NONE;
+	unsigned int fade = state.active ? eFADE_IN : eFADE_NONE;
+	if (m_inputFile && !m_inputFile->done())
+		fade |= eFADE_OUT_SHORT;
+	return fade;
+}
+
+
+void Sampler::onDrainEvents()
+{
+	if (int dropped = m_droppedEvents.exchange(0))
+		logWarning("Event queue overflow, dropped %i events", dropped);
+
+	event_t evt;
+	while (m_events.pop(evt))
+	{
+		switch (evt.type)
+		{
+		case eEVENT_STARTED:
+		{
+			QString filename;
+			{
+				std::lock_guard<std::mutex> Lock(m_startedMutex);
+				if (!m_startedFilenames.empty())
+				{
+					filename = m_startedFilenames.front();
+					m_startedFilenames.pop_front();
+				}
+			}
+			emit onStartPlaying(evt.preview, filename);
+			break;
+		}
+		case eEVENT_STOPPED:
+			emit onStopPlaying();
+			break;
+		case eEVENT_PAUSED:
+			emit onPausePlaying();
+			break;
+		case eEVENT_UNPAUSED:
+			emit onUnpausePlaying();
+			break;
+		case eEVENT_UNDERRUN:
+			// The client log timestamps it, to be matched against the host load
+			logWarning("Underrun of the %s", evt.capture ? "sound sent to the channel" : "local playback");
+			emit onUnderrun(evt.capture);
+			break;
+		}
+	}
 }
 
 
@@ -94,63 +228,32 @@ double g_perfMeasurement = 0.0;
 #endif
 
 int Sampler::fetchSamples(
-	SampleBuffer& sb, PeakMeter& pm, short* samples, int count, int channels, bool eraseConsumed, int ciLeft,
-	int ciRight, bool overLeft, bool overRight
+	SampleBuffer& sb, PeakMeter& pm, LevelMeter& mixMeter, LevelMeter& soundMeter, short* samples, int count,
+	const ChannelRouting& routing, unsigned int filledSpeakers, unsigned int fade
 )
 {
 	if (m_state == ePAUSED)
-		return 0;
-
-	SampleBuffer::Lock sbl(sb.getMutex());
-
-	if (sb.avail() == 0)
-		return 0;
-
-	if (overLeft)
 	{
-		if (channels == 1)
-			memset(samples, 0, count * sizeof(short));
-		else
-			for (int i = 0; i < count; i++)
-				samples[i * channels + ciLeft] = 0;
+		mixMeter.publishSilence();
+		soundMeter.publishSilence();
+		return 0;
 	}
 
-	if (overRight && channels > 1)
-		for (int i = 0; i < count; i++)
-			samples[i * channels + ciRight] = 0;
-
-	const int write = std::min(count, sb.avail());
-
-	const short* const in = sb.getBufferData();
-	short* const out = samples;
-
 #ifdef MEASURE_PERFORMANCE
 	std::chrono::time_point<HighResClock> start, end;
 	start = HighResClock::now();
 #endif
 
-	if (channels == 1)
-	{
-		for (int i = 0; i < write; i++)
-		{
-			float sample = out[i] + m_volumeFactor * (float(in[i * 2]) + float(in[i * 2 + 1])) * 0.5f;
-			pm.process(sample);
-			out[i] = pm.limit(sample, AMP_THRESH);
-		}
-	}
-	else
+	MixStats stats;
+	const int write = MixFromBuffer(sb, samples, count, routing, filledSpeakers, m_volumeFactor, pm, stats, fade);
+	if (write == 0)
 	{
-		for (int i = 0; i < write; i++)
-		{
-			float sample0 = out[i * channels + ciLeft] + m_volumeFactor * float(in[i * 2]);
-			float sample1 = out[i * channels + ciRight] + m_volumeFactor * float(in[i * 2 + 1]);
-			pm.process(fabs(sample0) > fabs(sample1) ? sample0 : sample1);
-			out[i * channels + ciLeft] = pm.limit(sample0, AMP_THRESH);
-			out[i * channels + ciRight] = pm.limit(sample1, AMP_THRESH);
-		}
+		mixMeter.publishSilence();
+		soundMeter.publishSilence();
+		return 0;
 	}
-
-	sb.consume(nullptr, write, true);
+	mixMeter.publish(stats.mixPeak, stats.mixSumSquares, write * routing.numRoutes());
+	soundMeter.publish(stats.soundPeak, stats.soundSumSquares, write * 2);
 
 #ifdef MEASURE_PERFORMANCE
 	end = HighResClock::now();
@@ -159,9 +262,9 @@ int Sampler::fetchSamples(
 	if (++g_perfMeasureCount >= 1000)
 	{
 		logInfo(
-			"Avg. time in fetchSamples: %f us, volume: %f, limiter: %f",
-			g_perfMeasurement / (double)g_perfMeasureCount * 1000000.0, m_volumeFactor,
-			std::min(AMP_THRESH / m_peakMeterPlayback.getOutput(), 1.0f)
+			"Avg. time in fetchSamples: %f us, channels: %i, routed: %i, volume: %f, limiter: %f",
+			g_perfMeasurement / (double)g_perfMeasureCount * 1000000.0, routing.numChannels(), routing.numRoutes(),
+			m_volumeFactor, std::min(LIMITER_THRESHOLD / m_peakMeterPlayback.getOutput(), 1.0f)
 		);
 		g_perfMeasureCount = 0;
 		g_perfMeasurement = 0.0;
@@ -171,32 +274,71 @@ int Sampler::fetchSamples(
 }
 
 
-int Sampler::findChannelId(unsigned int channel, const unsigned int* channelSpeakerArray, int count)
+// The buffers may still hold samples from before the last seek, or none yet from after it
+bool Sampler::seekInFlight(unsigned seeksApplied) const
+{
+	return m_seekId != 0 && (int)(seeksApplied - m_seekId) < 0;
+}
+
+
+// Record the time from the last seek until the first block from the new position was mixed
+void Sampler::checkSeekHeard(unsigned seeksApplied, int written)
+{
+	if (m_seekId == 0 || written == 0 || seekInFlight(seeksApplied))
+		return;
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(HighResClock::now() - m_seekStart);
+	m_seekStats.record(elapsed.count());
+	m_seekId = 0;
+}
+
+
+// The buffer the sound playing is heard from. Call with m_mutex held.
+SampleBuffer& Sampler::positionBuffer()
 {
-	for (int i = 0; i < count; i++)
-		if (channelSpeakerArray[i] & channel)
-			return i;
-	return 0;
+	return m_state == ePLAYING_PREVIEW ? m_sbPlayback : m_sbCapture;
 }
 
 
 int Sampler::fetchInputSamples(short* samples, int count, int channels, bool* finished)
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	RtLockGuard<InstrumentedMutex> Lock(m_mutex);
+
+	// Read before the buffer, so samples mixed below are known to be from after a seek once it is applied
+	const unsigned seeksApplied = m_sampleProducerThread.seeksApplied();
+
+	// A scheduled sound takes over the volume with the first block that starts at or behind its due sample
+	if (m_startDue >= 0)
+	{
+		RtLockGuard<SampleBuffer::Mutex> sbl(m_sbCapture.getMutex());
+		if (m_sbCapture.readPosition() >= m_startDue)
+			postScheduledStart();
+	}
+	m_captureClock += count;
 
 	setVolumeDb(m_globalDbSettingRemote + m_soundDbSetting);
-	int written =
-		fetchSamples(m_sbCapture, m_peakMeterCapture, samples, count, channels, true, 0, 1, m_muteMyself, m_muteMyself);
+	const ChannelRouting& routing = m_routingCache.get(channels, nullptr);
+	int written = fetchSamples(
+		m_sbCapture, m_peakMeterCapture, m_meters[eMETER_CAPTURE], m_meters[eMETER_CAPTURE_SOUND], samples, count,
+		routing, m_muteMyself ? 0 : ~0u, underrunFade(m_underrunCapture)
+	);
 
-	if (m_state == ePLAYING && m_inputFile && m_inputFile->done())
+	// A seek empties the buffers, that is neither an underrun nor the end of the sound
+	const bool seeking = seekInFlight(seeksApplied);
+	if (m_state == ePLAYING && !seeking)
 	{
-		SampleBuffer::Lock sbl(m_sbCapture.getMutex());
+		checkUnderrun(written, count, true, m_underrunCapture);
+		checkSeekHeard(seeksApplied, written);
+	}
+
+	if (m_state == ePLAYING && !seeking && m_inputFile && m_inputFile->done())
+	{
+		RtLockGuard<SampleBuffer::Mutex> sbl(m_sbCapture.getMutex());
 		if (m_sbCapture.avail() == 0)
 		{
 			m_state = eSILENT;
 			if (finished)
 				*finished = true;
-			emit onStopPlaying();
+			postEvent(eEVENT_STOPPED);
 		}
 	}
 
@@ -208,28 +350,32 @@ int Sampler::fetchOutputSamples(
 	short* samples, int count, int channels, const unsigned int* channelSpeakerArray, unsigned int* channelFillMask
 )
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	RtLockGuard<InstrumentedMutex> Lock(m_mutex);
 
-	const unsigned int bitMaskLeft = SPEAKER_FRONT_LEFT | SPEAKER_HEADPHONES_LEFT;
-	const unsigned int bitMaskRight = SPEAKER_FRONT_RIGHT | SPEAKER_HEADPHONES_RIGHT;
-	int ciLeft = findChannelId(bitMaskLeft, channelSpeakerArray, channels);
-	int ciRight = findChannelId(bitMaskRight, channelSpeakerArray, channels);
+	const unsigned seeksApplied = m_sampleProducerThread.seeksApplied();
 	setVolumeDb(m_globalDbSettingLocal + m_soundDbSetting);
+	const ChannelRouting& routing = m_routingCache.get(channels, channelSpeakerArray);
 	int written = fetchSamples(
-		m_sbPlayback, m_peakMeterPlayback, samples, count, channels, true, ciLeft, ciRight,
-		(*channelFillMask & bitMaskLeft) == 0, (*channelFillMask & bitMaskRight) == 0
+		m_sbPlayback, m_peakMeterPlayback, m_meters[eMETER_PLAYBACK], m_meters[eMETER_PLAYBACK_SOUND], samples, count,
+		routing, *channelFillMask, underrunFade(m_underrunPlayback)
 	);
 
 	if (written > 0)
-		*channelFillMask |= (bitMaskLeft | bitMaskRight);
+		*channelFillMask |= routing.speakerMask();
+
+	const bool seeking = seekInFlight(seeksApplied);
+	if (((m_state == ePLAYING && m_localPlayback) || m_state == ePLAYING_PREVIEW) && !seeking)
+		checkUnderrun(written, count, false, m_underrunPlayback);
+	if (m_state == ePLAYING_PREVIEW && !seeking)
+		checkSeekHeard(seeksApplied, written);
 
-	if (m_state == ePLAYING_PREVIEW && m_inputFile && m_inputFile->done())
+	if (m_state == ePLAYING_PREVIEW && !seeking && m_inputFile && m_inputFile->done())
 	{
-		SampleBuffer::Lock sbl(m_sbPlayback.getMutex());
+		RtLockGuard<SampleBuffer::Mutex> sbl(m_sbPlayback.getMutex());
 		if (m_sbPlayback.avail() == 0)
 		{
 			m_state = eSILENT;
-			emit onStopPlaying();
+			postEvent(eEVENT_STOPPED);
 		}
 	}
 
@@ -251,7 +397,7 @@ bool Sampler::playPreview(const SoundInfo& sound)
 
 void Sampler::stopPlayback()
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 	stopSoundInternal();
 }
 
@@ -288,11 +434,24 @@ void Sampler::setMuteMyself(bool enabled)
 }
 
 
+void Sampler::setUnderrunPolicy(int policy)
+{
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
+	m_underrunPolicy = policy;
+}
+
+
+void Sampler::setBufferBounds(int minMs, int maxMs)
+{
+	const int maxSamples = std::min(maxMs * 48, MAX_SAMPLEBUFFER_SIZE - BUFFER_READ_ROOM);
+	m_sampleProducerThread.setWatermarkBounds(std::min(minMs * 48, maxSamples), maxSamples);
+}
+
+
 void Sampler::setVolumeDb(double decibel)
 {
-	double factor = pow(10.0, decibel / 10.0);
-	m_volumeFactor = (float)factor;
-	m_volumeDivider = (int)(factor * (1 << volumeScaleExp) + 0.5);
+	m_volumeFactor = VolumeDbToFactor(decibel);
+	m_volumeDivider = (int)(m_volumeFactor * (1 << volumeScaleExp) + 0.5f);
 }
 
 
@@ -300,10 +459,17 @@ void Sampler::stopSoundInternal()
 {
 	if (m_inputFile)
 	{
+#ifdef MEASURE_STOP_PERFORMANCE
+		std::chrono::time_point<HighResClock> start = HighResClock::now();
+#endif
+
 		m_state = eSILENT;
+		m_seekable = false;
+		m_seekId = 0;
+
+		// Only detach the file here, closing it happens on the reclaimer thread
 		m_sampleProducerThread.setSource(nullptr);
-		m_inputFile->close();
-		delete m_inputFile;
+		m_inputFilePool.reclaim(m_inputFile);
 		m_inputFile = nullptr;
 
 		// Clear buffers
@@ -312,73 +478,386 @@ void Sampler::stopSoundInternal()
 		m_sbCapture.consume(nullptr, m_sbCapture.avail());
 		m_sbPlayback.consume(nullptr, m_sbPlayback.avail());
 
-		emit onStopPlaying();
+		// The GUI got the name of a sound that was still waiting for its start, it sees it start and stop
+		if (m_startDue >= 0)
+			postScheduledStart();
+		postEvent(eEVENT_STOPPED);
+
+#ifdef MEASURE_STOP_PERFORMANCE
+		std::chrono::duration<double> elapsed = HighResClock::now() - start;
+		logInfo("Stopping took %f us", elapsed.count() * 1000000.0);
+#endif
 	}
 }
 
 
+// What to open for a sound. Sounds prepared by the batch transcoder are already cropped and in the output format.
+static InputFilePlaylist::item_t resolveSound(const SoundInfo& sound, bool& prepared)
+{
+	const QString preparedFile = BatchTranscoder::GetInstance().preparedFile(sound);
+	prepared = !preparedFile.isEmpty();
+	if (prepared)
+		return {preparedFile.toUtf8().toStdString(), 0.0, -1.0, 1.0f};
+	return {sound.filename.toUtf8().toStdString(), sound.getStartTime(), sound.getPlayTime(), 1.0f};
+}
+
+
 bool Sampler::playSoundInternal(const SoundInfo& sound, bool preview)
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	bool prepared;
+	const InputFilePlaylist::item_t item = resolveSound(sound, prepared);
+	const char* filename = item.filename.c_str();
+
+	// Start with the read ahead the last play needed. Prepared files are mapped wave files that
+	// need next to none, they start at the lower bound and aren't remembered.
+	int lowWatermark = 1;
+	std::string sizingKey;
+	if (!prepared)
+	{
+		lowWatermark = MediaInfoCache::GetInstance().bufferHint(sound.filename);
+		sizingKey = item.filename;
+	}
 
-	stopSoundInternal();
+	// A looping sound is played as a playlist of only itself, which stays mono only if the sound is known to be
+	int channels = 2;
+	MediaInfo info;
+	if (sound.loop && MediaInfoCache::GetInstance().get(sound.filename, info) && info.channels == 1)
+		channels = 1;
 
-	m_inputFile = CreateInputFileFFmpeg();
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 
-	if (m_inputFile->open(sound.filename.toUtf8(), sound.getStartTime(), sound.getPlayTime()) != 0)
+	int streamChannels;
+	const int64_t delay = prepareStart(sound, preview, streamChannels);
+	if (streamChannels > 0)
+		channels = streamChannels;
+
+	InputFile* file = nullptr;
+
+	if (!sound.loop)
 	{
-		delete m_inputFile;
-		m_inputFile = nullptr;
+		// Sounds with a decoded head start from memory, their decoder is opened behind it
+		if (!prepared && HeadCache::GetInstance().contains(item.filename, item.startTime, item.playTime))
+			file = m_inputFilePool.acquire(InputFile::eBACKEND_HEAD);
+		else
+			file = m_inputFilePool.acquire(filename);
+
+		if (file->open(filename, item.startTime, item.playTime) != 0)
+		{
+			m_inputFilePool.reclaim(file);
+			return false;
+		}
+
+		if (streamChannels != 0 && file->channels() != streamChannels)
+		{
+			// Replacing a sound within its stream, converted to its channels like an item of a playlist
+			m_inputFilePool.reclaim(file);
+			file = nullptr;
+		}
+	}
+
+	if (!file)
+	{
+		InputFilePlaylist* list =
+			static_cast<InputFilePlaylist*>(m_inputFilePool.acquire(InputFile::eBACKEND_PLAYLIST));
+		if (list->openList({item}, channels, 0, sound.loop) != 0)
+		{
+			m_inputFilePool.reclaim(list);
+			return false;
+		}
+		file = list;
+	}
+
+	// Length of the cropped sound, asked before the producer starts reading the file
+	int64_t frames = file->outputSamplesEstimation() - (int64_t)(item.startTime * 48000.0);
+	if (item.playTime > 0.0)
+		frames = std::min(frames, (int64_t)(item.playTime * 48000.0));
+
+	startSoundInternal(file, sound, preview, sizingKey, lowWatermark, delay);
+	m_seekable = true;
+	m_looping = sound.loop;
+	m_soundFrames = std::max(frames, (int64_t)0);
+	return true;
+}
+
+
+bool Sampler::seekPlayback(double seconds)
+{
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
+	if (!m_inputFile || !m_seekable || m_startDue >= 0 || m_state == eSILENT)
 		return false;
+
+	int64_t frame = std::max((int64_t)(seconds * 48000.0), (int64_t)0);
+	if (m_soundFrames > 0)
+		frame = std::min(frame, m_soundFrames);
+	{
+		SampleBuffer& sb = positionBuffer();
+		SampleBuffer::Lock sbl(sb.getMutex());
+		m_posBase = sb.readPosition();
 	}
+	m_posOffset = frame;
+	m_seekStart = HighResClock::now();
+	m_seekId = m_sampleProducerThread.seekSource(m_inputFile, (double)frame / 48000.0);
+	return true;
+}
 
-	m_soundDbSetting = (double)sound.volume;
-	setVolumeDb(m_globalDbSettingLocal + m_soundDbSetting);
 
-	SampleBuffer::Lock sblc(m_sbCapture.getMutex());
-	SampleBuffer::Lock sblp(m_sbPlayback.getMutex());
+bool Sampler::getPlaybackPosition(double& position, double& length)
+{
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
+	if (!m_inputFile || !m_seekable || m_soundFrames <= 0 || m_state == eSILENT)
+		return false;
 
-	// Clear buffers
-	m_sbCapture.consume(nullptr, m_sbCapture.avail());
-	m_sbPlayback.consume(nullptr, m_sbPlayback.avail());
+	int64_t readPosition;
+	{
+		SampleBuffer& sb = positionBuffer();
+		SampleBuffer::Lock sbl(sb.getMutex());
+		readPosition = sb.readPosition();
+	}
+	int64_t pos = m_posOffset + std::max(readPosition - m_posBase, (int64_t)0);
+	pos = m_looping ? pos % m_soundFrames : std::min(pos, m_soundFrames);
 
-	if (preview)
+	position = (double)pos / 48000.0;
+	length = (double)m_soundFrames / 48000.0;
+	return true;
+}
+
+
+bool Sampler::playPlaylist(const SoundInfo& playlist, const std::vector<SoundInfo>& sounds)
+{
+	// The stream stays mono only if all sounds are known to be, otherwise mono ones are spread to stereo
+	std::vector<InputFilePlaylist::item_t> items;
+	int channels = 1;
+	int lowWatermark = 0;
+	for (const SoundInfo& sound : sounds)
 	{
-		m_state = ePLAYING_PREVIEW;
-		m_sampleProducerThread.setBufferEnabled(&m_sbCapture, false);
-		m_sampleProducerThread.setBufferEnabled(&m_sbPlayback, true);
+		bool prepared;
+		items.push_back(resolveSound(sound, prepared));
+		items.back().gain = VolumeDbToFactor((double)sound.volume);
+
+		MediaInfo info;
+		if (!MediaInfoCache::GetInstance().get(sound.filename, info) || info.channels != 1)
+			channels = 2;
+		if (!prepared) // Start with the read ahead the hungriest sound needed
+			lowWatermark = std::max(lowWatermark, MediaInfoCache::GetInstance().bufferHint(sound.filename));
 	}
-	else
+	const int crossfadeFrames = (int)((int64_t)std::max(playlist.crossfadeMs, 0) * 48000 / 1000);
+
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
+
+	int streamChannels;
+	const int64_t delay = prepareStart(playlist, false, streamChannels);
+
+	InputFilePlaylist* file = static_cast<InputFilePlaylist*>(m_inputFilePool.acquire(InputFile::eBACKEND_PLAYLIST));
+	if (file->openList(items, streamChannels > 0 ? streamChannels : channels, crossfadeFrames, playlist.loop) != 0)
 	{
-		m_state = ePLAYING;
-		m_sampleProducerThread.setBufferEnabled(&m_sbCapture, true);
+		m_inputFilePool.reclaim(file);
+		return false;
+	}
+
+	// The sounds are sized separately from the stream they are played in, it is not reported
+	startSoundInternal(file, playlist, false, std::string(), lowWatermark, delay);
+	return true;
+}
+
+
+bool Sampler::playMacro(const SoundInfo& macro, const std::vector<SoundInfo>& sounds)
+{
+	// Channels and read ahead are chosen like for a playlist
+	std::vector<InputFileMacro::voice_t> voices;
+	int channels = 1;
+	int lowWatermark = 0;
+	for (size_t i = 0; i < sounds.size() && i < (size_t)macro.macro.size(); i++)
+	{
+		const SoundInfo& sound = sounds[i];
+		if (sound.filename.isEmpty())
+			continue;
+
+		const SoundInfo::macro_voice_t& macroVoice = macro.macro[(int)i];
+		bool prepared;
+		InputFileMacro::voice_t voice;
+		voice.item = resolveSound(sound, prepared);
+		voice.item.gain = VolumeDbToFactor((double)sound.volume);
+		voice.startFrame = (int64_t)macroVoice.startMs * 48000 / 1000;
+		voice.stopFrame = macroVoice.stopMs >= 0 ? (int64_t)macroVoice.stopMs * 48000 / 1000 : -1;
+		voices.push_back(voice);
+
+		MediaInfo info;
+		if (!MediaInfoCache::GetInstance().get(sound.filename, info) || info.channels != 1)
+			channels = 2;
+		if (!prepared)
+			lowWatermark = std::max(lowWatermark, MediaInfoCache::GetInstance().bufferHint(sound.filename));
 	}
+	if (voices.empty())
+		return false;
 
-	m_sampleProducerThread.setSource(m_inputFile);
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 
-	emit onStartPlaying(preview, sound.filename);
+	int streamChannels;
+	const int64_t delay = prepareStart(macro, false, streamChannels);
 
+	InputFileMacro* file = static_cast<InputFileMacro*>(m_inputFilePool.acquire(InputFile::eBACKEND_MACRO));
+	if (file->openMacro(voices, streamChannels > 0 ? streamChannels : channels) != 0)
+	{
+		m_inputFilePool.reclaim(file);
+		return false;
+	}
+
+	startSoundInternal(file, macro, false, std::string(), lowWatermark, delay);
 	return true;
 }
 
 
+// Frames from now until the next line of the tempo grid of sound on the capture clock, 0 if it isn't quantized.
+// The grid is shared by all sounds, so quantized ones stay in time with each other.
+int64_t Sampler::quantizeDelay(const SoundInfo& sound) const
+{
+	if (sound.quantizeBpm <= 0)
+		return 0;
+
+	const double step = 48000.0 * 60.0 / sound.quantizeBpm * SoundInfo::getQuantizeBeats(sound.quantizeGrid);
+	const int64_t next = (int64_t)llround(ceil((double)m_captureClock / step) * step);
+	return std::max(next - m_captureClock, (int64_t)0);
+}
+
+
+// Stop the sound playing, unless sound is quantized: then the one playing goes on until the sound replaces
+// it within the same stream, which has to keep its channels. streamChannels is set to them in that case and
+// to 0 otherwise. Returns the frames until the sound starts. Call with m_mutex held.
+int64_t Sampler::prepareStart(const SoundInfo& sound, bool preview, int& streamChannels)
+{
+	streamChannels = 0;
+	const int64_t delay = preview ? 0 : quantizeDelay(sound);
+	if (delay > 0 && m_inputFile && (m_state == ePLAYING || m_state == ePAUSED))
+	{
+		SampleBuffer::Lock sbl(m_sbCapture.getMutex());
+		streamChannels = m_sbCapture.channels();
+	}
+	else
+		stopSoundInternal();
+	return delay;
+}
+
+
+// Start playing file, which was just opened, after delay frames. If prepareStart() let a sound play on,
+// file replaces it at that frame.
+void Sampler::startSoundInternal(
+	InputFile* file, const SoundInfo& sound, bool preview, const std::string& sizingKey, int lowWatermark,
+	int64_t delay
+)
+{
+	if (lowWatermark == 0 && file->backend() == InputFile::eBACKEND_WAV)
+		lowWatermark = 1; // Same for wave files played the first time
+
+	// Only one sound can wait for its start, one that is replaced before it started is reported as started
+	if (m_startDue >= 0)
+		postScheduledStart();
+
+	// Playlists and macros can't be seeked, playSoundInternal() allows it for plain sounds
+	m_seekable = false;
+	m_looping = false;
+	m_soundFrames = 0;
+	m_posOffset = 0;
+	m_seekId = 0;
+
+	if (m_inputFile)
+	{
+		// The producer keeps reading the sound playing until the switch, the file is closed after it
+		m_inputFilePool.reclaim(m_inputFile);
+		m_inputFile = file;
+	}
+	else
+	{
+		m_inputFile = file;
+		m_soundDbSetting = (double)sound.volume;
+		setVolumeDb(m_globalDbSettingLocal + m_soundDbSetting);
+
+		{
+			// Clear buffers, they hold the samples with the channels of the sound, the mix kernel spreads mono ones
+			SampleBuffer::Lock sblc(m_sbCapture.getMutex());
+			SampleBuffer::Lock sblp(m_sbPlayback.getMutex());
+			m_sbCapture.setChannels(m_inputFile->channels());
+			m_sbPlayback.setChannels(m_inputFile->channels());
+		}
+
+		if (preview)
+		{
+			m_state = ePLAYING_PREVIEW;
+			m_sampleProducerThread.setBufferEnabled(&m_sbCapture, false);
+			m_sampleProducerThread.setBufferEnabled(&m_sbPlayback, true);
+		}
+		else
+		{
+			m_state = ePLAYING;
+			m_sampleProducerThread.setBufferEnabled(&m_sbCapture, true);
+		}
+
+		m_underrunCapture = {false, false};
+		m_underrunPlayback = {false, false};
+	}
+
+	if (delay > 0)
+	{
+		// Counted from what the capture callback takes next. With nothing playing the stream starts with silence.
+		int64_t due;
+		{
+			SampleBuffer::Lock sbl(m_sbCapture.getMutex());
+			due = m_sbCapture.readPosition() + delay;
+		}
+		m_sampleProducerThread.scheduleSource(m_inputFile, &m_sbCapture, due, sizingKey, lowWatermark);
+		m_startDue = due;
+		m_posBase = due;
+		m_startDbSetting = (double)sound.volume;
+	}
+	else
+	{
+		{
+			SampleBuffer& sb = positionBuffer();
+			SampleBuffer::Lock sbl(sb.getMutex());
+			m_posBase = sb.readPosition();
+		}
+		m_sampleProducerThread.setSource(m_inputFile, sizingKey, lowWatermark);
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(m_startedMutex);
+		if (sound.isMacro())
+			m_startedFilenames.push_back(sound.customText.isEmpty() ? QString("Macro") : sound.customText);
+		else if (sound.isPlaylist())
+			m_startedFilenames.push_back(sound.customText.isEmpty() ? QString("Playlist") : sound.customText);
+		else
+			m_startedFilenames.push_back(sound.filename);
+	}
+	if (m_startDue < 0)
+		postEvent(eEVENT_STARTED);
+}
+
+
+// The scheduled sound took over, or was replaced or stopped before: apply its volume and report it started
+void Sampler::postScheduledStart()
+{
+	m_startDue = -1;
+	m_soundDbSetting = m_startDbSetting;
+	postEvent(eEVENT_STARTED);
+}
+
+
 void Sampler::pausePlayback()
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 	if (m_state == ePLAYING)
 	{
 		m_state = ePAUSED;
-		emit onPausePlaying();
+		postEvent(eEVENT_PAUSED);
 	}
 }
 
 
 void Sampler::unpausePlayback()
 {
-	std::lock_guard<std::mutex> Lock(m_mutex);
+	TrackedLock<InstrumentedMutex> Lock(m_mutex);
 	if (m_state == ePAUSED)
 	{
 		m_state = ePLAYING;
-		emit onUnpausePlaying();
+		postEvent(eEVENT_UNPAUSED);
 	}
 }
@@ -9,19 +9,30 @@
 #pragma once
 
 #include <QObject>
+#include <QString>
 
 #include "SampleBuffer.h"
 #include "SampleProducerThread.h"
+#include "InputFilePool.h"
 #include "peakmeter.h"
+#include "LevelMeter.h"
+#include "UnderrunStats.h"
+#include "SeekStats.h"
+#include "HighResClock.h"
+#include "SpscRing.h"
+#include "ChannelRouting.h"
 
 #include <mutex>
 #include <atomic>
+#include <deque>
+#include <vector>
 
 class InputFile;
 class SoundInfo;
+class QTimer;
 
 
-class Sampler : public QObject
+class Sampler : public QObject, private SampleProducerThread::SizingCallback
 {
 	Q_OBJECT
 
@@ -45,7 +56,25 @@ class Sampler : public QObject
 	);
 	bool playFile(const SoundInfo& sound);
 	bool playPreview(const SoundInfo& sound);
+
+	// Play sounds back to back without a gap, as one sound with the volume and name of playlist.
+	// The crossfade of playlist is applied between them, and they start over behind the last one if it loops.
+	bool playPlaylist(const SoundInfo& playlist, const std::vector<SoundInfo>& sounds);
+
+	// Play the sounds layered at the offsets of the voices of macro, as one sound with its volume and name.
+	// sounds holds the sound of every voice in the same order, voices with an empty sound are left out.
+	bool playMacro(const SoundInfo& macro, const std::vector<SoundInfo>& sounds);
+
 	void stopPlayback();
+
+	// Continue the sound playing at seconds into it, see InputFile::seek(). What is buffered of it is dropped, so
+	// the new position is heard after one read of the decoder. Returns false if nothing plays that can be seeked.
+	bool seekPlayback(double seconds);
+
+	// Position of the sound playing and the length of it in seconds, for a scrub bar.
+	// Returns false if nothing plays that can be seeked.
+	bool getPlaybackPosition(double& position, double& length);
+
 	void setVolumeLocal(int vol);
 	void setVolumeRemote(int vol);
 	void setLocalPlayback(bool enabled);
@@ -57,21 +86,110 @@ class Sampler : public QObject
 		return m_state;
 	}
 
+	// Global volume of the sounds sent to the channel
+	inline double getVolumeDbRemote() const
+	{
+		return m_globalDbSettingRemote;
+	}
+
+	// Levels of the last block the audio threads delivered. The mix meters show what was actually sent,
+	// the sound meters only the playing sound before it was mixed in. Safe to call from any thread.
+	enum meter_e
+	{
+		eMETER_CAPTURE = 0,
+		eMETER_PLAYBACK,
+		eMETER_CAPTURE_SOUND,
+		eMETER_PLAYBACK_SOUND,
+		eMETER_COUNT
+	};
+	inline LevelMeter::levels_t getLevels(meter_e meter) const
+	{
+		return m_meters[meter].read();
+	}
+
+	// Reaction to an underrun while a sound plays, flags can be combined. Underruns are always counted.
+	enum underrun_policy_e
+	{
+		eUNDERRUN_REPORT = 0,
+		eUNDERRUN_FADE = 1, // Fade the sound out where the buffer ends and back in when samples arrive again
+		eUNDERRUN_BOOST = 2, // Raise priority and read ahead of the producer for the rest of the sound
+		eUNDERRUN_DEFAULT = eUNDERRUN_FADE | eUNDERRUN_BOOST,
+	};
+	void setUnderrunPolicy(int policy);
+
+	// Limits of the read ahead the producer sizes for each sound, in ms. The upper one is capped by the
+	// size of the sample buffers.
+	void setBufferBounds(int minMs, int maxMs);
+
+	// Safe to call from any thread
+	inline UnderrunStats::snapshot_t getUnderrunStats() const
+	{
+		return m_underrunStats.read();
+	}
+
+	// Safe to call from any thread
+	inline SeekStats::snapshot_t getSeekStats() const
+	{
+		return m_seekStats.read();
+	}
+
   signals:
 	void onStartPlaying(bool preview, QString filename);
 	void onStopPlaying();
 	void onPausePlaying();
 	void onUnpausePlaying();
+	void onUnderrun(bool capture);
+
+  private slots:
+	void onDrainEvents();
 
   private:
+	// State changes are passed to the GUI thread as these events, which audio threads can post without
+	// calling into Qt. All events are posted with m_mutex held, so there is only one producer at a time.
+	enum event_e
+	{
+		eEVENT_STARTED = 0,
+		eEVENT_STOPPED,
+		eEVENT_PAUSED,
+		eEVENT_UNPAUSED,
+		eEVENT_UNDERRUN,
+	};
+
+	struct event_t
+	{
+		event_e type;
+		bool preview; // eEVENT_STARTED
+		bool capture; // eEVENT_UNDERRUN
+	};
+
+	void postEvent(event_e type, bool capture = false);
+	void onSourceSized(const std::string& key, int lowWatermark) override;
+	// Underrun tracking of one output
+	struct underrun_t
+	{
+		bool armed; // A full block was delivered since the last underrun
+		bool active; // The last block was short, the next samples fade in
+	};
+
+	void checkUnderrun(int written, int count, bool capture, underrun_t& state);
+	unsigned int underrunFade(const underrun_t& state) const;
+	bool seekInFlight(unsigned seeksApplied) const;
+	void checkSeekHeard(unsigned seeksApplied, int written);
+	SampleBuffer& positionBuffer();
 	void stopSoundInternal();
 	bool playSoundInternal(const SoundInfo& sound, bool preview);
+	int64_t quantizeDelay(const SoundInfo& sound) const;
+	int64_t prepareStart(const SoundInfo& sound, bool preview, int& streamChannels);
+	void startSoundInternal(
+		InputFile* file, const SoundInfo& sound, bool preview, const std::string& sizingKey, int lowWatermark,
+		int64_t delay
+	);
+	void postScheduledStart();
 	void setVolumeDb(double decibel);
 	int fetchSamples(
-		SampleBuffer& sb, PeakMeter& pm, short* samples, int count, int channels, bool eraseConsumed, int ciLeft,
-		int ciRight, bool overLeft, bool overRight
+		SampleBuffer& sb, PeakMeter& pm, LevelMeter& mixMeter, LevelMeter& soundMeter, short* samples, int count,
+		const ChannelRouting& routing, unsigned int filledSpeakers, unsigned int fade
 	);
-	int findChannelId(unsigned int channel, const unsigned int* channelSpeakerArray, int count);
 	inline short scale(int val) const
 	{
 		return (short)((val * m_volumeDivider) >> volumeScaleExp);
@@ -81,17 +199,46 @@ class Sampler : public QObject
 	SampleBuffer m_sbCapture;
 	SampleBuffer m_sbPlayback;
 	SampleProducerThread m_sampleProducerThread;
+	InputFilePool m_inputFilePool;
 	InputFile* m_inputFile;
 	PeakMeter m_peakMeterCapture;
 	PeakMeter m_peakMeterPlayback;
+	ChannelRoutingCache m_routingCache; // Only used with m_mutex held
+	LevelMeter m_meters[eMETER_COUNT];
 	int m_volumeDivider;
 	float m_volumeFactor;
 	static const int volumeScaleExp = 12;
 	double m_globalDbSettingLocal;
 	double m_globalDbSettingRemote;
 	double m_soundDbSetting;
-	std::mutex m_mutex;
+	InstrumentedMutex m_mutex;
 	std::atomic<state_e> m_state;
 	bool m_localPlayback;
 	bool m_muteMyself;
+	underrun_t m_underrunCapture;
+	underrun_t m_underrunPlayback;
+	int m_underrunPolicy;
+	UnderrunStats m_underrunStats;
+
+	// Sounds quantized to a tempo grid start at a sample of the capture stream rather than at once
+	int64_t m_captureClock; // Frames the capture callback asked for so far
+	int64_t m_startDue; // Read position of m_sbCapture the scheduled sound starts at, -1 if none is waiting
+	double m_startDbSetting; // Volume of the scheduled sound, the one playing keeps its own until then
+
+	// Position of the sound playing: m_posOffset frames into it when the read position of the buffer it is heard
+	// from was m_posBase. Only plain sounds and loops of them can be seeked, not playlists or macros.
+	bool m_seekable;
+	bool m_looping;
+	int64_t m_soundFrames; // Length of one pass, 0 if unknown
+	int64_t m_posBase;
+	int64_t m_posOffset;
+	unsigned m_seekId; // Request of the last seek that was not heard yet, 0 if none
+	std::chrono::time_point<HighResClock> m_seekStart;
+	SeekStats m_seekStats;
+
+	SpscRing<event_t, 256> m_events;
+	std::atomic<int> m_droppedEvents;
+	std::mutex m_startedMutex;
+	std::deque<QString> m_startedFilenames; // Filenames for queued eEVENT_STARTED, in order
+	QTimer* m_eventTimer;
 };
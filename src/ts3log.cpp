@@ -12,9 +12,13 @@
 #include <cstdarg>
 #include <string>
 
+#include "RtCheck.h"
+
 
 void logMessage(const char* msg, LogLevel level, ...)
 {
+	RT_UNSAFE_CALL("logging");
+
 	char buf[512];
 	va_list argptr;
 